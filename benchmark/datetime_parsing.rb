@@ -0,0 +1,65 @@
+$LOAD_PATH.unshift File.expand_path(File.dirname(__FILE__) + '/../lib')
+
+require 'rubygems'
+require 'benchmark/ips'
+require 'mysql2'
+
+# Measures the cost of casting DATE, TIME and DATETIME columns. The
+# "cast: false" report is the floor (fetching the same strings without
+# parsing them). The two "cast: true" reports decode the same rows with the
+# sscanf based parser and with the fixed-layout parser, so the difference
+# between them is the parsing alone; building the Time and Date objects is
+# shared code.
+
+database = 'test'
+rows = ENV['NUM'] && ENV['NUM'].to_i || 10_000
+
+client = Mysql2::Client.new(host: "localhost", username: "root", database: database)
+client.query "DROP TABLE IF EXISTS mysql2_datetime_bench"
+client.query %[
+  CREATE TABLE mysql2_datetime_bench (
+    dt DATETIME,
+    dt6 DATETIME(6),
+    d DATE,
+    t TIME
+  )
+]
+values = Array.new(rows) do |i|
+  ts = Time.at(1_500_000_000 + i * 7919, i % 1_000_000)
+  "('#{ts.strftime('%F %T')}', '#{ts.strftime('%F %T.%6N')}', '#{ts.strftime('%F')}', '#{ts.strftime('%T')}')"
+end
+values.each_slice(1000) do |slice|
+  client.query "INSERT INTO mysql2_datetime_bench VALUES #{slice.join(',')}"
+end
+
+sql = "SELECT dt, dt6, d, t FROM mysql2_datetime_bench"
+
+def with_legacy_decoders
+  Mysql2::Result.send(:_legacy_decoders=, true)
+  yield
+ensure
+  Mysql2::Result.send(:_legacy_decoders=, false)
+end
+
+legacy = with_legacy_decoders { client.query(sql, as: :array).to_a }
+raise "sscanf and fixed-layout parsers disagree" unless legacy == client.query(sql, as: :array).to_a
+
+Benchmark.ips do |x|
+  x.report "cast: false" do
+    client.query(sql, as: :array, cast: false).each {}
+  end
+
+  x.report "cast: true, sscanf" do
+    with_legacy_decoders do
+      client.query(sql, as: :array, cast: true).each {}
+    end
+  end
+
+  x.report "cast: true, fixed layout" do
+    client.query(sql, as: :array, cast: true).each {}
+  end
+
+  x.compare!
+end
+
+client.query "DROP TABLE mysql2_datetime_bench"
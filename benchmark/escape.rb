@@ -30,3 +30,5 @@ end
 
 run_escape_benchmarks "abc'def\"ghi\0jkl%mno"
 run_escape_benchmarks "clean string"
+run_escape_benchmarks "clean string " * 1000
+run_escape_benchmarks "it's a \"quoted\" string\n" * 500
@@ -0,0 +1,30 @@
+$LOAD_PATH.unshift File.expand_path(File.dirname(__FILE__) + '/../lib')
+
+require 'rubygems'
+require 'benchmark/ips'
+require 'mysql2'
+
+# Builds and runs a multi-row INSERT of ROWS rows (10000 by default), once by
+# escaping each value in Ruby and once with Client#insert_rows.
+
+rows = ENV['ROWS'] && ENV['ROWS'].to_i || 10_000
+client = Mysql2::Client.new(host: "localhost", username: "root", database: 'test')
+client.query 'DROP TABLE IF EXISTS mysql2_insert_rows_bench'
+client.query 'CREATE TABLE mysql2_insert_rows_bench (id INT, name VARCHAR(64), score DOUBLE)'
+
+data = Array.new(rows) { |i| [i, "user #{i} o'brien", i * 0.5] }
+
+Benchmark.ips do |x|
+  x.report "escape in Ruby" do
+    values = data.map { |id, name, score| "(#{id},'#{client.escape(name)}',#{score})" }
+    client.query "INSERT INTO mysql2_insert_rows_bench (id, name, score) VALUES #{values.join(',')}"
+  end
+
+  x.report "insert_rows" do
+    client.insert_rows 'mysql2_insert_rows_bench', %w[id name score], data
+  end
+
+  x.compare!
+end
+
+client.query 'DROP TABLE mysql2_insert_rows_bench'
@@ -0,0 +1,64 @@
+$LOAD_PATH.unshift File.expand_path(File.dirname(__FILE__) + '/../lib')
+
+require 'rubygems'
+require 'benchmark/ips'
+require 'mysql2'
+
+# Measures the cost of casting integer columns. "cast: false" fetches the
+# same values as strings and is the floor. The two "cast: true" reports
+# decode the same rows with rb_cstr2inum, as the extension used to, and
+# with the digit accumulating decoder that replaced it.
+
+database = 'test'
+rows = ENV['NUM'] && ENV['NUM'].to_i || 10_000
+
+client = Mysql2::Client.new(host: "localhost", username: "root", database: database)
+client.query "DROP TABLE IF EXISTS mysql2_integer_bench"
+client.query %[
+  CREATE TABLE mysql2_integer_bench (
+    tiny_int_test TINYINT,
+    small_int_test SMALLINT,
+    medium_int_test MEDIUMINT,
+    int_test INT,
+    big_int_test BIGINT,
+    year_test YEAR
+  )
+]
+values = Array.new(rows) do |i|
+  "(#{i % 128}, #{-i % 32_768}, #{i * 31 % 8_388_608}, #{i * 7919}, #{i * 104_729 * 1_000_003}, #{1901 + i % 255})"
+end
+values.each_slice(1000) do |slice|
+  client.query "INSERT INTO mysql2_integer_bench VALUES #{slice.join(',')}"
+end
+
+sql = "SELECT * FROM mysql2_integer_bench"
+
+def with_legacy_decoders
+  Mysql2::Result.send(:_legacy_decoders=, true)
+  yield
+ensure
+  Mysql2::Result.send(:_legacy_decoders=, false)
+end
+
+legacy = with_legacy_decoders { client.query(sql, as: :array).to_a }
+raise "rb_cstr2inum and the integer decoder disagree" unless legacy == client.query(sql, as: :array).to_a
+
+Benchmark.ips do |x|
+  x.report "cast: false" do
+    client.query(sql, as: :array, cast: false).each {}
+  end
+
+  x.report "cast: true, rb_cstr2inum" do
+    with_legacy_decoders do
+      client.query(sql, as: :array, cast: true).each {}
+    end
+  end
+
+  x.report "cast: true, digit loop" do
+    client.query(sql, as: :array, cast: true).each {}
+  end
+
+  x.compare!
+end
+
+client.query "DROP TABLE mysql2_integer_bench"
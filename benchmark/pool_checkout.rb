@@ -0,0 +1,57 @@
+$LOAD_PATH.unshift File.expand_path(File.dirname(__FILE__) + '/../lib')
+
+require 'rubygems'
+require 'benchmark/ips'
+require 'mysql2'
+
+# Measures checkout + checkin of Mysql2::Pool against the Mutex and
+# ConditionVariable pool applications tend to put in front of Mysql2::Client,
+# with THREADS threads (32 by default) contending for SIZE connections.
+
+threads = ENV['THREADS'] && ENV['THREADS'].to_i || 32
+size = ENV['SIZE'] && ENV['SIZE'].to_i || 8
+opts = { host: "localhost", username: "root", database: 'test' }
+
+class MutexPool
+  def initialize(size, opts)
+    @clients = Array.new(size) { Mysql2::Client.new(opts) }
+    @mutex = Mutex.new
+    @available = ConditionVariable.new
+  end
+
+  def with
+    client = @mutex.synchronize do
+      @available.wait(@mutex) while @clients.empty?
+      @clients.pop
+    end
+    begin
+      yield client
+    ensure
+      @mutex.synchronize do
+        @clients.push(client)
+        @available.signal
+      end
+    end
+  end
+end
+
+def contend(threads, pool)
+  Array.new(threads) { Thread.new { 100.times { pool.with { |_client| Thread.pass } } } }.each(&:join)
+end
+
+mutex_pool = MutexPool.new(size, opts)
+mysql2_pool = Mysql2::Pool.new(opts.merge(size: size, health_check_interval: nil))
+
+Benchmark.ips do |x|
+  x.report "Mutex + ConditionVariable" do
+    contend(threads, mutex_pool)
+  end
+
+  x.report "Mysql2::Pool" do
+    contend(threads, mysql2_pool)
+  end
+
+  x.compare!
+end
+
+p mysql2_pool.stats
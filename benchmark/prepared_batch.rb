@@ -0,0 +1,30 @@
+$LOAD_PATH.unshift File.expand_path(File.dirname(__FILE__) + '/../lib')
+
+require 'rubygems'
+require 'benchmark/ips'
+require 'mysql2'
+
+# Inserts ROWS rows (1000 by default) through one prepared statement, calling
+# Statement#execute per row and Statement#execute_batch once.
+
+rows = ENV['ROWS'] && ENV['ROWS'].to_i || 1000
+client = Mysql2::Client.new(host: "localhost", username: "root", database: 'test')
+client.query 'DROP TABLE IF EXISTS mysql2_batch_bench'
+client.query 'CREATE TABLE mysql2_batch_bench (id INT AUTO_INCREMENT PRIMARY KEY, a INT, b VARCHAR(32), c DOUBLE)'
+
+params = Array.new(rows) { |i| [i, "row #{i}", i * 0.5] }
+stmt = client.prepare 'INSERT INTO mysql2_batch_bench (a, b, c) VALUES (?, ?, ?)'
+
+Benchmark.ips do |x|
+  x.report "execute per row" do
+    params.each { |row| stmt.execute(*row) }
+  end
+
+  x.report "execute_batch" do
+    stmt.execute_batch(params)
+  end
+
+  x.compare!
+end
+
+client.query 'DROP TABLE mysql2_batch_bench'
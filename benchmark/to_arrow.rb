@@ -0,0 +1,33 @@
+$LOAD_PATH.unshift File.expand_path(File.dirname(__FILE__) + '/../lib')
+
+require 'rubygems'
+require 'benchmark/ips'
+require 'mysql2'
+
+# Reads ROWS rows (100000 by default) into columns, once by transposing
+# Result#each rows in Ruby and once as an Arrow IPC stream with #to_arrow.
+
+rows = ENV['ROWS'] && ENV['ROWS'].to_i || 100_000
+client = Mysql2::Client.new(host: "localhost", username: "root", database: 'test')
+client.query 'DROP TABLE IF EXISTS mysql2_arrow_bench'
+client.query 'CREATE TABLE mysql2_arrow_bench (id INT, name VARCHAR(64), score DOUBLE, created_at DATETIME)'
+client.insert_rows 'mysql2_arrow_bench', %w[id name score created_at], Array.new(rows) { |i| [i, "user #{i}", i * 0.5, Time.at(i)] }
+
+sql = 'SELECT id, name, score, created_at FROM mysql2_arrow_bench'
+
+Benchmark.ips do |x|
+  x.report "transpose in Ruby" do
+    columns = Hash.new { |h, k| h[k] = [] }
+    client.query(sql, stream: true, cache_rows: false).each do |row|
+      row.each { |k, v| columns[k] << v }
+    end
+  end
+
+  x.report "to_arrow" do
+    client.query_arrow(sql)
+  end
+
+  x.compare!
+end
+
+client.query 'DROP TABLE mysql2_arrow_bench'
@@ -0,0 +1,632 @@
+#include <mysql2_ext.h>
+
+#include <errno.h>
+
+/* Arrow IPC stream output for Result#to_arrow.
+ *
+ * A stream is a Schema message, one RecordBatch message per batch of rows
+ * and an end-of-stream marker. Each message is a 0xFFFFFFFF continuation
+ * marker, the length of its flatbuffer-encoded metadata, the metadata padded
+ * to 8 bytes, and then the body holding the column buffers. Only the handful
+ * of flatbuffer tables the format needs are written, by the small builder
+ * below. Everything here runs without the GVL, so it only uses malloc.
+ */
+
+/* Message.header union */
+#define ARROW_HEADER_SCHEMA       1
+#define ARROW_HEADER_RECORD_BATCH 3
+/* MetadataVersion.V5 */
+#define ARROW_METADATA_VERSION    4
+/* Type union */
+#define ARROW_TYPE_INT            2
+#define ARROW_TYPE_FLOATING_POINT 3
+#define ARROW_TYPE_BINARY         4
+#define ARROW_TYPE_UTF8           5
+#define ARROW_TYPE_DATE           8
+#define ARROW_TYPE_TIMESTAMP      10
+
+/* what a column is converted to */
+enum {
+  MYSQL2_ARROW_INT64,
+  MYSQL2_ARROW_UINT64,
+  MYSQL2_ARROW_DOUBLE,
+  MYSQL2_ARROW_TIMESTAMP_US,
+  MYSQL2_ARROW_DATE32,
+  MYSQL2_ARROW_UTF8,
+  MYSQL2_ARROW_BINARY
+};
+
+#define ARROW_VARIABLE_P(type) ((type) == MYSQL2_ARROW_UTF8 || (type) == MYSQL2_ARROW_BINARY)
+
+/* end a batch early once a string column holds this much data */
+#define ARROW_MAX_BATCH_DATA (1UL << 30)
+
+struct mysql2_arrow_column {
+  int type;
+  unsigned long null_count;
+  mysql2_arrow_buf validity;
+  mysql2_arrow_buf values; /* fixed width values, or int32 offsets */
+  mysql2_arrow_buf data;   /* string bytes */
+};
+
+static int arrow_buf_reserve(mysql2_arrow_buf *buf, size_t extra) {
+  size_t needed = buf->size + extra, capacity;
+  char *data;
+
+  if (needed <= buf->capacity) {
+    return 1;
+  }
+  capacity = buf->capacity ? buf->capacity : 4096;
+  while (capacity < needed) {
+    capacity *= 2;
+  }
+  data = realloc(buf->data, capacity);
+  if (data == NULL) {
+    return 0;
+  }
+  buf->data = data;
+  buf->capacity = capacity;
+  return 1;
+}
+
+static int arrow_buf_append(mysql2_arrow_buf *buf, const void *ptr, size_t len) {
+  if (len == 0) {
+    return 1;
+  }
+  if (!arrow_buf_reserve(buf, len)) {
+    return 0;
+  }
+  if (ptr) {
+    memcpy(buf->data + buf->size, ptr, len);
+  } else {
+    memset(buf->data + buf->size, 0, len);
+  }
+  buf->size += len;
+  return 1;
+}
+
+static int arrow_buf_append_le(mysql2_arrow_buf *buf, uint64_t value, int bytes) {
+  unsigned char le[8];
+  int i;
+
+  for (i = 0; i < bytes; i++) {
+    le[i] = (unsigned char)(value >> (8 * i));
+  }
+  return arrow_buf_append(buf, le, bytes);
+}
+
+static size_t arrow_pad8(size_t len) {
+  return (len + 7) & ~(size_t)7;
+}
+
+/* Flatbuffers are built back to front: the buffer fills from its end, and
+ * an object is referred to by its distance from that end (its "offset"),
+ * which stays valid as the buffer grows.
+ */
+#define FB_MAX_FIELDS 8
+
+typedef struct {
+  unsigned char *buf;
+  size_t capacity;
+  size_t size;
+  size_t minalign;
+  size_t slots[FB_MAX_FIELDS]; /* offsets of the open table's fields, 0 if absent */
+  int numberOfSlots;
+  size_t tableStart;
+  int oom;
+} fb_builder;
+
+static int fb_reserve(fb_builder *b, size_t len) {
+  size_t capacity;
+  unsigned char *buf;
+
+  if (b->oom) {
+    return 0;
+  }
+  if (b->capacity - b->size >= len) {
+    return 1;
+  }
+  capacity = b->capacity ? b->capacity * 2 : 1024;
+  while (capacity - b->size < len) {
+    capacity *= 2;
+  }
+  buf = malloc(capacity);
+  if (buf == NULL) {
+    b->oom = 1;
+    return 0;
+  }
+  if (b->size) {
+    memcpy(buf + capacity - b->size, b->buf + b->capacity - b->size, b->size);
+  }
+  free(b->buf);
+  b->buf = buf;
+  b->capacity = capacity;
+  return 1;
+}
+
+static void fb_put(fb_builder *b, const void *ptr, size_t len) {
+  if (len == 0 || !fb_reserve(b, len)) {
+    return;
+  }
+  b->size += len;
+  if (ptr) {
+    memcpy(b->buf + b->capacity - b->size, ptr, len);
+  } else {
+    memset(b->buf + b->capacity - b->size, 0, len);
+  }
+}
+
+static void fb_put_le(fb_builder *b, uint64_t value, int bytes) {
+  unsigned char le[8];
+  int i;
+
+  for (i = 0; i < bytes; i++) {
+    le[i] = (unsigned char)(value >> (8 * i));
+  }
+  fb_put(b, le, bytes);
+}
+
+/* pad so that after +additional+ more bytes the data is +align+ aligned */
+static void fb_prep(fb_builder *b, size_t align, size_t additional) {
+  if (align > b->minalign) {
+    b->minalign = align;
+  }
+  fb_put(b, NULL, (~(b->size + additional) + 1) & (align - 1));
+}
+
+static void fb_push(fb_builder *b, uint64_t value, int bytes) {
+  fb_prep(b, bytes, 0);
+  fb_put_le(b, value, bytes);
+}
+
+static void fb_push_uoffset(fb_builder *b, size_t off) {
+  fb_prep(b, 4, 0);
+  fb_put_le(b, b->size + 4 - off, 4);
+}
+
+static void fb_start_table(fb_builder *b, int numberOfFields) {
+  memset(b->slots, 0, sizeof(b->slots));
+  b->numberOfSlots = numberOfFields;
+  b->tableStart = b->size;
+}
+
+static void fb_add_scalar(fb_builder *b, int field, uint64_t value, int bytes) {
+  fb_push(b, value, bytes);
+  b->slots[field] = b->size;
+}
+
+static void fb_add_offset(fb_builder *b, int field, size_t off) {
+  fb_push_uoffset(b, off);
+  b->slots[field] = b->size;
+}
+
+static size_t fb_end_table(fb_builder *b) {
+  size_t table, vtable;
+  int i;
+
+  /* soffset to the vtable, filled in below */
+  fb_push(b, 0, 4);
+  table = b->size;
+
+  for (i = b->numberOfSlots - 1; i >= 0; i--) {
+    fb_push(b, b->slots[i] ? table - b->slots[i] : 0, 2);
+  }
+  fb_push(b, table - b->tableStart, 2);
+  fb_push(b, (b->numberOfSlots + 2) * 2, 2);
+  vtable = b->size;
+
+  if (!b->oom) {
+    unsigned char *p = b->buf + b->capacity - table;
+    uint32_t soffset = (uint32_t)(vtable - table);
+    p[0] = (unsigned char)soffset;
+    p[1] = (unsigned char)(soffset >> 8);
+    p[2] = (unsigned char)(soffset >> 16);
+    p[3] = (unsigned char)(soffset >> 24);
+  }
+  return table;
+}
+
+static size_t fb_create_string(fb_builder *b, const char *str, size_t len) {
+  fb_prep(b, 4, len + 1);
+  fb_put(b, NULL, 1);
+  fb_put(b, str, len);
+  fb_put_le(b, len, 4);
+  return b->size;
+}
+
+static size_t fb_create_offset_vector(fb_builder *b, const size_t *offs, size_t count) {
+  size_t i;
+
+  fb_prep(b, 4, 4 * count);
+  for (i = count; i > 0; i--) {
+    fb_push_uoffset(b, offs[i - 1]);
+  }
+  fb_put_le(b, count, 4);
+  return b->size;
+}
+
+/* vector of structs made of two longs: FieldNode and Buffer */
+static size_t fb_create_long_pair_vector(fb_builder *b, const int64_t *pairs, size_t count) {
+  size_t i;
+
+  fb_prep(b, 4, 16 * count);
+  fb_prep(b, 8, 16 * count);
+  for (i = count; i > 0; i--) {
+    fb_put_le(b, (uint64_t)pairs[2 * i - 1], 8);
+    fb_put_le(b, (uint64_t)pairs[2 * i - 2], 8);
+  }
+  fb_put_le(b, count, 4);
+  return b->size;
+}
+
+static size_t fb_create_message(fb_builder *b, int headerType, size_t header, int64_t bodyLength) {
+  fb_start_table(b, 5);
+  fb_add_scalar(b, 3, (uint64_t)bodyLength, 8);
+  fb_add_offset(b, 2, header);
+  fb_add_scalar(b, 0, ARROW_METADATA_VERSION, 2);
+  fb_add_scalar(b, 1, headerType, 1);
+  return fb_end_table(b);
+}
+
+/* Finish the flatbuffer rooted at +root+ and append it to +out+ as the
+ * framed metadata of a message. The caller appends the body after it.
+ */
+static int arrow_append_message(fb_builder *b, size_t root, mysql2_arrow_buf *out) {
+  size_t metadataLength;
+
+  fb_prep(b, b->minalign, 4);
+  fb_push_uoffset(b, root);
+  if (b->oom) {
+    return 0;
+  }
+
+  metadataLength = arrow_pad8(b->size);
+  return arrow_buf_append_le(out, 0xFFFFFFFFU, 4) &&
+    arrow_buf_append_le(out, metadataLength, 4) &&
+    arrow_buf_append(out, b->buf + b->capacity - b->size, b->size) &&
+    arrow_buf_append(out, NULL, metadataLength - b->size);
+}
+
+static int arrow_column_type(const MYSQL_FIELD *field, int utf8) {
+  switch (field->type) {
+    case MYSQL_TYPE_TINY:
+    case MYSQL_TYPE_SHORT:
+    case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_YEAR:
+      return MYSQL2_ARROW_INT64;
+    case MYSQL_TYPE_LONGLONG:
+      return (field->flags & UNSIGNED_FLAG) ? MYSQL2_ARROW_UINT64 : MYSQL2_ARROW_INT64;
+    case MYSQL_TYPE_FLOAT:
+    case MYSQL_TYPE_DOUBLE:
+      return MYSQL2_ARROW_DOUBLE;
+    case MYSQL_TYPE_TIMESTAMP:
+    case MYSQL_TYPE_DATETIME:
+      return MYSQL2_ARROW_TIMESTAMP_US;
+    case MYSQL_TYPE_DATE:
+    case MYSQL_TYPE_NEWDATE:
+      return MYSQL2_ARROW_DATE32;
+    case MYSQL_TYPE_DECIMAL:
+    case MYSQL_TYPE_NEWDECIMAL:
+    case MYSQL_TYPE_TIME:
+    case MYSQL_TYPE_NULL:
+      /* ASCII, whatever the connection encoding */
+      return MYSQL2_ARROW_UTF8;
+    case MYSQL_TYPE_BIT:
+      return MYSQL2_ARROW_BINARY;
+    default:
+      return (field->flags & BINARY_FLAG && field->charsetnr == 63) || !utf8 ? MYSQL2_ARROW_BINARY : MYSQL2_ARROW_UTF8;
+  }
+}
+
+int mysql2_arrow_stream_init(mysql2_arrow_stream *stream, MYSQL_FIELD *fields, unsigned int numberOfFields, unsigned long batchSize, int utf8) {
+  unsigned int i;
+
+  stream->numberOfFields = numberOfFields;
+  stream->batchSize = batchSize;
+  stream->error = 0;
+  stream->columns = calloc(numberOfFields ? numberOfFields : 1, sizeof(mysql2_arrow_column));
+  if (stream->columns == NULL) {
+    return 0;
+  }
+  for (i = 0; i < numberOfFields; i++) {
+    stream->columns[i].type = arrow_column_type(&fields[i], utf8);
+  }
+  return 1;
+}
+
+void mysql2_arrow_stream_free(mysql2_arrow_stream *stream) {
+  unsigned int i;
+
+  if (stream->columns == NULL) {
+    return;
+  }
+  for (i = 0; i < stream->numberOfFields; i++) {
+    free(stream->columns[i].validity.data);
+    free(stream->columns[i].values.data);
+    free(stream->columns[i].data.data);
+  }
+  free(stream->columns);
+  stream->columns = NULL;
+}
+
+static size_t arrow_create_type(fb_builder *b, int type) {
+  switch (type) {
+    case MYSQL2_ARROW_INT64:
+    case MYSQL2_ARROW_UINT64:
+      fb_start_table(b, 2);
+      fb_add_scalar(b, 0, 64, 4);
+      fb_add_scalar(b, 1, type == MYSQL2_ARROW_INT64, 1);
+      return fb_end_table(b);
+    case MYSQL2_ARROW_DOUBLE:
+      fb_start_table(b, 1);
+      fb_add_scalar(b, 0, 2, 2); /* Precision.DOUBLE */
+      return fb_end_table(b);
+    case MYSQL2_ARROW_TIMESTAMP_US:
+      fb_start_table(b, 2);
+      fb_add_scalar(b, 0, 2, 2); /* TimeUnit.MICROSECOND, no timezone */
+      return fb_end_table(b);
+    case MYSQL2_ARROW_DATE32:
+      fb_start_table(b, 1);
+      fb_add_scalar(b, 0, 0, 2); /* DateUnit.DAY */
+      return fb_end_table(b);
+    default:
+      /* Utf8 and Binary have no fields */
+      fb_start_table(b, 0);
+      return fb_end_table(b);
+  }
+}
+
+static int arrow_type_id(int type) {
+  switch (type) {
+    case MYSQL2_ARROW_INT64:
+    case MYSQL2_ARROW_UINT64:
+      return ARROW_TYPE_INT;
+    case MYSQL2_ARROW_DOUBLE:
+      return ARROW_TYPE_FLOATING_POINT;
+    case MYSQL2_ARROW_TIMESTAMP_US:
+      return ARROW_TYPE_TIMESTAMP;
+    case MYSQL2_ARROW_DATE32:
+      return ARROW_TYPE_DATE;
+    case MYSQL2_ARROW_UTF8:
+      return ARROW_TYPE_UTF8;
+    default:
+      return ARROW_TYPE_BINARY;
+  }
+}
+
+int mysql2_arrow_write_schema(mysql2_arrow_stream *stream, MYSQL_FIELD *fields, mysql2_arrow_buf *out) {
+  fb_builder b;
+  size_t *fieldOffsets, fieldsVector, schema, message;
+  const union { uint16_t u; unsigned char c[2]; } endian = { 1 };
+  unsigned int i;
+  int ok;
+
+  memset(&b, 0, sizeof(b));
+  b.minalign = 1;
+  fieldOffsets = malloc((stream->numberOfFields ? stream->numberOfFields : 1) * sizeof(size_t));
+  if (fieldOffsets == NULL) {
+    return 0;
+  }
+
+  for (i = 0; i < stream->numberOfFields; i++) {
+    int type = stream->columns[i].type;
+    size_t name = fb_create_string(&b, fields[i].name, fields[i].name_length);
+    size_t typeTable = arrow_create_type(&b, type);
+    /* readers expect children to be present, even when empty */
+    size_t children = fb_create_offset_vector(&b, NULL, 0);
+
+    fb_start_table(&b, 7);
+    fb_add_offset(&b, 0, name);
+    fb_add_offset(&b, 3, typeTable);
+    fb_add_offset(&b, 5, children);
+    fb_add_scalar(&b, 1, 1, 1); /* nullable */
+    fb_add_scalar(&b, 2, arrow_type_id(type), 1);
+    fieldOffsets[i] = fb_end_table(&b);
+  }
+  fieldsVector = fb_create_offset_vector(&b, fieldOffsets, stream->numberOfFields);
+  free(fieldOffsets);
+
+  fb_start_table(&b, 4);
+  fb_add_offset(&b, 1, fieldsVector);
+  fb_add_scalar(&b, 0, endian.c[0] ? 0 : 1, 2); /* Endianness */
+  schema = fb_end_table(&b);
+
+  message = fb_create_message(&b, ARROW_HEADER_SCHEMA, schema, 0);
+  ok = arrow_append_message(&b, message, out);
+  free(b.buf);
+  return ok;
+}
+
+/* Parse one cell into its column. Cells that don't parse (zero dates,
+ * out of range numbers) become NULL.
+ */
+static int arrow_column_append(mysql2_arrow_column *col, unsigned long row, const char *cell, unsigned long len) {
+  int valid = cell != NULL;
+  uint64_t value = 0;
+
+  if (row % 8 == 0 && !arrow_buf_append(&col->validity, NULL, 1)) {
+    return MYSQL2_ARROW_OOM;
+  }
+
+  if (ARROW_VARIABLE_P(col->type)) {
+    if (valid) {
+      if (col->data.size + len > INT32_MAX) {
+        return MYSQL2_ARROW_TOO_LARGE;
+      }
+      if (!arrow_buf_append(&col->data, cell, len)) {
+        return MYSQL2_ARROW_OOM;
+      }
+    }
+    if (!arrow_buf_append_le(&col->values, col->data.size, 4)) {
+      return MYSQL2_ARROW_OOM;
+    }
+  } else {
+    if (valid) {
+      char *end = NULL;
+      mysql2_time_parts t;
+
+      errno = 0;
+      switch (col->type) {
+        case MYSQL2_ARROW_INT64:
+          value = (uint64_t)strtoll(cell, &end, 10);
+          valid = end == cell + len && errno == 0;
+          break;
+        case MYSQL2_ARROW_UINT64:
+          value = (uint64_t)strtoull(cell, &end, 10);
+          valid = end == cell + len && errno == 0 && cell[0] != '-';
+          break;
+        case MYSQL2_ARROW_DOUBLE:
+          {
+            double d = strtod(cell, &end);
+            memcpy(&value, &d, sizeof(d));
+            valid = end == cell + len;
+          }
+          break;
+        case MYSQL2_ARROW_TIMESTAMP_US:
+          valid = mysql2_parse_datetime_fast(cell, len, &t) && t.month && t.day;
+          if (valid) {
+            int64_t seconds = mysql2_days_from_civil(t.year, t.month, t.day) * 86400 + t.hour * 3600 + t.min * 60 + t.sec;
+            value = (uint64_t)(seconds * 1000000 + t.usec);
+          }
+          break;
+        case MYSQL2_ARROW_DATE32:
+          valid = mysql2_parse_date_fast(cell, len, &t) && t.month && t.day;
+          if (valid) {
+            value = (uint32_t)(int32_t)mysql2_days_from_civil(t.year, t.month, t.day);
+          }
+          break;
+      }
+    }
+    if (!valid) {
+      value = 0;
+    }
+    if (!arrow_buf_append_le(&col->values, value, col->type == MYSQL2_ARROW_DATE32 ? 4 : 8)) {
+      return MYSQL2_ARROW_OOM;
+    }
+  }
+
+  if (valid) {
+    ((unsigned char *)col->validity.data)[row / 8] |= (unsigned char)(1 << (row % 8));
+  } else {
+    col->null_count++;
+  }
+  return 0;
+}
+
+/* Read up to a batch of rows (at most +maxRows+) and append them to +out+
+ * as a RecordBatch message. Returns the number of rows, 0 once the result
+ * is exhausted or on error (see stream->error).
+ */
+unsigned long mysql2_arrow_write_batch(mysql2_arrow_stream *stream, MYSQL_RES *result, unsigned long maxRows, mysql2_arrow_buf *out) {
+  unsigned long rows = 0, *lengths;
+  unsigned int i, numberOfBuffers = 0;
+  size_t bodyLength = 0, nodesVector, buffersVector, batch, message;
+  int64_t *nodes, *buffers;
+  mysql2_arrow_buf *bodyBuffers[3];
+  MYSQL_ROW row;
+  fb_builder b;
+  int ok, full = 0;
+
+  for (i = 0; i < stream->numberOfFields; i++) {
+    mysql2_arrow_column *col = &stream->columns[i];
+
+    col->null_count = 0;
+    col->validity.size = 0;
+    col->values.size = 0;
+    col->data.size = 0;
+    if (ARROW_VARIABLE_P(col->type) && !arrow_buf_append_le(&col->values, 0, 4)) {
+      stream->error = MYSQL2_ARROW_OOM;
+      return 0;
+    }
+  }
+
+  while (!full && rows < stream->batchSize && rows < maxRows && (row = mysql_fetch_row(result)) != NULL) {
+    lengths = mysql_fetch_lengths(result);
+    for (i = 0; i < stream->numberOfFields; i++) {
+      int error = arrow_column_append(&stream->columns[i], rows, row[i], lengths[i]);
+      if (error) {
+        stream->error = error;
+        return 0;
+      }
+      full |= stream->columns[i].data.size >= ARROW_MAX_BATCH_DATA;
+    }
+    rows++;
+  }
+  if (rows == 0) {
+    return 0;
+  }
+
+  /* one FieldNode per column, then validity, values and (for strings) data
+   * buffers, each placed at an 8 byte aligned offset of the body */
+  nodes = malloc(2 * sizeof(int64_t) * (stream->numberOfFields ? stream->numberOfFields : 1));
+  buffers = malloc(2 * sizeof(int64_t) * 3 * (stream->numberOfFields ? stream->numberOfFields : 1));
+  if (nodes == NULL || buffers == NULL) {
+    free(nodes);
+    free(buffers);
+    stream->error = MYSQL2_ARROW_OOM;
+    return 0;
+  }
+  for (i = 0; i < stream->numberOfFields; i++) {
+    mysql2_arrow_column *col = &stream->columns[i];
+    size_t lens[3];
+    int n, j;
+
+    nodes[2 * i] = (int64_t)rows;
+    nodes[2 * i + 1] = (int64_t)col->null_count;
+
+    lens[0] = col->null_count ? col->validity.size : 0;
+    lens[1] = col->values.size;
+    lens[2] = col->data.size;
+    n = ARROW_VARIABLE_P(col->type) ? 3 : 2;
+    for (j = 0; j < n; j++) {
+      buffers[2 * numberOfBuffers] = (int64_t)bodyLength;
+      buffers[2 * numberOfBuffers + 1] = (int64_t)lens[j];
+      bodyLength += arrow_pad8(lens[j]);
+      numberOfBuffers++;
+    }
+  }
+
+  memset(&b, 0, sizeof(b));
+  b.minalign = 1;
+  nodesVector = fb_create_long_pair_vector(&b, nodes, stream->numberOfFields);
+  buffersVector = fb_create_long_pair_vector(&b, buffers, numberOfBuffers);
+  free(nodes);
+  free(buffers);
+
+  fb_start_table(&b, 5);
+  fb_add_scalar(&b, 0, rows, 8);
+  fb_add_offset(&b, 1, nodesVector);
+  fb_add_offset(&b, 2, buffersVector);
+  batch = fb_end_table(&b);
+
+  message = fb_create_message(&b, ARROW_HEADER_RECORD_BATCH, batch, (int64_t)bodyLength);
+  ok = arrow_append_message(&b, message, out) && arrow_buf_reserve(out, bodyLength);
+  free(b.buf);
+
+  for (i = 0; ok && i < stream->numberOfFields; i++) {
+    mysql2_arrow_column *col = &stream->columns[i];
+    int n, j;
+
+    bodyBuffers[0] = &col->validity;
+    bodyBuffers[1] = &col->values;
+    bodyBuffers[2] = &col->data;
+    n = ARROW_VARIABLE_P(col->type) ? 3 : 2;
+    for (j = 0; j < n; j++) {
+      size_t len = (j == 0 && col->null_count == 0) ? 0 : bodyBuffers[j]->size;
+
+      arrow_buf_append(out, bodyBuffers[j]->data, len);
+      arrow_buf_append(out, NULL, arrow_pad8(len) - len);
+    }
+  }
+  if (!ok) {
+    stream->error = MYSQL2_ARROW_OOM;
+    return 0;
+  }
+
+  return rows;
+}
+
+int mysql2_arrow_write_eos(mysql2_arrow_buf *out) {
+  return arrow_buf_append_le(out, 0xFFFFFFFFU, 4) && arrow_buf_append_le(out, 0, 4);
+}
@@ -0,0 +1,30 @@
+#ifndef MYSQL2_ARROW_H
+#define MYSQL2_ARROW_H
+
+/* growable malloc'd byte buffer, usable without the GVL */
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+} mysql2_arrow_buf;
+
+typedef struct mysql2_arrow_column mysql2_arrow_column;
+
+/* mysql2_arrow_stream.error */
+#define MYSQL2_ARROW_OOM       1
+#define MYSQL2_ARROW_TOO_LARGE 2 /* a cell does not fit 32 bit string offsets */
+
+typedef struct {
+  unsigned int numberOfFields;
+  mysql2_arrow_column *columns;
+  unsigned long batchSize;
+  int error;
+} mysql2_arrow_stream;
+
+int mysql2_arrow_stream_init(mysql2_arrow_stream *stream, MYSQL_FIELD *fields, unsigned int numberOfFields, unsigned long batchSize, int utf8);
+void mysql2_arrow_stream_free(mysql2_arrow_stream *stream);
+int mysql2_arrow_write_schema(mysql2_arrow_stream *stream, MYSQL_FIELD *fields, mysql2_arrow_buf *out);
+unsigned long mysql2_arrow_write_batch(mysql2_arrow_stream *stream, MYSQL_RES *result, unsigned long maxRows, mysql2_arrow_buf *out);
+int mysql2_arrow_write_eos(mysql2_arrow_buf *out);
+
+#endif
@@ -12,13 +12,29 @@
 #include <fcntl.h>
 #include "wait_for_single_fd.h"
 
+/*
+ * Under a Fiber scheduler the blocking libmysql calls would stall every
+ * other fiber on the thread, so queries use the non-blocking API instead
+ * (MariaDB's _start/_cont functions, or MySQL 8's *_nonblocking ones) and
+ * wait on the socket with rb_wait_for_single_fd, which yields to the
+ * scheduler.
+ */
+#if !defined(_WIN32) && defined(HAVE_RB_FIBER_SCHEDULER_CURRENT) && \
+    (defined(HAVE_MYSQL_READ_QUERY_RESULT_START) || \
+     (defined(HAVE_MYSQL_READ_QUERY_RESULT_NONBLOCKING) && defined(HAVE_MYSQL_REAL_CONNECT_NONBLOCKING)))
+#define MYSQL2_NONBLOCKING
+#include <ruby/fiber/scheduler.h>
+#endif
+
 #include "mysql_enc_name_to_ruby.h"
 
 VALUE cMysql2Client;
+static VALUE cMysql2QueryResult, cBigDecimal, cDate, cDateTime;
 extern VALUE mMysql2, cMysql2Error, cMysql2TimeoutError;
 static VALUE sym_id, sym_version, sym_header_version, sym_async, sym_symbolize_keys, sym_as, sym_array, sym_stream;
 static VALUE sym_no_good_index_used, sym_no_index_used, sym_query_was_slow;
-static ID intern_brackets, intern_merge, intern_merge_bang, intern_new_with_args;
+static VALUE sym_source, sym_bytes, sym_reads, sym_seconds, sym_bytes_per_second;
+static ID intern_brackets, intern_merge, intern_merge_bang, intern_new_with_args, intern_to_s, intern_strftime;
 
 #define REQUIRE_INITIALIZED(wrapper) \
   if (!wrapper->initialized) { \
@@ -160,11 +176,116 @@ static VALUE rb_set_ssl_mode_option(VALUE self, VALUE setting) {
  * - mysql_ssl_set()
  */
 
+/* Result field names are turned into Hash keys once per client and shared by
+ * every result with the same field, rather than creating (and converting to
+ * Encoding.default_internal) new key Strings for each result. The cache is
+ * keyed by everything that goes into the key: the name, whether it becomes a
+ * Symbol, and the connection and default_internal encodings.
+ */
+#define MYSQL2_FIELD_KEY_CACHE_SIZE 4096
+
+typedef struct {
+  char *name;
+  long name_length;
+  int symbolize_keys;
+  int enc_index;
+  int internal_enc_index;
+} mysql2_field_key;
+
+static int mysql2_field_key_cmp(st_data_t a, st_data_t b) {
+  const mysql2_field_key *x = (const mysql2_field_key *)a, *y = (const mysql2_field_key *)b;
+
+  return !(x->name_length == y->name_length &&
+           x->symbolize_keys == y->symbolize_keys &&
+           x->enc_index == y->enc_index &&
+           x->internal_enc_index == y->internal_enc_index &&
+           memcmp(x->name, y->name, x->name_length) == 0);
+}
+
+static st_index_t mysql2_field_key_hash(st_data_t a) {
+  const mysql2_field_key *k = (const mysql2_field_key *)a;
+
+  return rb_memhash(k->name, k->name_length) ^
+    (st_index_t)((k->internal_enc_index << 16) ^ (k->enc_index << 1) ^ k->symbolize_keys);
+}
+
+static const struct st_hash_type mysql2_field_key_type = {
+  mysql2_field_key_cmp,
+  mysql2_field_key_hash,
+};
+
+static int mysql2_field_key_mark_i(RB_MYSQL_UNUSED st_data_t key, st_data_t val, RB_MYSQL_UNUSED st_data_t arg) {
+  rb_gc_mark((VALUE)val);
+  return ST_CONTINUE;
+}
+
+static int mysql2_field_key_free_i(st_data_t key, RB_MYSQL_UNUSED st_data_t val, RB_MYSQL_UNUSED st_data_t arg) {
+  mysql2_field_key *k = (mysql2_field_key *)key;
+  xfree(k->name);
+  xfree(k);
+  return ST_DELETE;
+}
+
+static void mysql2_field_key_cache_clear(mysql_client_wrapper *wrapper) {
+  if (wrapper->field_keys) {
+    st_foreach(wrapper->field_keys, mysql2_field_key_free_i, 0);
+  }
+}
+
+/* Return the (frozen) Hash key for a result field named +name+. */
+VALUE rb_mysql_client_field_key(mysql_client_wrapper *wrapper, const char *name, long name_length, int symbolize_keys, rb_encoding *conn_enc) {
+  rb_encoding *default_internal_enc = rb_default_internal_encoding();
+  mysql2_field_key lookup, *entry;
+  st_data_t cached;
+  VALUE key;
+
+  lookup.name = (char *)name;
+  lookup.name_length = name_length;
+  lookup.symbolize_keys = symbolize_keys ? 1 : 0;
+  lookup.enc_index = symbolize_keys ? 0 : rb_enc_to_index(conn_enc);
+  lookup.internal_enc_index = (symbolize_keys || !default_internal_enc) ? -1 : rb_enc_to_index(default_internal_enc);
+
+  if (wrapper->field_keys == NULL) {
+    wrapper->field_keys = st_init_table(&mysql2_field_key_type);
+  } else if (st_lookup(wrapper->field_keys, (st_data_t)&lookup, &cached)) {
+    return (VALUE)cached;
+  }
+
+  if (symbolize_keys) {
+    key = ID2SYM(rb_intern3(name, name_length, rb_utf8_encoding()));
+  } else {
+    key = rb_str_new(name, name_length);
+    rb_enc_associate(key, conn_enc);
+    if (default_internal_enc) {
+      key = rb_str_export_to_enc(key, default_internal_enc);
+    }
+#ifdef HAVE_RB_STR_TO_INTERNED_STR
+    key = rb_str_to_interned_str(key);
+#else
+    key = rb_obj_freeze(key);
+#endif
+  }
+
+  if (wrapper->field_keys->num_entries >= MYSQL2_FIELD_KEY_CACHE_SIZE) {
+    mysql2_field_key_cache_clear(wrapper);
+  }
+  entry = ALLOC(mysql2_field_key);
+  *entry = lookup;
+  entry->name = ALLOC_N(char, name_length > 0 ? name_length : 1);
+  memcpy(entry->name, name, name_length);
+  st_insert(wrapper->field_keys, (st_data_t)entry, (st_data_t)key);
+
+  return key;
+}
+
 static void rb_mysql_client_mark(void * wrapper) {
   mysql_client_wrapper * w = wrapper;
   if (w) {
     rb_gc_mark(w->encoding);
     rb_gc_mark(w->active_thread);
+    if (w->field_keys) {
+      st_foreach(w->field_keys, mysql2_field_key_mark_i, 0);
+    }
   }
 }
 
@@ -303,6 +424,10 @@ void decr_mysql2_client(mysql_client_wrapper *wrapper)
 #endif
 
     nogvl_close(wrapper);
+    if (wrapper->field_keys) {
+      mysql2_field_key_cache_clear(wrapper);
+      st_free_table(wrapper->field_keys);
+    }
     xfree(wrapper->client);
     xfree(wrapper);
   }
@@ -321,7 +446,13 @@ static VALUE allocate(VALUE klass) {
   wrapper->initialized = 0; /* means that that the wrapper is initialized */
   wrapper->refcount = 1;
   wrapper->closed = 0;
+  wrapper->nonblocking = 0;
+  wrapper->multi_statements = -1;
+  wrapper->infile_mmap = 0;
   wrapper->client = (MYSQL*)xmalloc(sizeof(MYSQL));
+  wrapper->field_keys = NULL;
+  wrapper->infile_stream = NULL;
+  memset(&wrapper->infile_stats, 0, sizeof(wrapper->infile_stats));
 
   return obj;
 }
@@ -334,26 +465,22 @@ static VALUE allocate(VALUE klass) {
  * If you need encoding support use Mysql2::Client#escape instead.
  */
 static VALUE rb_mysql_client_escape(RB_MYSQL_UNUSED VALUE klass, VALUE str) {
-  unsigned char *newStr;
   VALUE rb_str;
-  unsigned long newLen, oldLen;
+  size_t count, oldLen;
 
   Check_Type(str, T_STRING);
 
   oldLen = RSTRING_LEN(str);
-  newStr = xmalloc(oldLen*2+1);
-
-  newLen = mysql_escape_string((char *)newStr, RSTRING_PTR(str), oldLen);
-  if (newLen == oldLen) {
+  count = mysql2_escape_count(RSTRING_PTR(str), oldLen);
+  if (count == 0) {
     /* no need to return a new ruby string if nothing changed */
-    xfree(newStr);
     return str;
-  } else {
-    rb_str = rb_str_new((const char*)newStr, newLen);
-    rb_enc_copy(rb_str, str);
-    xfree(newStr);
-    return rb_str;
   }
+
+  rb_str = rb_str_new(NULL, oldLen + count);
+  mysql2_escape_copy(RSTRING_PTR(rb_str), RSTRING_PTR(str), oldLen);
+  rb_enc_copy(rb_str, str);
+  return rb_str;
 }
 
 static VALUE rb_mysql_client_warning_count(VALUE self) {
@@ -413,6 +540,129 @@ static int opt_connect_attr_add_i(VALUE key, VALUE value, VALUE arg)
 }
 #endif
 
+#ifdef MYSQL2_NONBLOCKING
+/* libmysqlclient does not say which way a connect is blocked, so it waits
+ * for input (the usual case during the handshake) this many seconds at a
+ * time before giving the library another go */
+#define MYSQL2_CONNECT_POLL 0.01
+
+static double mysql2_client_now(void) {
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+  }
+#endif
+  return (double)time(NULL);
+}
+
+/* Time left until +deadline+ (0 for none), but no more than +cap+ seconds
+ * when +cap+ is not negative. Returns NULL to wait without a limit. */
+static struct timeval *mysql2_connect_timeval(struct timeval *tv, double deadline, double cap) {
+  double left = -1;
+
+  if (deadline > 0) {
+    left = deadline - mysql2_client_now();
+    if (left < 0) left = 0;
+  }
+  if (cap >= 0 && (left < 0 || cap < left)) {
+    left = cap;
+  }
+  if (left < 0) {
+    return NULL;
+  }
+
+  tv->tv_sec = (time_t)left;
+  tv->tv_usec = (long)((left - (double)tv->tv_sec) * 1e6);
+  return tv;
+}
+
+/* Connect without blocking the thread when a Fiber scheduler is current:
+ * MariaDB needs MYSQL_OPT_NONBLOCK to have been set, and libmysqlclient's
+ * *_nonblocking query functions only return NET_ASYNC_NOT_READY on a
+ * socket opened by mysql_real_connect_nonblocking (on any other they block
+ * the whole thread), which a reconnect from inside the library is not.
+ */
+static int mysql2_nonblocking_connect_p(mysql_client_wrapper *wrapper) {
+  if (rb_fiber_scheduler_current() == Qnil) {
+    return 0;
+  }
+#ifdef HAVE_MYSQL_READ_QUERY_RESULT_START
+  return wrapper->nonblocking;
+#else
+  return !wrapper->reconnect_enabled;
+#endif
+}
+
+#ifdef HAVE_MYSQL_READ_QUERY_RESULT_START
+static VALUE nonblocking_connect(mysql_client_wrapper *wrapper, struct nogvl_connect_args *args) {
+  MYSQL *ret;
+  struct timeval tv, *tvp;
+  double deadline = wrapper->connect_timeout ? mysql2_client_now() + wrapper->connect_timeout : 0;
+  int status, events, ready;
+
+  status = mysql_real_connect_start(&ret, args->mysql, args->host,
+                                    args->user, args->passwd,
+                                    args->db, args->port, args->unix_socket,
+                                    args->client_flag);
+  while (status) {
+    events = 0;
+    if (status & MYSQL_WAIT_READ) events |= RB_WAITFD_IN;
+    if (status & MYSQL_WAIT_WRITE) events |= RB_WAITFD_OUT;
+    if (status & MYSQL_WAIT_EXCEPT) events |= RB_WAITFD_PRI;
+
+    /* one deadline for the whole connect, or sooner if the library's own
+     * timeout runs out first */
+    tvp = mysql2_connect_timeval(&tv, deadline,
+                                 (status & MYSQL_WAIT_TIMEOUT) ? mysql_get_timeout_value_ms(args->mysql) / 1000.0 : -1);
+    ready = rb_wait_for_single_fd(mysql_get_socket(args->mysql), events, tvp);
+    if (ready < 0) {
+      rb_sys_fail(0);
+    }
+
+    /* on a timeout the library gives up and sets the error itself */
+    status = 0;
+    if (ready == 0) status |= MYSQL_WAIT_TIMEOUT;
+    if (ready & RB_WAITFD_IN) status |= MYSQL_WAIT_READ;
+    if (ready & RB_WAITFD_OUT) status |= MYSQL_WAIT_WRITE;
+    if (ready & RB_WAITFD_PRI) status |= MYSQL_WAIT_EXCEPT;
+    status = mysql_real_connect_cont(&ret, args->mysql, status);
+  }
+
+  return ret ? Qtrue : Qfalse;
+}
+#else
+static VALUE nonblocking_connect(mysql_client_wrapper *wrapper, struct nogvl_connect_args *args) {
+  enum net_async_status status;
+  struct timeval tv, *tvp;
+  double deadline = wrapper->connect_timeout ? mysql2_client_now() + wrapper->connect_timeout : 0;
+
+  while ((status = mysql_real_connect_nonblocking(args->mysql, args->host,
+                                                  args->user, args->passwd,
+                                                  args->db, args->port, args->unix_socket,
+                                                  args->client_flag)) == NET_ASYNC_NOT_READY) {
+    if (deadline > 0 && mysql2_client_now() >= deadline) {
+      rb_raise(cMysql2TimeoutError, "Timeout connecting to the server. (waited %u seconds)", wrapper->connect_timeout);
+    }
+
+    tvp = mysql2_connect_timeval(&tv, deadline, MYSQL2_CONNECT_POLL);
+    if (args->mysql->net.fd >= 0) {
+      if (rb_wait_for_single_fd(args->mysql->net.fd, RB_WAITFD_IN, tvp) < 0) {
+        rb_sys_fail(0);
+      }
+    } else {
+      /* no socket to wait on yet */
+      rb_fiber_scheduler_kernel_sleep(rb_fiber_scheduler_current(),
+                                      DBL2NUM((double)tvp->tv_sec + (double)tvp->tv_usec / 1e6));
+    }
+  }
+
+  return status == NET_ASYNC_COMPLETE ? Qtrue : Qfalse;
+}
+#endif
+#endif
+
 static VALUE rb_mysql_connect(VALUE self, VALUE user, VALUE pass, VALUE host, VALUE port, VALUE database, VALUE socket, VALUE flags, VALUE conn_attrs) {
   struct nogvl_connect_args args;
   time_t start_time, end_time, elapsed_time, connect_timeout;
@@ -433,6 +683,29 @@ static VALUE rb_mysql_connect(VALUE self, VALUE user, VALUE pass, VALUE host, VA
   rb_hash_foreach(conn_attrs, opt_connect_attr_add_i, (VALUE)wrapper);
 #endif
 
+#if defined(MYSQL2_NONBLOCKING) && defined(HAVE_CONST_MYSQL_OPT_NONBLOCK)
+  /* MariaDB only allows the _start/_cont functions on connections that
+   * were opened with this option; it costs a context stack per client,
+   * so only ask for it when connecting from inside a scheduler */
+  if (!wrapper->nonblocking && rb_fiber_scheduler_current() != Qnil) {
+    wrapper->nonblocking = mysql_options(wrapper->client, MYSQL_OPT_NONBLOCK, 0) == 0;
+  }
+#endif
+
+#ifdef MYSQL2_NONBLOCKING
+  if (mysql2_nonblocking_connect_p(wrapper)) {
+    if (nonblocking_connect(wrapper, &args) == Qfalse)
+      rb_raise_mysql2_error(wrapper);
+    wrapper->nonblocking = 1;
+    wrapper->server_version = mysql_get_server_version(wrapper->client);
+    wrapper->multi_statements = -1;
+    return self;
+  }
+#ifndef HAVE_MYSQL_READ_QUERY_RESULT_START
+  wrapper->nonblocking = 0;
+#endif
+#endif
+
   if (wrapper->connect_timeout)
     time(&start_time);
   rv = (VALUE) rb_thread_call_without_gvl(nogvl_connect, &args, RUBY_UBF_IO, 0);
@@ -463,6 +736,7 @@ static VALUE rb_mysql_connect(VALUE self, VALUE user, VALUE pass, VALUE host, VA
   }
 
   wrapper->server_version = mysql_get_server_version(wrapper->client);
+  wrapper->multi_statements = -1;
   return self;
 }
 
@@ -494,6 +768,174 @@ static VALUE rb_mysql_client_closed(VALUE self) {
   return CONNECTED(wrapper) ? Qfalse : Qtrue;
 }
 
+#ifndef _WIN32
+/* The read_timeout option as a timeval for rb_wait_for_single_fd, or NULL */
+static struct timeval *rb_mysql_client_read_timeout(VALUE self, struct timeval *tvp) {
+  long int sec;
+  VALUE read_timeout;
+
+  read_timeout = rb_iv_get(self, "@read_timeout");
+  if (NIL_P(read_timeout)) {
+    return NULL;
+  }
+
+  Check_Type(read_timeout, T_FIXNUM);
+  sec = FIX2INT(read_timeout);
+  /* TODO: support partial seconds?
+     also, this check is here for sanity, we also check up in Ruby */
+  if (sec >= 0) {
+    tvp->tv_sec = sec;
+  } else {
+    rb_raise(cMysql2Error, "read_timeout must be a positive integer, you passed %ld", sec);
+  }
+  tvp->tv_usec = 0;
+  return tvp;
+}
+
+/* Wait for +events+ on the client socket and return the ready ones */
+static int rb_mysql_client_wait(int fd, int events, struct timeval *tvp) {
+  int retval;
+
+  for(;;) {
+    retval = rb_wait_for_single_fd(fd, events, tvp);
+
+    if (retval == 0) {
+      rb_raise(cMysql2TimeoutError, "Timeout waiting for a response from the last query. (waited %d seconds)", (int)tvp->tv_sec);
+    }
+
+    if (retval < 0) {
+      rb_sys_fail(0);
+    }
+
+    if (retval > 0) {
+      return retval;
+    }
+  }
+}
+#endif
+
+#ifdef MYSQL2_NONBLOCKING
+static int mysql2_nonblocking_p(mysql_client_wrapper *wrapper) {
+  /* a Ruby LOAD DATA source is read from the infile callback, which has to
+   * run on our own stack without the GVL */
+  if (wrapper->infile_stream) {
+    return 0;
+  }
+  if (!wrapper->nonblocking) {
+    return 0;
+  }
+  return rb_fiber_scheduler_current() != Qnil;
+}
+
+#ifdef HAVE_MYSQL_READ_QUERY_RESULT_START
+/*
+ * MariaDB: wait for whatever the last _start/_cont call asked for and
+ * return the status to resume it with
+ */
+static int mysql2_wait_async(mysql_client_wrapper *wrapper, int status, struct timeval *tvp) {
+  int events = 0, ready;
+
+  if (status & MYSQL_WAIT_READ) events |= RB_WAITFD_IN;
+  if (status & MYSQL_WAIT_WRITE) events |= RB_WAITFD_OUT;
+  if (status & MYSQL_WAIT_EXCEPT) events |= RB_WAITFD_PRI;
+
+  if (tvp == NULL && (status & MYSQL_WAIT_TIMEOUT)) {
+    /* no read_timeout of our own, so honour the library's timeouts */
+    struct timeval tv;
+    unsigned int ms = mysql_get_timeout_value_ms(wrapper->client);
+
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    ready = rb_wait_for_single_fd(wrapper->client->net.fd, events, &tv);
+    if (ready == 0) {
+      return MYSQL_WAIT_TIMEOUT;
+    }
+    if (ready < 0) {
+      rb_sys_fail(0);
+    }
+  } else {
+    ready = rb_mysql_client_wait(wrapper->client->net.fd, events, tvp);
+  }
+
+  status = 0;
+  if (ready & RB_WAITFD_IN) status |= MYSQL_WAIT_READ;
+  if (ready & RB_WAITFD_OUT) status |= MYSQL_WAIT_WRITE;
+  if (ready & RB_WAITFD_PRI) status |= MYSQL_WAIT_EXCEPT;
+  return status;
+}
+
+static VALUE nonblocking_send_query(struct nogvl_send_query_args *args) {
+  int ret, status;
+
+  status = mysql_send_query_start(&ret, args->mysql, args->sql_ptr, args->sql_len);
+  while (status) {
+    status = mysql_send_query_cont(&ret, args->mysql, mysql2_wait_async(args->wrapper, status, NULL));
+  }
+
+  return ret == 0 ? Qtrue : Qfalse;
+}
+
+static VALUE nonblocking_read_query_result(mysql_client_wrapper *wrapper, struct timeval *tvp) {
+  my_bool ret;
+  int status;
+
+  status = mysql_read_query_result_start(&ret, wrapper->client);
+  while (status) {
+    status = mysql_read_query_result_cont(&ret, wrapper->client, mysql2_wait_async(wrapper, status, tvp));
+  }
+
+  return ret == 0 ? Qtrue : Qfalse;
+}
+
+static MYSQL_RES *nonblocking_store_result(mysql_client_wrapper *wrapper, struct timeval *tvp) {
+  MYSQL_RES *result;
+  int status;
+
+  status = mysql_store_result_start(&result, wrapper->client);
+  while (status) {
+    status = mysql_store_result_cont(&result, wrapper->client, mysql2_wait_async(wrapper, status, tvp));
+  }
+
+  return result;
+}
+#else
+/*
+ * MySQL 8.0.16+: NET_ASYNC_NOT_READY means the call would have blocked on
+ * the socket, and the same call picks up where it left off once it is ready
+ */
+static VALUE nonblocking_send_query(struct nogvl_send_query_args *args) {
+  enum net_async_status status;
+
+  while ((status = mysql_send_query_nonblocking(args->mysql, args->sql_ptr, args->sql_len)) == NET_ASYNC_NOT_READY) {
+    rb_mysql_client_wait(args->mysql->net.fd, RB_WAITFD_OUT, NULL);
+  }
+
+  return status == NET_ASYNC_COMPLETE ? Qtrue : Qfalse;
+}
+
+static VALUE nonblocking_read_query_result(mysql_client_wrapper *wrapper, struct timeval *tvp) {
+  enum net_async_status status;
+
+  while ((status = mysql_read_query_result_nonblocking(wrapper->client)) == NET_ASYNC_NOT_READY) {
+    rb_mysql_client_wait(wrapper->client->net.fd, RB_WAITFD_IN, tvp);
+  }
+
+  return status == NET_ASYNC_COMPLETE ? Qtrue : Qfalse;
+}
+
+static MYSQL_RES *nonblocking_store_result(mysql_client_wrapper *wrapper, struct timeval *tvp) {
+  MYSQL_RES *result = NULL;
+  enum net_async_status status;
+
+  while ((status = mysql_store_result_nonblocking(wrapper->client, &result)) == NET_ASYNC_NOT_READY) {
+    rb_mysql_client_wait(wrapper->client->net.fd, RB_WAITFD_IN, tvp);
+  }
+
+  return status == NET_ASYNC_ERROR ? NULL : result;
+}
+#endif
+#endif
+
 /*
  * mysql_send_query is unlikely to block since most queries are small
  * enough to fit in a socket buffer, but sometimes large UPDATE and
@@ -511,7 +953,16 @@ static void *nogvl_send_query(void *ptr) {
 static VALUE do_send_query(void *args) {
   struct nogvl_send_query_args *query_args = args;
   mysql_client_wrapper *wrapper = query_args->wrapper;
-  if ((VALUE)rb_thread_call_without_gvl(nogvl_send_query, args, RUBY_UBF_IO, 0) == Qfalse) {
+  VALUE rv;
+
+#ifdef MYSQL2_NONBLOCKING
+  if (mysql2_nonblocking_p(wrapper)) {
+    rv = nonblocking_send_query(query_args);
+  } else
+#endif
+  rv = (VALUE)rb_thread_call_without_gvl(nogvl_send_query, args, RUBY_UBF_IO, 0);
+
+  if (rv == Qfalse) {
     /* an error occurred, we're not active anymore */
     wrapper->active_thread = Qnil;
     rb_raise_mysql2_error(wrapper);
@@ -565,7 +1016,11 @@ static void *nogvl_use_result(void *ptr) {
 static VALUE rb_mysql_client_async_result(VALUE self) {
   MYSQL_RES * result;
   VALUE resultObj;
-  VALUE current, is_streaming;
+  VALUE current, is_streaming, rv;
+#ifdef MYSQL2_NONBLOCKING
+  struct timeval tv, *tvp = NULL;
+  int nonblocking;
+#endif
   GET_CLIENT(self);
 
   /* if we're not waiting on a result, do nothing */
@@ -573,7 +1028,16 @@ static VALUE rb_mysql_client_async_result(VALUE self) {
     return Qnil;
 
   REQUIRE_CONNECTED(wrapper);
-  if ((VALUE)rb_thread_call_without_gvl(nogvl_read_query_result, wrapper->client, RUBY_UBF_IO, 0) == Qfalse) {
+#ifdef MYSQL2_NONBLOCKING
+  nonblocking = mysql2_nonblocking_p(wrapper);
+  if (nonblocking) {
+    tvp = rb_mysql_client_read_timeout(self, &tv);
+    rv = nonblocking_read_query_result(wrapper, tvp);
+  } else
+#endif
+  rv = (VALUE)rb_thread_call_without_gvl(nogvl_read_query_result, wrapper->client, RUBY_UBF_IO, 0);
+
+  if (rv == Qfalse) {
     /* an error occurred, mark this connection inactive */
     wrapper->active_thread = Qnil;
     rb_raise_mysql2_error(wrapper);
@@ -582,6 +1046,11 @@ static VALUE rb_mysql_client_async_result(VALUE self) {
   is_streaming = rb_hash_aref(rb_iv_get(self, "@current_query_options"), sym_stream);
   if (is_streaming == Qtrue) {
     result = (MYSQL_RES *)rb_thread_call_without_gvl(nogvl_use_result, wrapper, RUBY_UBF_IO, 0);
+#ifdef MYSQL2_NONBLOCKING
+  } else if (nonblocking) {
+    result = nonblocking_store_result(wrapper, tvp);
+    wrapper->active_thread = Qnil;
+#endif
   } else {
     result = (MYSQL_RES *)rb_thread_call_without_gvl(nogvl_store_result, wrapper, RUBY_UBF_IO, 0);
   }
@@ -634,43 +1103,8 @@ static VALUE disconnect_and_raise(VALUE self, VALUE error) {
 static VALUE do_query(void *args) {
   struct async_query_args *async_args = args;
   struct timeval tv;
-  struct timeval *tvp;
-  long int sec;
-  int retval;
-  VALUE read_timeout;
 
-  read_timeout = rb_iv_get(async_args->self, "@read_timeout");
-
-  tvp = NULL;
-  if (!NIL_P(read_timeout)) {
-    Check_Type(read_timeout, T_FIXNUM);
-    tvp = &tv;
-    sec = FIX2INT(read_timeout);
-    /* TODO: support partial seconds?
-       also, this check is here for sanity, we also check up in Ruby */
-    if (sec >= 0) {
-      tvp->tv_sec = sec;
-    } else {
-      rb_raise(cMysql2Error, "read_timeout must be a positive integer, you passed %ld", sec);
-    }
-    tvp->tv_usec = 0;
-  }
-
-  for(;;) {
-    retval = rb_wait_for_single_fd(async_args->fd, RB_WAITFD_IN, tvp);
-
-    if (retval == 0) {
-      rb_raise(cMysql2TimeoutError, "Timeout waiting for a response from the last query. (waited %d seconds)", FIX2INT(read_timeout));
-    }
-
-    if (retval < 0) {
-      rb_sys_fail(0);
-    }
-
-    if (retval > 0) {
-      break;
-    }
-  }
+  rb_mysql_client_wait(async_args->fd, RB_WAITFD_IN, rb_mysql_client_read_timeout(async_args->self, &tv));
 
   return Qnil;
 }
@@ -799,6 +1233,21 @@ static VALUE rb_mysql_query(VALUE self, VALUE sql, VALUE current) {
 #endif
 }
 
+/* Whether escaping for this connection is only backslashing the bytes
+ * mysql2_escape_copy handles. Not the case for multibyte charsets other than
+ * UTF-8, where a trail byte can look like a quote, or when the server has
+ * NO_BACKSLASH_ESCAPES set and quotes must be doubled instead.
+ */
+static int mysql2_escape_compatible_p(mysql_client_wrapper *wrapper) {
+  MY_CHARSET_INFO cs;
+
+  if (wrapper->client->server_status & SERVER_STATUS_NO_BACKSLASH_ESCAPES) {
+    return 0;
+  }
+  mysql_get_character_set_info(wrapper->client, &cs);
+  return cs.mbmaxlen <= 1 || (cs.csname && strncmp(cs.csname, "utf8", 4) == 0);
+}
+
 /* call-seq:
  *    client.escape(string)
  *
@@ -820,6 +1269,25 @@ static VALUE rb_mysql_client_real_escape(VALUE self, VALUE str) {
   str = rb_str_export_to_enc(str, conn_enc);
 
   oldLen = RSTRING_LEN(str);
+
+  if (mysql2_escape_compatible_p(wrapper)) {
+    size_t count = mysql2_escape_count(RSTRING_PTR(str), oldLen);
+    if (count == 0) {
+      /* no need to return a new ruby string if nothing changed */
+      if (default_internal_enc) {
+        str = rb_str_export_to_enc(str, default_internal_enc);
+      }
+      return str;
+    }
+    rb_str = rb_str_new(NULL, oldLen + count);
+    mysql2_escape_copy(RSTRING_PTR(rb_str), RSTRING_PTR(str), oldLen);
+    rb_enc_associate(rb_str, conn_enc);
+    if (default_internal_enc) {
+      rb_str = rb_str_export_to_enc(rb_str, default_internal_enc);
+    }
+    return rb_str;
+  }
+
   newStr = xmalloc(oldLen*2+1);
 
   newLen = mysql_real_escape_string(wrapper->client, (char *)newStr, RSTRING_PTR(str), oldLen);
@@ -1108,7 +1576,15 @@ static VALUE rb_mysql_client_ping(VALUE self) {
 static VALUE rb_mysql_client_set_server_option(VALUE self, VALUE value) {
   GET_CLIENT(self);
 
-  if (mysql_set_server_option(wrapper->client, NUM2INT(value)) == 0) {
+  int option = NUM2INT(value);
+
+  if (mysql_set_server_option(wrapper->client, option) == 0) {
+#ifdef HAVE_CONST_MYSQL_OPTION_MULTI_STATEMENTS_ON
+    if (option == MYSQL_OPTION_MULTI_STATEMENTS_ON) wrapper->multi_statements = 1;
+#endif
+#ifdef HAVE_CONST_MYSQL_OPTION_MULTI_STATEMENTS_OFF
+    if (option == MYSQL_OPTION_MULTI_STATEMENTS_OFF) wrapper->multi_statements = 0;
+#endif
     return Qtrue;
   } else {
     return Qfalse;
@@ -1129,6 +1605,14 @@ static VALUE rb_mysql_client_more_results(VALUE self)
     return Qtrue;
 }
 
+/* mysql_next_result reads the next statement's result header, which can
+ * mean waiting for the server to run it */
+static void *nogvl_next_result(void *ptr) {
+  mysql_client_wrapper *wrapper = ptr;
+
+  return (void *)(intptr_t)mysql_next_result(wrapper->client);
+}
+
 /* call-seq:
  *    client.next_result
  *
@@ -1139,7 +1623,7 @@ static VALUE rb_mysql_client_next_result(VALUE self)
 {
     int ret;
     GET_CLIENT(self);
-    ret = mysql_next_result(wrapper->client);
+    ret = (int)(intptr_t)rb_thread_call_without_gvl(nogvl_next_result, wrapper, RUBY_UBF_IO, 0);
     if (ret > 0) {
       rb_raise_mysql2_error(wrapper);
       return Qfalse;
@@ -1182,6 +1666,477 @@ static VALUE rb_mysql_client_store_result(VALUE self)
   return resultObj;
 }
 
+/* Move on to the next result set of a multi-statement query and return its
+ * Result (nil if the statement returned no rows), or Qundef if there are no
+ * more. Raises the error of a failed statement.
+ */
+static VALUE rb_mysql_client_read_next_result(VALUE self) {
+  int ret;
+  GET_CLIENT(self);
+
+  if (!mysql_more_results(wrapper->client)) {
+    return Qundef;
+  }
+
+  ret = (int)(intptr_t)rb_thread_call_without_gvl(nogvl_next_result, wrapper, RUBY_UBF_IO, 0);
+  if (ret > 0) {
+    rb_raise_mysql2_error(wrapper);
+  } else if (ret < 0) {
+    return Qundef;
+  }
+
+  return rb_mysql_client_store_result(self);
+}
+
+/* Result, affected rows and insert id of the statement that was just read. */
+static VALUE rb_mysql_client_query_result(mysql_client_wrapper *wrapper, VALUE result) {
+  my_ulonglong affected_rows = mysql_affected_rows(wrapper->client);
+
+  return rb_struct_new(cMysql2QueryResult, result,
+                       affected_rows == (my_ulonglong)-1 ? Qnil : ULL2NUM(affected_rows),
+                       ULL2NUM(mysql_insert_id(wrapper->client)));
+}
+
+/* call-seq:
+ *    client.multi_statements?
+ *
+ * Whether the connection currently accepts several statements per query.
+ * The last set_server_option call with OPTION_MULTI_STATEMENTS_ON or
+ * OPTION_MULTI_STATEMENTS_OFF wins; before that, the MULTI_STATEMENTS
+ * connect flag decides.
+ */
+static VALUE rb_mysql_client_multi_statements(VALUE self) {
+  GET_CLIENT(self);
+  REQUIRE_CONNECTED(wrapper);
+
+  if (wrapper->multi_statements >= 0) {
+    return wrapper->multi_statements ? Qtrue : Qfalse;
+  }
+  return (wrapper->client->client_flag & CLIENT_MULTI_STATEMENTS) ? Qtrue : Qfalse;
+}
+
+/* call-seq:
+ *    client._pipeline(sql, options)
+ *
+ * Send +sql+, which holds one statement per entry of +options+, and read
+ * back the result of each statement in turn (nil for those that return no
+ * rows), built with the matching entry of +options+.
+ */
+static VALUE rb_mysql_client_pipeline(VALUE self, VALUE sql, VALUE options) {
+  VALUE results;
+  long i, count;
+  GET_CLIENT(self);
+
+  Check_Type(options, T_ARRAY);
+  count = RARRAY_LEN(options);
+  results = rb_ary_new2(count);
+
+  rb_ary_push(results, rb_mysql_query(self, sql, rb_ary_entry(options, 0)));
+
+  for (i = 1; i < count; i++) {
+    VALUE result;
+
+    rb_iv_set(self, "@current_query_options", rb_ary_entry(options, i));
+    result = rb_mysql_client_read_next_result(self);
+    if (result == Qundef) {
+      rb_raise(cMysql2Error, "Expected %ld results from the pipeline but the server only sent %ld", count, i);
+    }
+    rb_ary_push(results, result);
+  }
+
+  if (mysql_more_results(wrapper->client)) {
+    rb_mysql_client_abandon_results(self);
+    rb_raise(cMysql2Error, "The pipeline sent back more results than it had queries; each query must be a single statement");
+  }
+
+  return results;
+}
+
+/* call-seq:
+ *    client._query_multi(sql, options)
+ *
+ * Run +sql+, which may hold several statements, and read every result set
+ * it produces in one go. Returns a Mysql2::Client::QueryResult per statement.
+ */
+static VALUE rb_mysql_client_query_multi(VALUE self, VALUE sql, VALUE options) {
+  VALUE results, result;
+  GET_CLIENT(self);
+
+  results = rb_ary_new();
+
+  result = rb_mysql_query(self, sql, options);
+  rb_ary_push(results, rb_mysql_client_query_result(wrapper, result));
+
+  while ((result = rb_mysql_client_read_next_result(self)) != Qundef) {
+    rb_ary_push(results, rb_mysql_client_query_result(wrapper, result));
+  }
+
+  return results;
+}
+
+/* Make room for +need+ more bytes in the insert buffer, at least doubling it
+ * so that appending row after row stays linear.
+ */
+static char *insert_buf_reserve(VALUE buf, long need) {
+  long len = RSTRING_LEN(buf);
+
+  if ((long)rb_str_capacity(buf) - len < need) {
+    rb_str_modify_expand(buf, need > len ? need : len);
+  }
+  return RSTRING_PTR(buf) + len;
+}
+
+static void insert_buf_cat_escaped(mysql_client_wrapper *wrapper, VALUE buf, VALUE str, rb_encoding *conn_enc) {
+  unsigned long oldLen, newLen;
+  char *dest;
+
+  str = rb_str_export_to_enc(str, conn_enc);
+  oldLen = RSTRING_LEN(str);
+
+  if (mysql2_escape_compatible_p(wrapper)) {
+    newLen = oldLen + mysql2_escape_count(RSTRING_PTR(str), oldLen);
+    dest = insert_buf_reserve(buf, newLen + 2);
+    *dest++ = '\'';
+    mysql2_escape_copy(dest, RSTRING_PTR(str), oldLen);
+  } else {
+    dest = insert_buf_reserve(buf, oldLen * 2 + 2);
+    *dest++ = '\'';
+    newLen = mysql_real_escape_string(wrapper->client, dest, RSTRING_PTR(str), oldLen);
+    if (newLen == (unsigned long)-1) {
+      rb_raise(cMysql2Error, "Unable to escape value (NO_BACKSLASH_ESCAPES is set)");
+    }
+  }
+  dest[newLen] = '\'';
+  rb_str_set_len(buf, RSTRING_LEN(buf) + newLen + 2);
+  RB_GC_GUARD(str);
+}
+
+/* Append +value+ as an SQL literal */
+static void insert_buf_cat_value(mysql_client_wrapper *wrapper, VALUE buf, VALUE value, rb_encoding *conn_enc) {
+  char num[32];
+  int len;
+
+  switch (TYPE(value)) {
+    case T_NIL:
+      rb_str_buf_cat(buf, "NULL", 4);
+      return;
+    case T_TRUE:
+      rb_str_buf_cat(buf, "1", 1);
+      return;
+    case T_FALSE:
+      rb_str_buf_cat(buf, "0", 1);
+      return;
+    case T_FIXNUM:
+      len = snprintf(num, sizeof(num), "%ld", FIX2LONG(value));
+      rb_str_buf_cat(buf, num, len);
+      return;
+    case T_BIGNUM:
+      rb_str_buf_append(buf, rb_big2str(value, 10));
+      return;
+    case T_FLOAT:
+      {
+        double d = RFLOAT_VALUE(value);
+        if (isnan(d) || isinf(d)) {
+          rb_raise(rb_eArgError, "can't serialize %s as an SQL literal", RSTRING_PTR(rb_funcall(value, intern_to_s, 0)));
+        }
+        /* Float#to_s is the shortest form that reads back as the same double */
+        rb_str_buf_append(buf, rb_funcall(value, intern_to_s, 0));
+      }
+      return;
+    case T_STRING:
+      insert_buf_cat_escaped(wrapper, buf, value, conn_enc);
+      return;
+    case T_SYMBOL:
+      insert_buf_cat_escaped(wrapper, buf, rb_sym2str(value), conn_enc);
+      return;
+    default:
+      if (rb_obj_is_kind_of(value, rb_cTime) || rb_obj_is_kind_of(value, cDateTime)) {
+        VALUE str = rb_funcall(value, intern_strftime, 1, rb_str_new2("%Y-%m-%d %H:%M:%S.%6N"));
+        insert_buf_cat_escaped(wrapper, buf, str, conn_enc);
+      } else if (rb_obj_is_kind_of(value, cDate)) {
+        VALUE str = rb_funcall(value, intern_strftime, 1, rb_str_new2("%Y-%m-%d"));
+        insert_buf_cat_escaped(wrapper, buf, str, conn_enc);
+      } else if (rb_obj_is_kind_of(value, cBigDecimal)) {
+        rb_str_buf_append(buf, rb_funcall(value, intern_to_s, 1, rb_str_new2("F")));
+      } else {
+        rb_raise(rb_eTypeError, "can't serialize %s as an SQL literal", rb_obj_classname(value));
+      }
+      return;
+  }
+}
+
+/* call-seq:
+ *    client._each_insert(prefix, column_count, rows, max_packet) { |sql| ... }
+ *
+ * Serialize +rows+ into the VALUES lists of multi-row INSERTs that begin with
+ * +prefix+, escaping strings straight into one statement buffer. A statement
+ * is yielded once the next row would make it +max_packet+ bytes or longer.
+ */
+static VALUE rb_mysql_client_each_insert(VALUE self, VALUE prefix, VALUE column_count, VALUE rows, VALUE max_packet) {
+  VALUE buf;
+  long i, j, ncols, limit, prefix_len, row_start;
+  rb_encoding *conn_enc;
+  GET_CLIENT(self);
+
+  REQUIRE_CONNECTED(wrapper);
+  Check_Type(rows, T_ARRAY);
+  conn_enc = rb_to_encoding(wrapper->encoding);
+  prefix = rb_str_export_to_enc(StringValue(prefix), conn_enc);
+  prefix_len = RSTRING_LEN(prefix);
+  ncols = NUM2LONG(column_count);
+  limit = NUM2LONG(max_packet);
+
+  buf = rb_str_buf_new(prefix_len + 1024);
+  rb_enc_associate(buf, conn_enc);
+  rb_str_buf_append(buf, prefix);
+
+  for (i = 0; i < RARRAY_LEN(rows); i++) {
+    VALUE row = rb_ary_entry(rows, i);
+
+    Check_Type(row, T_ARRAY);
+    if (RARRAY_LEN(row) != ncols) {
+      rb_raise(rb_eArgError, "row %ld has %ld values for %ld columns", i, RARRAY_LEN(row), ncols);
+    }
+
+    row_start = RSTRING_LEN(buf);
+    if (row_start > prefix_len) {
+      rb_str_buf_cat(buf, ",", 1);
+    }
+    rb_str_buf_cat(buf, "(", 1);
+    for (j = 0; j < ncols; j++) {
+      if (j > 0) {
+        rb_str_buf_cat(buf, ",", 1);
+      }
+      insert_buf_cat_value(wrapper, buf, rb_ary_entry(row, j), conn_enc);
+    }
+    rb_str_buf_cat(buf, ")", 1);
+
+    if (RSTRING_LEN(buf) >= limit) {
+      VALUE next;
+      long row_len = RSTRING_LEN(buf) - row_start - 1;
+
+      if (row_start == prefix_len) {
+        rb_raise(cMysql2Error, "row %ld does not fit in max_packet (%ld bytes)", i, limit);
+      }
+
+      /* move the row that did not fit into the next statement */
+      next = rb_str_buf_new(RSTRING_LEN(buf) > prefix_len + 1024 ? RSTRING_LEN(buf) : prefix_len + 1024);
+      rb_enc_associate(next, conn_enc);
+      rb_str_buf_append(next, prefix);
+      rb_str_buf_cat(next, RSTRING_PTR(buf) + row_start + 1, row_len);
+      if (RSTRING_LEN(next) >= limit) {
+        rb_raise(cMysql2Error, "row %ld does not fit in max_packet (%ld bytes)", i, limit);
+      }
+      rb_str_set_len(buf, row_start);
+      rb_enc_associate(buf, conn_enc);
+      rb_yield(buf);
+      buf = next;
+    }
+  }
+
+  if (RSTRING_LEN(buf) > prefix_len) {
+    rb_enc_associate(buf, conn_enc);
+    rb_yield(buf);
+  }
+
+  return Qnil;
+}
+
+/* call-seq:
+ *    client._query_template(sql)
+ *
+ * Split +sql+ at its ? placeholders into a frozen Array of frozen fragments,
+ * one more than there are placeholders. Question marks inside quoted strings,
+ * quoted identifiers and comments are left alone.
+ */
+static VALUE rb_mysql_client_query_template(VALUE self, VALUE sql) {
+  VALUE fragments;
+  const char *p, *start, *end;
+  rb_encoding *conn_enc;
+  GET_CLIENT(self);
+
+  conn_enc = rb_to_encoding(wrapper->encoding);
+  sql = rb_str_export_to_enc(StringValue(sql), conn_enc);
+  fragments = rb_ary_new();
+
+  start = p = RSTRING_PTR(sql);
+  end = p + RSTRING_LEN(sql);
+  while (p < end) {
+    char c = *p++;
+
+    switch (c) {
+      case '?':
+        rb_ary_push(fragments, rb_obj_freeze(rb_enc_str_new(start, p - 1 - start, conn_enc)));
+        start = p;
+        break;
+      case '\'':
+      case '"':
+      case '`':
+        /* a doubled quote stays inside the literal, backslash escapes don't apply to identifiers */
+        while (p < end) {
+          if ((unsigned char)*p >= 0x80) {
+            /* skip whole characters, sjis and gbk trail bytes can be a backslash */
+            p += rb_enc_mbclen(p, end, conn_enc);
+          } else if (*p == '\\' && c != '`' && p + 1 < end) {
+            p += 2;
+          } else if (*p++ == c) {
+            if (p < end && *p == c) {
+              p++;
+            } else {
+              break;
+            }
+          }
+        }
+        break;
+      case '#':
+        while (p < end && *p != '\n') p++;
+        break;
+      case '-':
+        if (p + 1 < end && *p == '-' && (p[1] == ' ' || p[1] == '\t' || p[1] == '\n')) {
+          while (p < end && *p != '\n') p++;
+        }
+        break;
+      case '/':
+        if (p < end && *p == '*') {
+          for (p++; p < end && !(p[0] == '*' && p + 1 < end && p[1] == '/'); p++);
+          p = p + 2 < end ? p + 2 : end;
+        }
+        break;
+    }
+  }
+  rb_ary_push(fragments, rb_obj_freeze(rb_enc_str_new(start, end - start, conn_enc)));
+  RB_GC_GUARD(sql);
+
+  return rb_obj_freeze(fragments);
+}
+
+/* call-seq:
+ *    client._query_with_binds(template, values, options)
+ *
+ * Interpolate +values+ as SQL literals between the fragments of +template+
+ * (from _query_template) into a single buffer and run it like Client#query.
+ * An Array value becomes a comma separated list, for IN (?).
+ */
+static VALUE rb_mysql_client_query_with_binds(VALUE self, VALUE template, VALUE values, VALUE options) {
+  VALUE buf;
+  long i, j, nvalues, len = 0;
+  rb_encoding *conn_enc;
+  GET_CLIENT(self);
+
+  REQUIRE_CONNECTED(wrapper);
+  Check_Type(template, T_ARRAY);
+  Check_Type(values, T_ARRAY);
+  nvalues = RARRAY_LEN(values);
+  if (RARRAY_LEN(template) != nvalues + 1) {
+    rb_raise(rb_eArgError, "wrong number of bind values (given %ld, expected %ld)", nvalues, RARRAY_LEN(template) - 1);
+  }
+  conn_enc = rb_to_encoding(wrapper->encoding);
+
+  for (i = 0; i <= nvalues; i++) {
+    len += RSTRING_LEN(rb_ary_entry(template, i));
+  }
+  buf = rb_str_buf_new(len + nvalues * 16);
+  rb_enc_associate(buf, conn_enc);
+
+  for (i = 0; i < nvalues; i++) {
+    VALUE value = rb_ary_entry(values, i);
+
+    rb_str_buf_append(buf, rb_ary_entry(template, i));
+    if (RB_TYPE_P(value, T_ARRAY)) {
+      if (RARRAY_LEN(value) == 0) {
+        rb_raise(rb_eArgError, "bind value %ld is an empty Array", i);
+      }
+      for (j = 0; j < RARRAY_LEN(value); j++) {
+        if (j > 0) {
+          rb_str_buf_cat(buf, ",", 1);
+        }
+        insert_buf_cat_value(wrapper, buf, rb_ary_entry(value, j), conn_enc);
+      }
+    } else {
+      insert_buf_cat_value(wrapper, buf, value, conn_enc);
+    }
+  }
+  rb_str_buf_append(buf, rb_ary_entry(template, nvalues));
+  rb_enc_associate(buf, conn_enc);
+
+  return rb_mysql_query(self, buf, options);
+}
+
+static VALUE rb_mysql_client_load_data_query(VALUE args) {
+  return rb_mysql_query(rb_ary_entry(args, 0), rb_ary_entry(args, 1), rb_ary_entry(args, 2));
+}
+
+/* call-seq:
+ *    client._load_data(sql, reader, options)
+ *
+ * Run the LOAD DATA LOCAL INFILE statement +sql+, sending whatever +reader+
+ * returns on each call (a String, or nil at the end) instead of the file it
+ * names. An exception raised by +reader+ aborts the load and is re-raised.
+ */
+static VALUE rb_mysql_client_load_data(VALUE self, VALUE sql, VALUE reader, VALUE options) {
+  mysql2_infile_stream stream;
+  VALUE result;
+  int state = 0;
+  GET_CLIENT(self);
+
+  stream.reader = reader;
+  stream.chunk = Qnil;
+  stream.chunk_offset = 0;
+  stream.error = Qnil;
+  stream.error_state = 0;
+
+  wrapper->infile_stream = &stream;
+  result = rb_protect(rb_mysql_client_load_data_query, rb_ary_new3(3, self, sql, options), &state);
+  wrapper->infile_stream = NULL;
+
+  if (stream.error_state) {
+    if (rb_obj_is_kind_of(stream.error, rb_eException)) {
+      rb_exc_raise(stream.error);
+    }
+    rb_jump_tag(stream.error_state);
+  }
+  if (state) {
+    rb_jump_tag(state);
+  }
+
+  RB_GC_GUARD(stream.reader);
+  RB_GC_GUARD(stream.chunk);
+  return result;
+}
+
+/* call-seq:
+ *    client.infile_stats
+ *
+ * Returns counters of the last LOAD DATA LOCAL INFILE run on this
+ * connection: where the data came from (+mmap+, +read+ or +ruby+), the
+ * bytes sent, the number of reads libmysql made, the seconds it took and
+ * the resulting throughput. Returns nil before the first load.
+ */
+static VALUE rb_mysql_client_infile_stats(VALUE self) {
+  VALUE stats;
+  double seconds;
+  GET_CLIENT(self);
+
+  if (!wrapper->infile_stats.source) {
+    return Qnil;
+  }
+
+  seconds = wrapper->infile_stats.finished_at - wrapper->infile_stats.started_at;
+  if (seconds < 0) {
+    seconds = 0;
+  }
+
+  stats = rb_hash_new();
+  rb_hash_aset(stats, sym_source, ID2SYM(rb_intern(wrapper->infile_stats.source)));
+  rb_hash_aset(stats, sym_bytes, ULL2NUM(wrapper->infile_stats.bytes));
+  rb_hash_aset(stats, sym_reads, ULONG2NUM(wrapper->infile_stats.reads));
+  rb_hash_aset(stats, sym_seconds, DBL2NUM(seconds));
+  rb_hash_aset(stats, sym_bytes_per_second,
+               seconds > 0 ? DBL2NUM(wrapper->infile_stats.bytes / seconds) : Qnil);
+
+  return stats;
+}
+
 /* call-seq:
  *    client.encoding
  *
@@ -1240,6 +2195,12 @@ static VALUE set_local_infile(VALUE self, VALUE value) {
   return _mysql_client_options(self, MYSQL_OPT_LOCAL_INFILE, value);
 }
 
+static VALUE set_local_infile_mmap(VALUE self, VALUE value) {
+  GET_CLIENT(self);
+  wrapper->infile_mmap = RTEST(value);
+  return value;
+}
+
 static VALUE set_connect_timeout(VALUE self, VALUE value) {
   long int sec;
   Check_Type(value, T_FIXNUM);
@@ -1356,9 +2317,9 @@ static VALUE initialize_ext(VALUE self) {
   return self;
 }
 
-/* call-seq: client.prepare # => Mysql2::Statement
+/* call-seq: client._prepare(sql) # => Mysql2::Statement
  *
- * Create a new prepared statement.
+ * Create a new prepared statement, bypassing the statement cache.
  */
 static VALUE rb_mysql_client_prepare_statement(VALUE self, VALUE sql) {
   GET_CLIENT(self);
@@ -1412,7 +2373,6 @@ void init_mysql2_client() {
   rb_define_method(cMysql2Client, "async_result", rb_mysql_client_async_result, 0);
   rb_define_method(cMysql2Client, "last_id", rb_mysql_client_last_id, 0);
   rb_define_method(cMysql2Client, "affected_rows", rb_mysql_client_affected_rows, 0);
-  rb_define_method(cMysql2Client, "prepare", rb_mysql_client_prepare_statement, 1);
   rb_define_method(cMysql2Client, "thread_id", rb_mysql_client_thread_id, 0);
   rb_define_method(cMysql2Client, "ping", rb_mysql_client_ping, 0);
   rb_define_method(cMysql2Client, "select_db", rb_mysql_client_select_db, 1);
@@ -1420,6 +2380,7 @@ void init_mysql2_client() {
   rb_define_method(cMysql2Client, "more_results?", rb_mysql_client_more_results, 0);
   rb_define_method(cMysql2Client, "next_result", rb_mysql_client_next_result, 0);
   rb_define_method(cMysql2Client, "store_result", rb_mysql_client_store_result, 0);
+  rb_define_method(cMysql2Client, "multi_statements?", rb_mysql_client_multi_statements, 0);
   rb_define_method(cMysql2Client, "automatic_close?", get_automatic_close, 0);
   rb_define_method(cMysql2Client, "automatic_close=", set_automatic_close, 1);
   rb_define_method(cMysql2Client, "reconnect=", set_reconnect, 1);
@@ -1432,6 +2393,7 @@ void init_mysql2_client() {
   rb_define_private_method(cMysql2Client, "read_timeout=", set_read_timeout, 1);
   rb_define_private_method(cMysql2Client, "write_timeout=", set_write_timeout, 1);
   rb_define_private_method(cMysql2Client, "local_infile=", set_local_infile, 1);
+  rb_define_private_method(cMysql2Client, "local_infile_mmap=", set_local_infile_mmap, 1);
   rb_define_private_method(cMysql2Client, "charset_name=", set_charset_name, 1);
   rb_define_private_method(cMysql2Client, "secure_auth=", set_secure_auth, 1);
   rb_define_private_method(cMysql2Client, "default_file=", set_read_default_file, 1);
@@ -1443,6 +2405,22 @@ void init_mysql2_client() {
   rb_define_private_method(cMysql2Client, "initialize_ext", initialize_ext, 0);
   rb_define_private_method(cMysql2Client, "connect", rb_mysql_connect, 8);
   rb_define_private_method(cMysql2Client, "_query", rb_mysql_query, 2);
+  rb_define_private_method(cMysql2Client, "_query_template", rb_mysql_client_query_template, 1);
+  rb_define_private_method(cMysql2Client, "_query_with_binds", rb_mysql_client_query_with_binds, 3);
+  rb_define_private_method(cMysql2Client, "_prepare", rb_mysql_client_prepare_statement, 1);
+  rb_define_private_method(cMysql2Client, "_pipeline", rb_mysql_client_pipeline, 2);
+  rb_define_private_method(cMysql2Client, "_query_multi", rb_mysql_client_query_multi, 2);
+  rb_define_private_method(cMysql2Client, "_each_insert", rb_mysql_client_each_insert, 4);
+  rb_define_private_method(cMysql2Client, "_load_data", rb_mysql_client_load_data, 3);
+  rb_define_method(cMysql2Client, "infile_stats", rb_mysql_client_infile_stats, 0);
+
+  /* One statement's outcome, as returned by Client#query_multi */
+  cMysql2QueryResult = rb_struct_define_under(cMysql2Client, "QueryResult", "result", "affected_rows", "last_id", NULL);
+  rb_global_variable(&cMysql2QueryResult);
+
+  cDate = rb_const_get(rb_cObject, rb_intern("Date"));
+  cDateTime = rb_const_get(rb_cObject, rb_intern("DateTime"));
+  cBigDecimal = rb_const_get(rb_cObject, rb_intern("BigDecimal"));
 
   sym_id              = ID2SYM(rb_intern("id"));
   sym_version         = ID2SYM(rb_intern("version"));
@@ -1452,6 +2430,11 @@ void init_mysql2_client() {
   sym_as              = ID2SYM(rb_intern("as"));
   sym_array           = ID2SYM(rb_intern("array"));
   sym_stream          = ID2SYM(rb_intern("stream"));
+  sym_source          = ID2SYM(rb_intern("source"));
+  sym_bytes           = ID2SYM(rb_intern("bytes"));
+  sym_reads           = ID2SYM(rb_intern("reads"));
+  sym_seconds         = ID2SYM(rb_intern("seconds"));
+  sym_bytes_per_second = ID2SYM(rb_intern("bytes_per_second"));
 
   sym_no_good_index_used = ID2SYM(rb_intern("no_good_index_used"));
   sym_no_index_used      = ID2SYM(rb_intern("no_index_used"));
@@ -1461,6 +2444,8 @@ void init_mysql2_client() {
   intern_merge = rb_intern("merge");
   intern_merge_bang = rb_intern("merge!");
   intern_new_with_args = rb_intern("new_with_args");
+  intern_to_s = rb_intern("to_s");
+  intern_strftime = rb_intern("strftime");
 
 #ifdef CLIENT_LONG_PASSWORD
   rb_const_set(cMysql2Client, rb_intern("LONG_PASSWORD"),
@@ -1546,6 +2531,13 @@ void init_mysql2_client() {
   rb_const_set(cMysql2Client, rb_intern("SECURE_CONNECTION"), LONG2NUM(0));
 #endif
 
+  /* whether connections made inside a Fiber scheduler yield to it */
+#ifdef MYSQL2_NONBLOCKING
+  rb_const_set(cMysql2Client, rb_intern("NONBLOCKING"), Qtrue);
+#else
+  rb_const_set(cMysql2Client, rb_intern("NONBLOCKING"), Qfalse);
+#endif
+
 #ifdef HAVE_CONST_MYSQL_OPTION_MULTI_STATEMENTS_ON
   rb_const_set(cMysql2Client, rb_intern("OPTION_MULTI_STATEMENTS_ON"),
       LONG2NUM(MYSQL_OPTION_MULTI_STATEMENTS_ON));
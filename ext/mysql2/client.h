@@ -12,11 +12,25 @@ typedef struct {
   int initialized;
   int refcount;
   int closed;
+  int nonblocking; /* MYSQL_OPT_NONBLOCK was set (MariaDB), or connected with mysql_real_connect_nonblocking (MySQL) */
+  int multi_statements; /* last set_server_option MULTI_STATEMENTS value, -1 if never set */
   MYSQL *client;
+  st_table *field_keys; /* see rb_mysql_client_field_key */
+  struct mysql2_infile_stream *infile_stream; /* Client#load_data source, or NULL */
+  int infile_mmap; /* map local files instead of read(2), see :local_infile_mmap */
+  /* counters of the last LOAD DATA LOCAL INFILE, see Client#infile_stats */
+  struct {
+    const char *source; /* "mmap", "read" or "ruby", NULL before the first load */
+    unsigned long long bytes;
+    unsigned long reads;
+    double started_at;
+    double finished_at;
+  } infile_stats;
 } mysql_client_wrapper;
 
 void rb_mysql_client_set_active_thread(VALUE self);
 void rb_mysql_set_server_query_flags(MYSQL *client, VALUE result);
+VALUE rb_mysql_client_field_key(mysql_client_wrapper *wrapper, const char *name, long name_length, int symbolize_keys, rb_encoding *conn_enc);
 
 #define GET_CLIENT(self) \
   mysql_client_wrapper *wrapper; \
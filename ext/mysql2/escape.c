@@ -0,0 +1,160 @@
+#include <mysql2_ext.h>
+
+/* The bytes mysql_real_escape_string puts a backslash in front of, mapped to
+ * the character that follows it: NUL, \n, \r, \\, ', " and ^Z. Outside of
+ * multibyte charsets like Shift-JIS or GBK, whose characters can contain
+ * these bytes, escaping is nothing more than this table.
+ */
+static const unsigned char escape_map[256] = {
+  [0] = '0', ['\n'] = 'n', ['\r'] = 'r', ['\\'] = '\\',
+  ['\''] = '\'', ['"'] = '"', [032] = 'Z'
+};
+
+static size_t escape_count_scalar(const unsigned char *str, size_t len) {
+  size_t i, count = 0;
+
+  for (i = 0; i < len; i++) {
+    count += escape_map[str[i]] != 0;
+  }
+  return count;
+}
+
+static size_t escape_find_scalar(const unsigned char *str, size_t len) {
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    if (escape_map[str[i]]) break;
+  }
+  return i;
+}
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* 0xff in every byte of +v+ that needs escaping */
+static inline __m128i escape_mask_sse2(__m128i v) {
+  __m128i hit;
+
+  hit = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+  return _mm_or_si128(hit, _mm_cmpeq_epi8(v, _mm_set1_epi8(032)));
+}
+
+static size_t escape_count_sse2(const unsigned char *str, size_t len) {
+  size_t i = 0, count = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+    count += __builtin_popcount(_mm_movemask_epi8(escape_mask_sse2(v)));
+  }
+  return count + escape_count_scalar(str + i, len - i);
+}
+
+static size_t escape_find_sse2(const unsigned char *str, size_t len) {
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+    int mask = _mm_movemask_epi8(escape_mask_sse2(v));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  return i + escape_find_scalar(str + i, len - i);
+}
+
+#define escape_count_default escape_count_sse2
+#define escape_find_default escape_find_sse2
+#else
+#define escape_count_default escape_count_scalar
+#define escape_find_default escape_find_scalar
+#endif
+
+/* AVX2 versions are compiled for x86-64 regardless of -march and picked at
+ * load time if the CPU has it.
+ */
+#if defined(__x86_64__) && (__GNUC__ >= 5 || (defined(__clang__) && __clang_major__ >= 4))
+#define MYSQL2_ESCAPE_AVX2
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static inline __m256i escape_mask_avx2(__m256i v) {
+  __m256i hit;
+
+  hit = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+  return _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(032)));
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t escape_count_avx2(const unsigned char *str, size_t len) {
+  size_t i = 0, count = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(str + i));
+    count += __builtin_popcount((unsigned int)_mm256_movemask_epi8(escape_mask_avx2(v)));
+  }
+  return count + escape_count_default(str + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t escape_find_avx2(const unsigned char *str, size_t len) {
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(str + i));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(escape_mask_avx2(v));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  return i + escape_find_default(str + i, len - i);
+}
+#endif
+
+static size_t (*escape_count)(const unsigned char *, size_t) = escape_count_default;
+static size_t (*escape_find)(const unsigned char *, size_t) = escape_find_default;
+
+/* Number of bytes in +str+ that need escaping, so 0 means it can be used
+ * as it is and +len+ plus the count is the escaped length.
+ */
+size_t mysql2_escape_count(const char *str, size_t len) {
+  return escape_count((const unsigned char *)str, len);
+}
+
+/* Backslash escape +str+ into +dest+ the way mysql_real_escape_string does
+ * for single byte and UTF-8 charsets, copying the clean runs between special
+ * bytes in bulk. +dest+ needs room for len + mysql2_escape_count(str, len)
+ * bytes. Returns the number of bytes written.
+ */
+size_t mysql2_escape_copy(char *dest, const char *str, size_t len) {
+  const unsigned char *src = (const unsigned char *)str;
+  char *out = dest;
+  size_t start = 0, i;
+
+  while ((i = start + escape_find(src + start, len - start)) < len) {
+    memcpy(out, src + start, i - start);
+    out += i - start;
+    *out++ = '\\';
+    *out++ = (char)escape_map[src[i]];
+    start = i + 1;
+  }
+  memcpy(out, src + start, len - start);
+  out += len - start;
+
+  return (size_t)(out - dest);
+}
+
+void init_mysql2_escape() {
+#ifdef MYSQL2_ESCAPE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    escape_count = escape_count_avx2;
+    escape_find = escape_find_avx2;
+  }
+#endif
+}
@@ -0,0 +1,9 @@
+#ifndef MYSQL2_ESCAPE_H
+#define MYSQL2_ESCAPE_H
+
+size_t mysql2_escape_count(const char *str, size_t len);
+size_t mysql2_escape_copy(char *dest, const char *str, size_t len);
+
+void init_mysql2_escape(void);
+
+#endif
@@ -25,9 +25,29 @@ end
 have_func('rb_absint_size')
 have_func('rb_absint_singlebit_p')
 
+# 2.3+
+have_func('rb_time_timespec_new')
+
+# 3.0+
+have_func('rb_str_to_interned_str')
+
+# 3.2+
+have_func('rb_hash_new_capa')
+
+# 3.1+, fptr->fd is deprecated in its favor
+have_func('rb_io_descriptor', 'ruby/io.h')
+
+# 3.0+, for the non-blocking query path under a Fiber scheduler
+have_func('rb_fiber_scheduler_current', 'ruby/fiber/scheduler.h')
+
 # Missing in RBX (https://github.com/rubinius/rubinius/issues/3771)
 have_func('rb_wait_for_single_fd')
 
+# Used by LOAD DATA LOCAL INFILE to map the file and hint the page cache
+have_func('mmap', 'sys/mman.h')
+have_func('madvise', 'sys/mman.h')
+have_func('posix_fadvise', 'fcntl.h')
+
 # borrowed from mysqlplus
 # http://github.com/oldmoe/mysqlplus/blob/master/ext/extconf.rb
 dirs = ENV.fetch('PATH').split(File::PATH_SEPARATOR) + %w[
@@ -114,6 +134,14 @@ have_const('SERVER_QUERY_NO_INDEX_USED', mysql_h)
 have_const('SERVER_QUERY_WAS_SLOW', mysql_h)
 have_const('MYSQL_OPTION_MULTI_STATEMENTS_ON', mysql_h)
 have_const('MYSQL_OPTION_MULTI_STATEMENTS_OFF', mysql_h)
+have_const('MYSQL_OPT_NONBLOCK', mysql_h)
+have_const('STMT_ATTR_ARRAY_SIZE', mysql_h)
+
+# Non-blocking API used under a Fiber scheduler: MariaDB's _start/_cont
+# functions, or the *_nonblocking ones from MySQL 8.0.16+
+have_func('mysql_read_query_result_start', mysql_h)
+have_func('mysql_read_query_result_nonblocking', mysql_h)
+have_func('mysql_real_connect_nonblocking', mysql_h)
 
 # my_bool is replaced by C99 bool in MySQL 8.0, but we want
 # to retain compatibility with the typedef in earlier MySQLs.
@@ -5,16 +5,105 @@
 #include <unistd.h>
 #endif
 #include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 #define ERROR_LEN 1024
+/* bytes copied out of a Ruby source per GVL acquisition */
+#define STAGE_LEN (256 * 1024)
+/* pages already sent are dropped from the page cache in steps this big */
+#define DROP_BEHIND_LEN (16 * 1024 * 1024)
 typedef struct
 {
   int fd;
   char *filename;
   char error[ERROR_LEN];
   mysql_client_wrapper *wrapper;
+  /* set when Client#load_data supplies the data instead of a file */
+  mysql2_infile_stream *stream;
+  char *stage;
+  unsigned int stage_len;
+  unsigned int stage_pos;
+  int eof;
+  /* a regular file mapped in whole, with :local_infile_mmap */
+  char *map;
+  size_t map_len;
+  size_t map_pos;
+  /* offset up to which the page cache has been told to drop the file */
+  off_t dropped;
 } mysql2_local_infile_data;
 
+static double
+mysql2_local_infile_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+  }
+#endif
+  return (double)time(NULL);
+}
+
+/* Map the file so reads are a memcpy instead of a syscall each. Returns 0
+ * when the file is not a regular, non-empty file or cannot be mapped, and
+ * read(2) has to be used instead.
+ *
+ * Only done when the client asked for it: if the file shrinks while it is
+ * being sent, touching the pages past its new end raises SIGBUS.
+ */
+static int
+mysql2_local_infile_map(mysql2_local_infile_data *data)
+{
+#ifdef HAVE_MMAP
+  struct stat st;
+  void *map;
+
+  if (fstat(data->fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) return 0;
+  if ((unsigned long long)st.st_size > (size_t)-1) return 0;
+
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, data->fd, 0);
+  if (map == MAP_FAILED) return 0;
+
+#ifdef HAVE_MADVISE
+  madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+  data->map = map;
+  data->map_len = (size_t)st.st_size;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* Tell the kernel the part of the file we have sent will not be read again,
+ * so a load much bigger than RAM does not push everything else out of the
+ * page cache.
+ */
+static void
+mysql2_local_infile_drop_behind(mysql2_local_infile_data *data, off_t offset)
+{
+#ifdef HAVE_POSIX_FADVISE
+  if (offset - data->dropped < DROP_BEHIND_LEN) return;
+
+#if defined(HAVE_MMAP) && defined(HAVE_MADVISE)
+  if (data->map) {
+    /* madvise needs a page aligned start, so stop at the page holding
+     * offset and pick up from there next time */
+    off_t page = (off_t)sysconf(_SC_PAGESIZE);
+
+    offset -= offset % page;
+    madvise(data->map + data->dropped, (size_t)(offset - data->dropped), MADV_DONTNEED);
+  }
+#endif
+  posix_fadvise(data->fd, data->dropped, offset - data->dropped, POSIX_FADV_DONTNEED);
+  data->dropped = offset;
+#endif
+}
+
 /* MySQL calls this function when a user begins a LOAD DATA LOCAL INFILE query.
  *
  * Allocate a data struct and pass it back through the data pointer.
@@ -32,6 +121,20 @@ mysql2_local_infile_init(void **ptr, const char *filename, void *userdata)
   *ptr = data;
   data->error[0] = 0;
   data->wrapper = userdata;
+  data->fd = -1;
+  data->stream = data->wrapper->infile_stream;
+  data->stage = NULL;
+  data->stage_len = data->stage_pos = 0;
+  data->eof = 0;
+  data->map = NULL;
+  data->map_len = data->map_pos = 0;
+  data->dropped = 0;
+
+  data->wrapper->infile_stats.source = data->stream ? "ruby" : "read";
+  data->wrapper->infile_stats.bytes = 0;
+  data->wrapper->infile_stats.reads = 0;
+  data->wrapper->infile_stats.started_at = mysql2_local_infile_now();
+  data->wrapper->infile_stats.finished_at = 0;
 
   data->filename = strdup(filename);
   if (!data->filename) {
@@ -39,15 +142,114 @@ mysql2_local_infile_init(void **ptr, const char *filename, void *userdata)
     return 1;
   }
 
+  /* the data comes from Ruby, whatever file the server asked for */
+  if (data->stream) {
+    data->stage = malloc(STAGE_LEN);
+    if (!data->stage) {
+      snprintf(data->error, ERROR_LEN, "Out of memory");
+      return 1;
+    }
+    return 0;
+  }
+
   data->fd = open(filename, O_RDONLY);
   if (data->fd < 0) {
     snprintf(data->error, ERROR_LEN, "%s: %s", strerror(errno), filename);
     return 1;
   }
 
+  if (data->wrapper->infile_mmap && mysql2_local_infile_map(data)) {
+    data->wrapper->infile_stats.source = "mmap";
+  } else {
+#ifdef HAVE_POSIX_FADVISE
+    /* doubles the kernel's read-ahead window on Linux */
+    posix_fadvise(data->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  }
+
   return 0;
 }
 
+static VALUE
+mysql2_local_infile_next_chunk(VALUE reader)
+{
+  VALUE chunk = rb_funcall(reader, rb_intern("call"), 0);
+  if (!NIL_P(chunk)) {
+    StringValue(chunk);
+  }
+  return chunk;
+}
+
+/* Refill the stage from the Ruby source. Called with the GVL held, which
+ * the read function otherwise runs without.
+ *
+ * Returns Qfalse if the source raised.
+ */
+static void *
+mysql2_local_infile_fill(void *ptr)
+{
+  mysql2_local_infile_data *data = (mysql2_local_infile_data *)ptr;
+  mysql2_infile_stream *stream = data->stream;
+
+  data->stage_len = data->stage_pos = 0;
+
+  while (data->stage_len < STAGE_LEN) {
+    long count;
+
+    if (NIL_P(stream->chunk) || stream->chunk_offset >= RSTRING_LEN(stream->chunk)) {
+      VALUE chunk = rb_protect(mysql2_local_infile_next_chunk, stream->reader, &stream->error_state);
+
+      if (stream->error_state) {
+        stream->error = rb_errinfo();
+        rb_set_errinfo(Qnil);
+        snprintf(data->error, ERROR_LEN, "LOAD DATA source raised an exception");
+        return (void *)Qfalse;
+      }
+      if (NIL_P(chunk)) {
+        data->eof = 1;
+        break;
+      }
+      stream->chunk = chunk;
+      stream->chunk_offset = 0;
+      continue;
+    }
+
+    count = RSTRING_LEN(stream->chunk) - stream->chunk_offset;
+    if (count > (long)(STAGE_LEN - data->stage_len)) {
+      count = STAGE_LEN - data->stage_len;
+    }
+    memcpy(data->stage + data->stage_len, RSTRING_PTR(stream->chunk) + stream->chunk_offset, count);
+    data->stage_len += count;
+    stream->chunk_offset += count;
+  }
+
+  return (void *)Qtrue;
+}
+
+/* Serve libmysql's buffer from the stage, going back to Ruby for more only
+ * once it has been drained.
+ */
+static int
+mysql2_local_infile_read_stream(mysql2_local_infile_data *data, char *buf, unsigned int buf_len)
+{
+  unsigned int count;
+
+  if (data->stage_pos == data->stage_len) {
+    if (data->eof) return 0;
+    if ((VALUE)rb_thread_call_with_gvl(mysql2_local_infile_fill, data) == Qfalse) return -1;
+    if (data->stage_len == 0) return 0;
+  }
+
+  count = data->stage_len - data->stage_pos;
+  if (count > buf_len) count = buf_len;
+  memcpy(buf, data->stage + data->stage_pos, count);
+  data->stage_pos += count;
+  data->wrapper->infile_stats.bytes += count;
+  data->wrapper->infile_stats.reads++;
+
+  return (int)count;
+}
+
 /* MySQL calls this function to read data from the local file.
  *
  * Returns:
@@ -61,11 +263,28 @@ mysql2_local_infile_read(void *ptr, char *buf, unsigned int buf_len)
   int count;
   mysql2_local_infile_data *data = (mysql2_local_infile_data *)ptr;
 
-  count = (int)read(data->fd, buf, buf_len);
-  if (count < 0) {
-    snprintf(data->error, ERROR_LEN, "%s: %s", strerror(errno), data->filename);
+  if (data->stream) {
+    return mysql2_local_infile_read_stream(data, buf, buf_len);
   }
 
+  if (data->map) {
+    size_t left = data->map_len - data->map_pos;
+
+    count = (int)(left < buf_len ? left : buf_len);
+    memcpy(buf, data->map + data->map_pos, count);
+    data->map_pos += count;
+    mysql2_local_infile_drop_behind(data, (off_t)data->map_pos);
+  } else {
+    count = (int)read(data->fd, buf, buf_len);
+    if (count < 0) {
+      snprintf(data->error, ERROR_LEN, "%s: %s", strerror(errno), data->filename);
+      return count;
+    }
+    mysql2_local_infile_drop_behind(data, (off_t)(data->wrapper->infile_stats.bytes + count));
+  }
+
+  data->wrapper->infile_stats.bytes += count;
+  data->wrapper->infile_stats.reads++;
   return count;
 }
 
@@ -78,10 +297,17 @@ mysql2_local_infile_end(void *ptr)
 {
   mysql2_local_infile_data *data = (mysql2_local_infile_data *)ptr;
   if (data) {
+    data->wrapper->infile_stats.finished_at = mysql2_local_infile_now();
+#ifdef HAVE_MMAP
+    if (data->map)
+      munmap(data->map, data->map_len);
+#endif
     if (data->fd >= 0)
       close(data->fd);
     if (data->filename)
       free(data->filename);
+    if (data->stage)
+      free(data->stage);
     free(data);
   }
 }
@@ -1 +1,10 @@
+/* A Ruby data source for LOAD DATA LOCAL INFILE, see Client#load_data */
+typedef struct mysql2_infile_stream {
+  VALUE reader;       /* returns the next String chunk, or nil at the end */
+  VALUE chunk;        /* chunk being copied out, from chunk_offset on */
+  long chunk_offset;
+  VALUE error;        /* raised by reader, re-raised once the query is over */
+  int error_state;
+} mysql2_infile_stream;
+
 void mysql2_set_local_infile(MYSQL *mysql, void *userdata);
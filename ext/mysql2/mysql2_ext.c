@@ -10,5 +10,8 @@ void Init_mysql2() {
 
   init_mysql2_client();
   init_mysql2_result();
+  init_mysql2_row();
   init_mysql2_statement();
+  init_mysql2_pool();
+  init_mysql2_escape();
 }
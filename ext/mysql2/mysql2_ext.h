@@ -39,6 +39,10 @@ typedef bool my_bool;
 #include <client.h>
 #include <statement.h>
 #include <result.h>
+#include <row.h>
 #include <infile.h>
+#include <pool.h>
+#include <escape.h>
+#include <arrow.h>
 
 #endif
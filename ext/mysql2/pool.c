@@ -0,0 +1,507 @@
+#include <mysql2_ext.h>
+
+#include <time.h>
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+#include <ruby/fiber/scheduler.h>
+#endif
+
+extern VALUE mMysql2, cMysql2Client, cMysql2Error;
+static VALUE cMysql2Pool;
+static ID intern_new_client, intern_ping, intern_closed_p, intern_close, intern_TimeoutError, intern_alive_p;
+static VALUE sym_size, sym_available, sym_checkouts, sym_affinity_hits, sym_waits,
+  sym_timeouts, sym_wait_time, sym_health_checks, sym_reconnects;
+
+/* Every checkout and checkin runs with the GVL held (they touch Ruby objects
+ * anyway), which already serializes them, so the free list needs neither a
+ * Mutex nor atomics. Threads only block when the pool is empty.
+ */
+
+#define GET_POOL(self) \
+  mysql2_pool_wrapper *pool; \
+  Data_Get_Struct(self, mysql2_pool_wrapper, pool);
+
+#define REQUIRE_OPEN(pool) \
+  if (pool->closed) { \
+    rb_raise(cMysql2Error, "Pool is closed"); \
+  }
+
+static double mysql2_pool_now(void) {
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+  }
+#endif
+  return (double)time(NULL);
+}
+
+static void rb_mysql_pool_mark(void *ptr) {
+  mysql2_pool_wrapper *pool = ptr;
+  int i;
+
+  if (!pool) return;
+
+  rb_gc_mark(pool->waiters);
+  for (i = 0; i < pool->count; i++) {
+    rb_gc_mark(pool->slots[i].client);
+    rb_gc_mark(pool->slots[i].last_thread);
+  }
+}
+
+static void rb_mysql_pool_free(void *ptr) {
+  mysql2_pool_wrapper *pool = ptr;
+
+  if (pool->owners) st_free_table(pool->owners);
+  if (pool->affinity) st_free_table(pool->affinity);
+  xfree(pool->slots);
+  xfree(pool);
+}
+
+static VALUE allocate(VALUE klass) {
+  VALUE obj;
+  mysql2_pool_wrapper *pool;
+
+  obj = Data_Make_Struct(klass, mysql2_pool_wrapper, rb_mysql_pool_mark, rb_mysql_pool_free, pool);
+  pool->slots = NULL;
+  pool->size = 0;
+  pool->count = 0;
+  pool->available = 0;
+  pool->free_head = -1;
+  pool->closed = 0;
+  pool->health_check_interval = -1;
+  pool->waiters = Qnil;
+  pool->owners = NULL;
+  pool->affinity = NULL;
+  return obj;
+}
+
+/* free list: a doubly linked list threaded through the slots, used as a
+ * stack so the most recently returned (and warmest) connection goes first */
+static void mysql2_pool_push(mysql2_pool_wrapper *pool, int i) {
+  mysql2_pool_slot *slot = &pool->slots[i];
+
+  slot->in_use = 0;
+  slot->prev = -1;
+  slot->next = pool->free_head;
+  if (pool->free_head >= 0) {
+    pool->slots[pool->free_head].prev = i;
+  }
+  pool->free_head = i;
+  pool->available++;
+}
+
+static void mysql2_pool_unlink(mysql2_pool_wrapper *pool, int i) {
+  mysql2_pool_slot *slot = &pool->slots[i];
+
+  if (slot->prev >= 0) {
+    pool->slots[slot->prev].next = slot->next;
+  } else {
+    pool->free_head = slot->next;
+  }
+  if (slot->next >= 0) {
+    pool->slots[slot->next].prev = slot->prev;
+  }
+  slot->in_use = 1;
+  slot->prev = slot->next = -1;
+  pool->available--;
+}
+
+/* Take a free slot for +thread+, preferring the one it used last.
+ * Returns -1 if every connection is checked out. */
+static int mysql2_pool_take(mysql2_pool_wrapper *pool, VALUE thread) {
+  st_data_t idx;
+  int i;
+
+  if (pool->free_head < 0) {
+    return -1;
+  }
+
+  if (st_lookup(pool->affinity, (st_data_t)thread, &idx) &&
+      !pool->slots[idx].in_use && pool->slots[idx].last_thread == thread) {
+    i = (int)idx;
+    pool->affinity_hits++;
+  } else {
+    i = pool->free_head;
+    /* the table only holds hints, so rather than track thread death just
+     * start over when it outgrows the number of threads we expect */
+    if (pool->affinity->num_entries >= (st_index_t)pool->size * 4 + 64) {
+      st_clear(pool->affinity);
+    }
+    st_insert(pool->affinity, (st_data_t)thread, (st_data_t)i);
+  }
+
+  mysql2_pool_unlink(pool, i);
+  pool->slots[i].last_thread = thread;
+  return i;
+}
+
+/* Wake a thread sleeping in #checkout, or resume a fiber blocked in its
+ * scheduler. Returns 0 if it is gone. */
+static int mysql2_pool_wake(mysql2_pool_wrapper *pool, VALUE waiter) {
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+  if (RB_TYPE_P(waiter, T_ARRAY)) {
+    VALUE fiber = rb_ary_entry(waiter, 0);
+
+    if (!RTEST(rb_funcall(fiber, intern_alive_p, 0))) {
+      return 0;
+    }
+    rb_fiber_scheduler_unblock(rb_ary_entry(waiter, 1), pool->waiters, fiber);
+    return 1;
+  }
+#endif
+  return rb_thread_wakeup_alive(waiter) != Qnil;
+}
+
+static void mysql2_pool_wake_waiter(mysql2_pool_wrapper *pool) {
+  /* shift the waiter out so the next checkin wakes a different one */
+  while (RARRAY_LEN(pool->waiters) > 0) {
+    if (mysql2_pool_wake(pool, rb_ary_shift(pool->waiters))) {
+      break;
+    }
+  }
+}
+
+static void mysql2_pool_release(mysql2_pool_wrapper *pool, int i) {
+  pool->slots[i].checked_in_at = mysql2_pool_now();
+  mysql2_pool_push(pool, i);
+  mysql2_pool_wake_waiter(pool);
+}
+
+static void mysql2_pool_set_client(mysql2_pool_wrapper *pool, int i, VALUE client) {
+  if (pool->slots[i].client != Qnil) {
+    st_delete(pool->owners, (st_data_t *)&pool->slots[i].client, NULL);
+  }
+  pool->slots[i].client = client;
+  st_insert(pool->owners, (st_data_t)client, (st_data_t)i);
+}
+
+struct mysql2_pool_wait_args {
+  VALUE self;
+  mysql2_pool_wrapper *pool;
+  VALUE thread;
+  VALUE waiter;    /* what goes in pool->waiters */
+  VALUE scheduler; /* Fiber scheduler to block in, or Qnil */
+  VALUE timeout;
+  double started_at;
+  int slot;
+};
+
+static VALUE mysql2_pool_wait(VALUE ptr) {
+  struct mysql2_pool_wait_args *args = (struct mysql2_pool_wait_args *)ptr;
+  mysql2_pool_wrapper *pool = args->pool;
+  double deadline = 0, remaining;
+
+  if (!NIL_P(args->timeout)) {
+    deadline = args->started_at + NUM2DBL(args->timeout);
+  }
+
+  for (;;) {
+    REQUIRE_OPEN(pool);
+
+    args->slot = mysql2_pool_take(pool, args->thread);
+    if (args->slot >= 0) {
+      return Qnil;
+    }
+
+    if (!RTEST(rb_ary_includes(pool->waiters, args->waiter))) {
+      rb_ary_push(pool->waiters, args->waiter);
+    }
+
+    remaining = 0;
+    if (!NIL_P(args->timeout)) {
+      remaining = deadline - mysql2_pool_now();
+      if (remaining <= 0) {
+        pool->timeouts++;
+        rb_raise(rb_const_get(cMysql2Pool, intern_TimeoutError),
+                 "could not obtain a connection from the pool within %.3f seconds (all %d in use)",
+                 NUM2DBL(args->timeout), pool->size);
+      }
+    }
+
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+    /* sleeping the thread would also stop the fiber holding the connection
+     * we are waiting for, so let the scheduler run it meanwhile */
+    if (!NIL_P(args->scheduler)) {
+      rb_fiber_scheduler_block(args->scheduler, pool->waiters,
+                               NIL_P(args->timeout) ? Qnil : DBL2NUM(remaining));
+      continue;
+    }
+#endif
+    if (NIL_P(args->timeout)) {
+      rb_thread_sleep_forever();
+    } else {
+      rb_thread_wait_for(rb_time_interval(DBL2NUM(remaining)));
+    }
+  }
+}
+
+static VALUE mysql2_pool_wait_done(VALUE ptr) {
+  struct mysql2_pool_wait_args *args = (struct mysql2_pool_wait_args *)ptr;
+  mysql2_pool_wrapper *pool = args->pool;
+
+  rb_ary_delete(pool->waiters, args->waiter);
+  pool->wait_time += mysql2_pool_now() - args->started_at;
+
+  /* we may have been woken for a connection we are not going to take */
+  if (args->slot < 0 && pool->available > 0) {
+    mysql2_pool_wake_waiter(pool);
+  }
+  return Qnil;
+}
+
+struct mysql2_pool_check_args {
+  VALUE self;
+  mysql2_pool_wrapper *pool;
+  int slot;
+};
+
+/* Replace closed connections, and ping ones that sat idle for longer than
+ * health_check_interval (Client#ping releases the GVL while it waits). */
+static VALUE mysql2_pool_check(VALUE ptr) {
+  struct mysql2_pool_check_args *args = (struct mysql2_pool_check_args *)ptr;
+  mysql2_pool_wrapper *pool = args->pool;
+  mysql2_pool_slot *slot = &pool->slots[args->slot];
+  int healthy;
+
+  healthy = !RTEST(rb_funcall(slot->client, intern_closed_p, 0));
+  if (healthy && pool->health_check_interval >= 0 &&
+      mysql2_pool_now() - slot->checked_in_at >= pool->health_check_interval) {
+    pool->health_checks++;
+    healthy = RTEST(rb_funcall(slot->client, intern_ping, 0));
+  }
+
+  if (!healthy) {
+    rb_funcall(slot->client, intern_close, 0);
+    mysql2_pool_set_client(pool, args->slot, rb_funcall(args->self, intern_new_client, 0));
+    pool->reconnects++;
+  }
+
+  return slot->client;
+}
+
+/* call-seq:
+ *    pool.checkout(timeout = checkout_timeout)
+ *
+ * Take a connection out of the pool, waiting up to +timeout+ seconds (or
+ * forever if +timeout+ is nil) for one to be checked in. A thread gets back
+ * the connection it used last whenever that one is free.
+ */
+static VALUE rb_mysql_pool_checkout(VALUE self, VALUE timeout) {
+  struct mysql2_pool_wait_args wait_args;
+  struct mysql2_pool_check_args check_args;
+  VALUE client;
+  int state = 0;
+  GET_POOL(self);
+  REQUIRE_OPEN(pool);
+
+  wait_args.thread = rb_thread_current();
+  wait_args.slot = mysql2_pool_take(pool, wait_args.thread);
+
+  if (wait_args.slot < 0) {
+    wait_args.self = self;
+    wait_args.pool = pool;
+    wait_args.timeout = timeout;
+    wait_args.waiter = wait_args.thread;
+    wait_args.scheduler = Qnil;
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+    wait_args.scheduler = rb_fiber_scheduler_current();
+    if (!NIL_P(wait_args.scheduler)) {
+      wait_args.waiter = rb_assoc_new(rb_fiber_current(), wait_args.scheduler);
+    }
+#endif
+    wait_args.started_at = mysql2_pool_now();
+    pool->waits++;
+    rb_ensure(mysql2_pool_wait, (VALUE)&wait_args, mysql2_pool_wait_done, (VALUE)&wait_args);
+  }
+
+  check_args.self = self;
+  check_args.pool = pool;
+  check_args.slot = wait_args.slot;
+  client = rb_protect(mysql2_pool_check, (VALUE)&check_args, &state);
+  if (state) {
+    /* don't leak the slot if reconnecting failed */
+    mysql2_pool_release(pool, wait_args.slot);
+    rb_jump_tag(state);
+  }
+
+  pool->checkouts++;
+  return client;
+}
+
+/* call-seq:
+ *    pool.checkin(client)
+ *
+ * Return a connection taken with #checkout to the pool.
+ */
+static VALUE rb_mysql_pool_checkin(VALUE self, VALUE client) {
+  st_data_t idx;
+  GET_POOL(self);
+
+  if (!st_lookup(pool->owners, (st_data_t)client, &idx)) {
+    rb_raise(cMysql2Error, "Client does not belong to this pool");
+  }
+  if (!pool->slots[idx].in_use) {
+    rb_raise(cMysql2Error, "Client has already been checked in");
+  }
+
+  if (pool->closed) {
+    pool->slots[idx].in_use = 0;
+    rb_funcall(client, intern_close, 0);
+  } else {
+    mysql2_pool_release(pool, (int)idx);
+  }
+  return Qnil;
+}
+
+/* call-seq:
+ *    pool.close
+ *
+ * Close every connection that is not checked out, and the rest as they are
+ * checked in. Threads waiting in #checkout raise Mysql2::Error.
+ */
+static VALUE rb_mysql_pool_close(VALUE self) {
+  int i;
+  GET_POOL(self);
+
+  if (pool->closed) {
+    return Qnil;
+  }
+  pool->closed = 1;
+
+  for (i = 0; i < pool->count; i++) {
+    if (!pool->slots[i].in_use) {
+      mysql2_pool_unlink(pool, i);
+      pool->slots[i].in_use = 0;
+      rb_funcall(pool->slots[i].client, intern_close, 0);
+    }
+  }
+  while (RARRAY_LEN(pool->waiters) > 0) {
+    mysql2_pool_wake(pool, rb_ary_shift(pool->waiters));
+  }
+  return Qnil;
+}
+
+static VALUE rb_mysql_pool_closed(VALUE self) {
+  GET_POOL(self);
+  return pool->closed ? Qtrue : Qfalse;
+}
+
+static VALUE rb_mysql_pool_size(VALUE self) {
+  GET_POOL(self);
+  return INT2NUM(pool->size);
+}
+
+/* call-seq:
+ *    pool.available
+ *
+ * Number of connections currently checked in.
+ */
+static VALUE rb_mysql_pool_available(VALUE self) {
+  GET_POOL(self);
+  return INT2NUM(pool->available);
+}
+
+/* call-seq:
+ *    pool.stats
+ *
+ * Counters since the pool was created: +checkouts+, +affinity_hits+ (how
+ * many of those got the thread's previous connection back), +waits+ (how
+ * many had to wait for one), +timeouts+, +wait_time+ (total seconds spent
+ * waiting), +health_checks+ and +reconnects+.
+ */
+static VALUE rb_mysql_pool_stats(VALUE self) {
+  VALUE stats;
+  GET_POOL(self);
+
+  stats = rb_hash_new();
+  rb_hash_aset(stats, sym_size, INT2NUM(pool->size));
+  rb_hash_aset(stats, sym_available, INT2NUM(pool->available));
+  rb_hash_aset(stats, sym_checkouts, ULONG2NUM(pool->checkouts));
+  rb_hash_aset(stats, sym_affinity_hits, ULONG2NUM(pool->affinity_hits));
+  rb_hash_aset(stats, sym_waits, ULONG2NUM(pool->waits));
+  rb_hash_aset(stats, sym_timeouts, ULONG2NUM(pool->timeouts));
+  rb_hash_aset(stats, sym_wait_time, DBL2NUM(pool->wait_time));
+  rb_hash_aset(stats, sym_health_checks, ULONG2NUM(pool->health_checks));
+  rb_hash_aset(stats, sym_reconnects, ULONG2NUM(pool->reconnects));
+  return stats;
+}
+
+static VALUE initialize_ext(VALUE self, VALUE size, VALUE health_check_interval) {
+  int i;
+  GET_POOL(self);
+
+  if (pool->slots) {
+    rb_raise(cMysql2Error, "Pool is already initialized");
+  }
+
+  pool->size = NUM2INT(size);
+  if (pool->size < 1) {
+    rb_raise(rb_eArgError, "pool size must be at least 1");
+  }
+  pool->health_check_interval = NIL_P(health_check_interval) ? -1 : NUM2DBL(health_check_interval);
+  pool->waiters = rb_ary_new();
+  pool->owners = st_init_numtable();
+  pool->affinity = st_init_numtable();
+  pool->slots = ALLOC_N(mysql2_pool_slot, pool->size);
+  for (i = 0; i < pool->size; i++) {
+    pool->slots[i].client = Qnil;
+    pool->slots[i].last_thread = Qnil;
+    pool->slots[i].prev = pool->slots[i].next = -1;
+    pool->slots[i].in_use = 1;
+  }
+
+  return self;
+}
+
+/* Hand a freshly connected client to the pool while it is being filled. */
+static VALUE rb_mysql_pool_add_client(VALUE self, VALUE client) {
+  int i;
+  GET_POOL(self);
+
+  if (!rb_obj_is_kind_of(client, cMysql2Client)) {
+    rb_raise(rb_eTypeError, "wrong argument type %s (expected Mysql2::Client)", rb_obj_classname(client));
+  }
+  if (pool->count >= pool->size) {
+    rb_raise(cMysql2Error, "Pool is full");
+  }
+
+  i = pool->count++;
+  mysql2_pool_set_client(pool, i, client);
+  pool->slots[i].checked_in_at = mysql2_pool_now();
+  mysql2_pool_push(pool, i);
+  return self;
+}
+
+void init_mysql2_pool() {
+  cMysql2Pool = rb_define_class_under(mMysql2, "Pool", rb_cObject);
+  rb_define_alloc_func(cMysql2Pool, allocate);
+
+  rb_define_method(cMysql2Pool, "_checkout", rb_mysql_pool_checkout, 1);
+  rb_define_method(cMysql2Pool, "checkin", rb_mysql_pool_checkin, 1);
+  rb_define_method(cMysql2Pool, "close", rb_mysql_pool_close, 0);
+  rb_define_method(cMysql2Pool, "closed?", rb_mysql_pool_closed, 0);
+  rb_define_method(cMysql2Pool, "size", rb_mysql_pool_size, 0);
+  rb_define_method(cMysql2Pool, "available", rb_mysql_pool_available, 0);
+  rb_define_method(cMysql2Pool, "stats", rb_mysql_pool_stats, 0);
+
+  rb_define_private_method(cMysql2Pool, "initialize_ext", initialize_ext, 2);
+  rb_define_private_method(cMysql2Pool, "add_client", rb_mysql_pool_add_client, 1);
+
+  intern_new_client   = rb_intern("new_client");
+  intern_ping         = rb_intern("ping");
+  intern_closed_p     = rb_intern("closed?");
+  intern_close        = rb_intern("close");
+  intern_TimeoutError = rb_intern("TimeoutError");
+  intern_alive_p      = rb_intern("alive?");
+
+  sym_size          = ID2SYM(rb_intern("size"));
+  sym_available     = ID2SYM(rb_intern("available"));
+  sym_checkouts     = ID2SYM(rb_intern("checkouts"));
+  sym_affinity_hits = ID2SYM(rb_intern("affinity_hits"));
+  sym_waits         = ID2SYM(rb_intern("waits"));
+  sym_timeouts      = ID2SYM(rb_intern("timeouts"));
+  sym_wait_time     = ID2SYM(rb_intern("wait_time"));
+  sym_health_checks = ID2SYM(rb_intern("health_checks"));
+  sym_reconnects    = ID2SYM(rb_intern("reconnects"));
+}
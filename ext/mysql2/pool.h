@@ -0,0 +1,37 @@
+#ifndef MYSQL2_POOL_H
+#define MYSQL2_POOL_H
+
+typedef struct {
+  VALUE client;
+  VALUE last_thread;  /* thread that checked it out last, or Qnil */
+  double checked_in_at;
+  int prev;
+  int next;
+  int in_use;
+} mysql2_pool_slot;
+
+typedef struct {
+  mysql2_pool_slot *slots;
+  int size;
+  int count;
+  int available;
+  int free_head;      /* most recently checked in slot, or -1 */
+  int closed;
+  double health_check_interval; /* < 0 disables the idle ping */
+  VALUE waiters;      /* threads sleeping in #checkout, or [fiber, scheduler]
+                       * pairs blocked in a Fiber scheduler, oldest first */
+  st_table *owners;   /* client => slot index */
+  st_table *affinity; /* thread => slot index it used last */
+  /* counters reported by #stats */
+  unsigned long checkouts;
+  unsigned long affinity_hits;
+  unsigned long waits;
+  unsigned long timeouts;
+  unsigned long health_checks;
+  unsigned long reconnects;
+  double wait_time;
+} mysql2_pool_wrapper;
+
+void init_mysql2_pool(void);
+
+#endif
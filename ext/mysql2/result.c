@@ -1,6 +1,10 @@
 #include <mysql2_ext.h>
 
 #include "mysql_enc_to_ruby.h"
+#include "wait_for_single_fd.h"
+#include <ruby/io.h>
+#include <errno.h>
+#include <unistd.h>
 
 static rb_encoding *binaryEncoding;
 
@@ -20,26 +24,20 @@ static rb_encoding *binaryEncoding;
   mysql2_result_wrapper *wrapper; \
   Data_Get_Struct(self, mysql2_result_wrapper, wrapper);
 
-typedef struct {
-  int symbolizeKeys;
-  int asArray;
-  int castBool;
-  int cacheRows;
-  int cast;
-  int streaming;
-  ID db_timezone;
-  ID app_timezone;
-  VALUE block_given;
-} result_each_args;
+/* values for :decimal_as */
+#define MYSQL2_DECIMAL_AS_BIGDECIMAL     0
+#define MYSQL2_DECIMAL_AS_INTEGER_SCALED 1
+#define MYSQL2_DECIMAL_AS_RATIONAL       2
 
 extern VALUE mMysql2, cMysql2Client, cMysql2Error;
 static VALUE cMysql2Result, cDateTime, cDate;
 static VALUE opt_decimal_zero, opt_float_zero, opt_time_year, opt_time_month, opt_utc_offset;
 static ID intern_new, intern_utc, intern_local, intern_localtime, intern_local_offset,
-  intern_civil, intern_new_offset, intern_merge, intern_BigDecimal;
+  intern_civil, intern_new_offset, intern_merge, intern_BigDecimal, intern_pow;
 static VALUE sym_symbolize_keys, sym_as, sym_array, sym_database_timezone,
   sym_application_timezone, sym_local, sym_utc, sym_cast_booleans,
-  sym_cache_rows, sym_cast, sym_stream, sym_name;
+  sym_cache_rows, sym_cast, sym_stream, sym_name, sym_decimal_as,
+  sym_bigdecimal, sym_integer_scaled, sym_rational, sym_lazy, sym_raw, sym_batch_size;
 
 /* Mark any VALUEs that are only referenced in C, so the GC won't get them. */
 static void rb_mysql_result_mark(void * wrapper) {
@@ -50,6 +48,8 @@ static void rb_mysql_result_mark(void * wrapper) {
     rb_gc_mark(w->encoding);
     rb_gc_mark(w->client);
     rb_gc_mark(w->statement);
+    rb_gc_mark(w->rowTemplate);
+    rb_gc_mark(w->fieldOffsets);
   }
 }
 
@@ -72,6 +72,10 @@ static void rb_mysql_result_free_result(mysql2_result_wrapper * wrapper) {
         wrapper->stmt_wrapper->stmt->bind_result_done = 0;
       }
 
+      if (wrapper->stmt_wrapper->streaming_result == wrapper) {
+        wrapper->stmt_wrapper->streaming_result = NULL;
+      }
+
       if (wrapper->statement != Qnil) {
         decr_mysql2_stmt(wrapper->stmt_wrapper);
       }
@@ -95,6 +99,12 @@ static void rb_mysql_result_free_result(mysql2_result_wrapper * wrapper) {
     /* For prepared statements, wrapper->result is the result metadata */
     mysql_free_result(wrapper->result);
     wrapper->resultFreed = 1;
+
+    /* the column table points into the field metadata we just released */
+    if (wrapper->columns) {
+      xfree(wrapper->columns);
+      wrapper->columns = NULL;
+    }
   }
 }
 
@@ -146,55 +156,44 @@ static VALUE rb_mysql_result_fetch_field(VALUE self, unsigned int idx, int symbo
 
   rb_field = rb_ary_entry(wrapper->fields, idx);
   if (rb_field == Qnil) {
-    MYSQL_FIELD *field = NULL;
-    rb_encoding *default_internal_enc = rb_default_internal_encoding();
-    rb_encoding *conn_enc = rb_to_encoding(wrapper->encoding);
-
-    field = mysql_fetch_field_direct(wrapper->result, idx);
-    if (symbolize_keys) {
-      rb_field = rb_intern3(field->name, field->name_length, rb_utf8_encoding());
-      rb_field = ID2SYM(rb_field);
-    } else {
-      rb_field = rb_str_new(field->name, field->name_length);
-      rb_enc_associate(rb_field, conn_enc);
-      if (default_internal_enc) {
-        rb_field = rb_str_export_to_enc(rb_field, default_internal_enc);
-      }
-    }
+    MYSQL_FIELD *field = mysql_fetch_field_direct(wrapper->result, idx);
+
+    rb_field = rb_mysql_client_field_key(wrapper->client_wrapper, field->name, field->name_length,
+                                         symbolize_keys, rb_to_encoding(wrapper->encoding));
     rb_ary_store(wrapper->fields, idx, rb_field);
   }
 
   return rb_field;
 }
 
-static VALUE mysql2_set_field_string_encoding(VALUE val, MYSQL_FIELD field, rb_encoding *default_internal_enc, rb_encoding *conn_enc) {
+/* Resolve the Ruby encoding for a string column once. +export_internal+ is
+ * set when values should also be transcoded to Encoding.default_internal.
+ */
+static rb_encoding *mysql2_field_encoding(const MYSQL_FIELD *field, rb_encoding *conn_enc, int *export_internal) {
+  *export_internal = 0;
+
   /* if binary flag is set, respect its wishes */
-  if (field.flags & BINARY_FLAG && field.charsetnr == 63) {
-    rb_enc_associate(val, binaryEncoding);
-  } else if (!field.charsetnr) {
+  if (field->flags & BINARY_FLAG && field->charsetnr == 63) {
+    return binaryEncoding;
+  } else if (!field->charsetnr) {
     /* MySQL 4.x may not provide an encoding, binary will get the bytes through */
-    rb_enc_associate(val, binaryEncoding);
+    return binaryEncoding;
   } else {
     /* lookup the encoding configured on this field */
     const char *enc_name;
     int enc_index;
 
-    enc_name = (field.charsetnr-1 < CHARSETNR_SIZE) ? mysql2_mysql_enc_to_rb[field.charsetnr-1] : NULL;
-    
+    *export_internal = 1;
+    enc_name = (field->charsetnr-1 < CHARSETNR_SIZE) ? mysql2_mysql_enc_to_rb[field->charsetnr-1] : NULL;
+
     if (enc_name != NULL) {
       /* use the field encoding we were able to match */
       enc_index = rb_enc_find_index(enc_name);
-      rb_enc_set_index(val, enc_index);
-    } else {
-      /* otherwise fall-back to the connection's encoding */
-      rb_enc_associate(val, conn_enc);
-    }
-
-    if (default_internal_enc) {
-      val = rb_str_export_to_enc(val, default_internal_enc);
+      return rb_enc_from_index(enc_index);
     }
+    /* otherwise fall-back to the connection's encoding */
+    return conn_enc;
   }
-  return val;
 }
 
 /* Interpret microseconds digits left-aligned in fixed-width field.
@@ -212,6 +211,127 @@ static unsigned int msec_char_to_uint(char *msec_char, size_t len)
   return (unsigned int)strtoul(msec_char, NULL, 10);
 }
 
+/* The text protocol always sends temporal values in a fixed layout:
+ * YYYY-MM-DD, HH:MM:SS or YYYY-MM-DD HH:MM:SS, optionally followed by a '.'
+ * and up to six fractional digits. The parsers below check a whole 8 byte
+ * window of that layout at once (digits and separators) and then pick the
+ * digits straight out of it. Anything else, like negative or >99 hour TIME
+ * values, is left to the sscanf based fallback.
+ */
+#define MYSQL2_SWAR_ONES(b) (0x0101010101010101ULL * (b))
+
+/* "0000-00-" */
+#define MYSQL2_SWAR_YEAR_MONTH_MASK 0x00FFFF00FFFFFFFFULL
+#define MYSQL2_SWAR_YEAR_MONTH_SEPS 0x2D00002D00000000ULL
+/* "00-00-00" */
+#define MYSQL2_SWAR_DATE_TAIL_MASK  0xFFFF00FFFF00FFFFULL
+#define MYSQL2_SWAR_DATE_TAIL_SEPS  0x00002D00002D0000ULL
+/* "00 00:00" */
+#define MYSQL2_SWAR_DAY_HOUR_MASK   0xFFFF00FFFF00FFFFULL
+#define MYSQL2_SWAR_DAY_HOUR_SEPS   0x00003A0000200000ULL
+/* "00:00:00" */
+#define MYSQL2_SWAR_TIME_MASK       0xFFFF00FFFF00FFFFULL
+#define MYSQL2_SWAR_TIME_SEPS       0x00003A00003A0000ULL
+
+#define MYSQL2_SWAR_DIGIT(w, i) ((unsigned int)(((w) >> (8 * (i))) & 0xFF))
+#define MYSQL2_SWAR_2DIGITS(w, i) (MYSQL2_SWAR_DIGIT(w, i) * 10 + MYSQL2_SWAR_DIGIT(w, (i) + 1))
+
+static inline uint64_t mysql2_load_le64(const char *p) {
+  const unsigned char *u = (const unsigned char *)p;
+  return (uint64_t)u[0] | ((uint64_t)u[1] << 8) | ((uint64_t)u[2] << 16) | ((uint64_t)u[3] << 24) |
+    ((uint64_t)u[4] << 32) | ((uint64_t)u[5] << 40) | ((uint64_t)u[6] << 48) | ((uint64_t)u[7] << 56);
+}
+
+/* Match 8 bytes against a layout of digits (+mask+) and separators (+seps+).
+ * On success +digits+ holds the value of each digit in its byte.
+ */
+static inline int mysql2_swar_match(const char *p, uint64_t mask, uint64_t seps, uint64_t *digits) {
+  uint64_t v = mysql2_load_le64(p);
+  /* put a '0' where the separators are so every byte should be a digit */
+  uint64_t d = (v & mask) | (MYSQL2_SWAR_ONES(0x30) & ~mask);
+
+  if ((v & ~mask) != seps) {
+    return 0;
+  }
+  /* each byte must be 0x3_ and still be 0x3_ after adding 6, ie. '0'..'9' */
+  if (((d & MYSQL2_SWAR_ONES(0xF0)) | (((d + MYSQL2_SWAR_ONES(0x06)) & MYSQL2_SWAR_ONES(0xF0)) >> 4)) != MYSQL2_SWAR_ONES(0x33)) {
+    return 0;
+  }
+  *digits = d - MYSQL2_SWAR_ONES(0x30);
+  return 1;
+}
+
+/* Optional ".f" to ".ffffff" suffix, left-aligned like msec_char_to_uint. */
+static inline int mysql2_parse_usec(const char *p, unsigned long len, unsigned int *usec) {
+  static const unsigned int scale[] = { 0, 100000, 10000, 1000, 100, 10, 1 };
+  unsigned int val = 0;
+  unsigned long i;
+
+  if (len == 0) {
+    *usec = 0;
+    return 1;
+  }
+  if (len < 2 || len > 7 || p[0] != '.') {
+    return 0;
+  }
+  for (i = 1; i < len; i++) {
+    unsigned int digit = (unsigned char)p[i] - '0';
+    if (digit > 9) {
+      return 0;
+    }
+    val = val * 10 + digit;
+  }
+  *usec = val * scale[len - 1];
+  return 1;
+}
+
+int mysql2_parse_date_fast(const char *cell, unsigned long len, mysql2_time_parts *t) {
+  uint64_t ym, tail;
+
+  if (len != 10 ||
+      !mysql2_swar_match(cell, MYSQL2_SWAR_YEAR_MONTH_MASK, MYSQL2_SWAR_YEAR_MONTH_SEPS, &ym) ||
+      !mysql2_swar_match(cell + 2, MYSQL2_SWAR_DATE_TAIL_MASK, MYSQL2_SWAR_DATE_TAIL_SEPS, &tail)) {
+    return 0;
+  }
+  t->year = MYSQL2_SWAR_2DIGITS(ym, 0) * 100 + MYSQL2_SWAR_2DIGITS(ym, 2);
+  t->month = MYSQL2_SWAR_2DIGITS(ym, 5);
+  t->day = MYSQL2_SWAR_2DIGITS(tail, 6);
+  return 1;
+}
+
+static int mysql2_parse_time_fast(const char *cell, unsigned long len, mysql2_time_parts *t) {
+  uint64_t hms;
+
+  if (len < 8 ||
+      !mysql2_swar_match(cell, MYSQL2_SWAR_TIME_MASK, MYSQL2_SWAR_TIME_SEPS, &hms) ||
+      !mysql2_parse_usec(cell + 8, len - 8, &t->usec)) {
+    return 0;
+  }
+  t->hour = MYSQL2_SWAR_2DIGITS(hms, 0);
+  t->min = MYSQL2_SWAR_2DIGITS(hms, 3);
+  t->sec = MYSQL2_SWAR_2DIGITS(hms, 6);
+  return 1;
+}
+
+int mysql2_parse_datetime_fast(const char *cell, unsigned long len, mysql2_time_parts *t) {
+  uint64_t ym, dh, hms;
+
+  if (len < 19 ||
+      !mysql2_swar_match(cell, MYSQL2_SWAR_YEAR_MONTH_MASK, MYSQL2_SWAR_YEAR_MONTH_SEPS, &ym) ||
+      !mysql2_swar_match(cell + 8, MYSQL2_SWAR_DAY_HOUR_MASK, MYSQL2_SWAR_DAY_HOUR_SEPS, &dh) ||
+      !mysql2_swar_match(cell + 11, MYSQL2_SWAR_TIME_MASK, MYSQL2_SWAR_TIME_SEPS, &hms) ||
+      !mysql2_parse_usec(cell + 19, len - 19, &t->usec)) {
+    return 0;
+  }
+  t->year = MYSQL2_SWAR_2DIGITS(ym, 0) * 100 + MYSQL2_SWAR_2DIGITS(ym, 2);
+  t->month = MYSQL2_SWAR_2DIGITS(ym, 5);
+  t->day = MYSQL2_SWAR_2DIGITS(dh, 0);
+  t->hour = MYSQL2_SWAR_2DIGITS(hms, 0);
+  t->min = MYSQL2_SWAR_2DIGITS(hms, 3);
+  t->sec = MYSQL2_SWAR_2DIGITS(hms, 6);
+  return 1;
+}
+
 static void rb_mysql_result_alloc_result_buffers(VALUE self, MYSQL_FIELD *fields) {
   unsigned int i;
   GET_RESULT(self);
@@ -287,484 +407,1155 @@ static void rb_mysql_result_alloc_result_buffers(VALUE self, MYSQL_FIELD *fields
   }
 }
 
-static VALUE rb_mysql_result_fetch_row_stmt(VALUE self, MYSQL_FIELD * fields, const result_each_args *args)
-{
-  VALUE rowVal;
-  unsigned int i = 0;
-
-  rb_encoding *default_internal_enc;
-  rb_encoding *conn_enc;
-  GET_RESULT(self);
+/* Days between 1970-01-01 and a proleptic Gregorian date. */
+int64_t mysql2_days_from_civil(int64_t year, unsigned int month, unsigned int day) {
+  int64_t era;
+  unsigned int yoe, doy, doe;
+
+  /* count years from March so the leap day is the last day of the year */
+  year -= month <= 2;
+  era = (year >= 0 ? year : year - 399) / 400;
+  yoe = (unsigned int)(year - era * 400);
+  doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
 
-  default_internal_enc = rb_default_internal_encoding();
-  conn_enc = rb_to_encoding(wrapper->encoding);
+/* Build the Time for a value stored in UTC directly from its epoch seconds,
+ * which is what Time.utc (followed by #utc or #localtime) would return.
+ * Returns Qnil when the caller has to go through Time.local/Time.utc.
+ */
+static VALUE mysql2_time_from_utc_parts(const mysql2_time_parts *t, const result_each_args *args) {
+#ifdef HAVE_RB_TIME_TIMESPEC_NEW
+  struct timespec ts;
+  int64_t seconds;
 
-  if (wrapper->fields == Qnil) {
-    wrapper->numberOfFields = mysql_num_fields(wrapper->result);
-    wrapper->fields = rb_ary_new2(wrapper->numberOfFields);
-  }
-  if (args->asArray) {
-    rowVal = rb_ary_new2(wrapper->numberOfFields);
-  } else {
-    rowVal = rb_hash_new();
+  if (args->db_timezone != intern_utc) {
+    return Qnil;
   }
-
-  if (wrapper->result_buffers == NULL) {
-    rb_mysql_result_alloc_result_buffers(self, fields);
+  /* leave anything Time.utc would normalize or reject to Time.utc */
+  if (t->month < 1 || t->month > 12 || t->day < 1 || t->day > 31 ||
+      t->hour > 23 || t->min > 59 || t->sec > 59 || t->usec > 999999) {
+    return Qnil;
   }
 
-  if (mysql_stmt_bind_result(wrapper->stmt_wrapper->stmt, wrapper->result_buffers)) {
-    rb_raise_mysql2_stmt_error(wrapper->stmt_wrapper);
+  seconds = mysql2_days_from_civil(t->year, t->month, t->day) * 86400 + t->hour * 3600 + t->min * 60 + t->sec;
+  ts.tv_sec = (time_t)seconds;
+  if ((int64_t)ts.tv_sec != seconds) {
+    return Qnil;
   }
+  ts.tv_nsec = (long)t->usec * 1000;
 
-  {
-    switch((uintptr_t)rb_thread_call_without_gvl(nogvl_stmt_fetch, wrapper->stmt_wrapper->stmt, RUBY_UBF_IO, 0)) {
-      case 0:
-        /* success */
-        break;
+  /* INT_MAX is a local Time, INT_MAX-1 a UTC one */
+  return rb_time_timespec_new(&ts, args->app_timezone == intern_local ? INT_MAX : INT_MAX - 1);
+#else
+  return Qnil;
+#endif
+}
 
-      case 1:
-        /* error */
-        rb_raise_mysql2_stmt_error(wrapper->stmt_wrapper);
+/* Cell decoders. One text protocol and one binary protocol decoder is picked
+ * per column when the column table is built (see rb_mysql_result_columns_for),
+ * so the field type switch, the cast options and the charset lookup are not
+ * re-evaluated for every cell.
+ */
+typedef VALUE (*mysql2_text_decoder)(const mysql2_result_column *col, const char *cell, unsigned long len, const result_each_args *args);
+typedef VALUE (*mysql2_bind_decoder)(const mysql2_result_column *col, const MYSQL_BIND *bind, const result_each_args *args);
+
+struct mysql2_result_column {
+  mysql2_text_decoder decode_text;
+  mysql2_bind_decoder decode_bind;
+  const MYSQL_FIELD *field;
+  rb_encoding *enc;
+  int export_internal;
+  VALUE key; /* also held by wrapper->fields */
+};
+
+#define MYSQL2_COLUMNS_CAST      0x1
+#define MYSQL2_COLUMNS_CAST_BOOL 0x2
+#define MYSQL2_COLUMNS_SYMBOLIZE 0x4
+#define MYSQL2_COLUMNS_LEGACY    0x8
+#define MYSQL2_COLUMNS_DECIMAL_AS_SHIFT 4
+
+/* When set, integer and date/time cells are parsed the way they were before
+ * the fast paths were added (rb_cstr2inum and sscanf), so the benchmarks can
+ * compare both on the same data. Only read when a column table is built.
+ */
+static int mysql2_legacy_decoders = 0;
 
-      case MYSQL_NO_DATA:
-        /* no more row */
-        return Qnil;
+static VALUE mysql2_decode_nil(RB_MYSQL_UNUSED const mysql2_result_column *col, RB_MYSQL_UNUSED const char *cell, RB_MYSQL_UNUSED unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  return Qnil;
+}
 
-      case MYSQL_DATA_TRUNCATED:
-        rb_raise(cMysql2Error, "IMPLBUG: caught MYSQL_DATA_TRUNCATED. should not come here as buffer_length is set to fields[i].max_length.");
-    }
+static VALUE mysql2_decode_string(const mysql2_result_column *col, const char *cell, unsigned long len, const result_each_args *args) {
+  VALUE val = rb_enc_str_new(cell, len, col->enc);
+  if (col->export_internal && args->default_internal_enc) {
+    val = rb_str_export_to_enc(val, args->default_internal_enc);
   }
+  return val;
+}
 
-  for (i = 0; i < wrapper->numberOfFields; i++) {
-    VALUE field = rb_mysql_result_fetch_field(self, i, args->symbolizeKeys);
-    VALUE val = Qnil;
-    MYSQL_TIME *ts;
+static VALUE mysql2_decode_bit(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  return rb_str_new(cell, len);
+}
 
-    if (wrapper->is_null[i]) {
-      val = Qnil;
-    } else {
-      const MYSQL_BIND* const result_buffer = &wrapper->result_buffers[i];
+static VALUE mysql2_decode_bit_bool(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, RB_MYSQL_UNUSED unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  return *cell == 1 ? Qtrue : Qfalse;
+}
 
-      switch(result_buffer->buffer_type) {
-        case MYSQL_TYPE_TINY:         // signed char
-          if (args->castBool && fields[i].length == 1) {
-            val = (*((unsigned char*)result_buffer->buffer) != 0) ? Qtrue : Qfalse;
-            break;
-          }
-          if (result_buffer->is_unsigned) {
-            val = UINT2NUM(*((unsigned char*)result_buffer->buffer));
-          } else {
-            val = INT2NUM(*((signed char*)result_buffer->buffer));
-          }
-          break;
-        case MYSQL_TYPE_BIT:        /* BIT field (MySQL 5.0.3 and up) */
-          if (args->castBool && fields[i].length == 1) {
-            val = (*((unsigned char*)result_buffer->buffer) != 0) ? Qtrue : Qfalse;
-          }else{
-            val = rb_str_new(result_buffer->buffer, *(result_buffer->length));
-          }
-          break;
-        case MYSQL_TYPE_SHORT:        // short int
-        case MYSQL_TYPE_YEAR:         // short int
-          if (result_buffer->is_unsigned) {
-            val = UINT2NUM(*((unsigned short int*)result_buffer->buffer));
-          } else  {
-            val = INT2NUM(*((short int*)result_buffer->buffer));
-          }
-          break;
-        case MYSQL_TYPE_INT24:        // int
-        case MYSQL_TYPE_LONG:         // int
-          if (result_buffer->is_unsigned) {
-            val = UINT2NUM(*((unsigned int*)result_buffer->buffer));
-          } else {
-            val = INT2NUM(*((int*)result_buffer->buffer));
-          }
-          break;
-        case MYSQL_TYPE_LONGLONG:     // long long int
-          if (result_buffer->is_unsigned) {
-            val = ULL2NUM(*((unsigned long long int*)result_buffer->buffer));
-          } else {
-            val = LL2NUM(*((long long int*)result_buffer->buffer));
-          }
-          break;
-        case MYSQL_TYPE_FLOAT:        // float
-          val = rb_float_new((double)(*((float*)result_buffer->buffer)));
-          break;
-        case MYSQL_TYPE_DOUBLE:       // double
-          val = rb_float_new((double)(*((double*)result_buffer->buffer)));
-          break;
-        case MYSQL_TYPE_DATE:         // MYSQL_TIME
-        case MYSQL_TYPE_NEWDATE:      // MYSQL_TIME
-          ts = (MYSQL_TIME*)result_buffer->buffer;
-          val = rb_funcall(cDate, intern_new, 3, INT2NUM(ts->year), INT2NUM(ts->month), INT2NUM(ts->day));
-          break;
-        case MYSQL_TYPE_TIME:         // MYSQL_TIME
-          ts = (MYSQL_TIME*)result_buffer->buffer;
-          val = rb_funcall(rb_cTime, args->db_timezone, 7, opt_time_year, opt_time_month, opt_time_month, UINT2NUM(ts->hour), UINT2NUM(ts->minute), UINT2NUM(ts->second), ULONG2NUM(ts->second_part));
-          if (!NIL_P(args->app_timezone)) {
-            if (args->app_timezone == intern_local) {
-              val = rb_funcall(val, intern_localtime, 0);
-            } else { // utc
-              val = rb_funcall(val, intern_utc, 0);
-            }
-          }
-          break;
-        case MYSQL_TYPE_DATETIME:     // MYSQL_TIME
-        case MYSQL_TYPE_TIMESTAMP: {  // MYSQL_TIME
-          uint64_t seconds;
-
-          ts = (MYSQL_TIME*)result_buffer->buffer;
-          seconds = (ts->year*31557600ULL) + (ts->month*2592000ULL) + (ts->day*86400ULL) + (ts->hour*3600ULL) + (ts->minute*60ULL) + ts->second;
-
-          if (seconds < MYSQL2_MIN_TIME || seconds > MYSQL2_MAX_TIME) { // use DateTime instead
-            VALUE offset = INT2NUM(0);
-            if (args->db_timezone == intern_local) {
-              offset = rb_funcall(cMysql2Client, intern_local_offset, 0);
-            }
-            val = rb_funcall(cDateTime, intern_civil, 7, UINT2NUM(ts->year), UINT2NUM(ts->month), UINT2NUM(ts->day), UINT2NUM(ts->hour), UINT2NUM(ts->minute), UINT2NUM(ts->second), offset);
-            if (!NIL_P(args->app_timezone)) {
-              if (args->app_timezone == intern_local) {
-                offset = rb_funcall(cMysql2Client, intern_local_offset, 0);
-                val = rb_funcall(val, intern_new_offset, 1, offset);
-              } else { // utc
-                val = rb_funcall(val, intern_new_offset, 1, opt_utc_offset);
-              }
-            }
-          } else {
-            val = rb_funcall(rb_cTime, args->db_timezone, 7, UINT2NUM(ts->year), UINT2NUM(ts->month), UINT2NUM(ts->day), UINT2NUM(ts->hour), UINT2NUM(ts->minute), UINT2NUM(ts->second), ULONG2NUM(ts->second_part));
-            if (!NIL_P(args->app_timezone)) {
-              if (args->app_timezone == intern_local) {
-                val = rb_funcall(val, intern_localtime, 0);
-              } else { // utc
-                val = rb_funcall(val, intern_utc, 0);
-              }
-            }
-          }
-          break;
-        }
-        case MYSQL_TYPE_DECIMAL:      // char[]
-        case MYSQL_TYPE_NEWDECIMAL:   // char[]
-          val = rb_funcall(rb_mKernel, intern_BigDecimal, 1, rb_str_new(result_buffer->buffer, *(result_buffer->length)));
-          break;
-        case MYSQL_TYPE_STRING:       // char[]
-        case MYSQL_TYPE_VAR_STRING:   // char[]
-        case MYSQL_TYPE_VARCHAR:      // char[]
-        case MYSQL_TYPE_TINY_BLOB:    // char[]
-        case MYSQL_TYPE_BLOB:         // char[]
-        case MYSQL_TYPE_MEDIUM_BLOB:  // char[]
-        case MYSQL_TYPE_LONG_BLOB:    // char[]
-        case MYSQL_TYPE_SET:          // char[]
-        case MYSQL_TYPE_ENUM:         // char[]
-        case MYSQL_TYPE_GEOMETRY:     // char[]
-        default:
-          val = rb_str_new(result_buffer->buffer, *(result_buffer->length));
-          val = mysql2_set_field_string_encoding(val, fields[i], default_internal_enc, conn_enc);
-          break;
-      }
-    }
+static VALUE mysql2_decode_tiny_bool(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, RB_MYSQL_UNUSED unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  return *cell != '0' ? Qtrue : Qfalse;
+}
 
-    if (args->asArray) {
-      rb_ary_push(rowVal, val);
-    } else {
-      rb_hash_aset(rowVal, field, val);
+/* Integer cells are plain decimal digits with an optional '-', and we know
+ * their length, so anything up to 18 digits is accumulated directly (it
+ * can't overflow 64 bits). Longer values, like large BIGINT UNSIGNED or
+ * DECIMAL(n,0) values, go through rb_cstr2inum.
+ */
+static VALUE mysql2_decode_integer(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  const char *p = cell, *end = cell + len;
+  unsigned long long val = 0;
+  int negative = 0;
+
+  if (p < end && *p == '-') {
+    negative = 1;
+    p++;
+  }
+  if (p == end || end - p > 18) {
+    return rb_cstr2inum(cell, 10);
+  }
+  for (; p < end; p++) {
+    unsigned int digit = (unsigned char)*p - '0';
+    if (digit > 9) {
+      return rb_cstr2inum(cell, 10);
     }
+    val = val * 10 + digit;
   }
 
-  return rowVal;
+  if (val <= (unsigned long long)FIXNUM_MAX) {
+    return LONG2FIX(negative ? -(long)val : (long)val);
+  }
+  return negative ? LL2NUM(-(long long)val) : ULL2NUM(val);
 }
 
-static VALUE rb_mysql_result_fetch_row(VALUE self, MYSQL_FIELD * fields, const result_each_args *args)
-{
-  VALUE rowVal;
-  MYSQL_ROW row;
-  unsigned int i = 0;
-  unsigned long * fieldLengths;
-  void * ptr;
-  rb_encoding *default_internal_enc;
-  rb_encoding *conn_enc;
-  GET_RESULT(self);
+static VALUE mysql2_decode_integer_legacy(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, RB_MYSQL_UNUSED unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  return rb_cstr2inum(cell, 10);
+}
 
-  default_internal_enc = rb_default_internal_encoding();
-  conn_enc = rb_to_encoding(wrapper->encoding);
+/* BigDecimal has no C API, so values still go through Kernel#BigDecimal,
+ * but the digits are copied into one scratch String per iteration instead
+ * of a new String per cell. BigDecimal() doesn't hold on to its argument.
+ */
+static VALUE mysql2_bigdecimal_new(const char *cell, unsigned long len, const result_each_args *args) {
+  VALUE str = args->decimal_buffer;
 
-  ptr = wrapper->result;
-  row = (MYSQL_ROW)rb_thread_call_without_gvl(nogvl_fetch_row, ptr, RUBY_UBF_IO, 0);
-  if (row == NULL) {
-    return Qnil;
+  rb_str_resize(str, 0);
+  rb_str_cat(str, cell, len);
+  return rb_funcallv(rb_mKernel, intern_BigDecimal, 1, &str);
+}
+
+/* Whether a DECIMAL cell is some spelling of zero, like "0.000" or "-0.00". */
+static int mysql2_decimal_is_zero(const char *cell, unsigned long len) {
+  unsigned long i;
+
+  for (i = 0; i < len; i++) {
+    if (cell[i] != '0' && cell[i] != '.' && cell[i] != '-') {
+      return 0;
+    }
   }
+  return 1;
+}
 
-  if (wrapper->fields == Qnil) {
-    wrapper->numberOfFields = mysql_num_fields(wrapper->result);
-    wrapper->fields = rb_ary_new2(wrapper->numberOfFields);
+static VALUE mysql2_decode_decimal(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, unsigned long len, const result_each_args *args) {
+  if (mysql2_decimal_is_zero(cell, len)) {
+    return rb_funcall(rb_mKernel, intern_BigDecimal, 1, opt_decimal_zero);
   }
-  if (args->asArray) {
-    rowVal = rb_ary_new2(wrapper->numberOfFields);
-  } else {
-    rowVal = rb_hash_new();
+  return mysql2_bigdecimal_new(cell, len, args);
+}
+
+/* The value of a DECIMAL cell times 10**decimals, as an Integer. Values
+ * with up to 18 digits are accumulated directly, longer ones are handed to
+ * rb_cstr2inum once the decimal point has been dropped.
+ */
+static VALUE mysql2_decimal_to_scaled_integer(const mysql2_result_column *col, const char *cell, unsigned long len) {
+  const char *p = cell, *end = cell + len;
+  unsigned int decimals = col->field->decimals;
+  unsigned int frac = 0, ndigits = 0;
+  unsigned long long val = 0;
+  int negative = 0, seen_point = 0;
+  char *digits, *d;
+
+  d = digits = ALLOCA_N(char, len + decimals + 2);
+  if (p < end && *p == '-') {
+    negative = 1;
+    *d++ = *p++;
   }
-  fieldLengths = mysql_fetch_lengths(wrapper->result);
+  for (; p < end; p++) {
+    unsigned int digit;
 
-  for (i = 0; i < wrapper->numberOfFields; i++) {
-    VALUE field = rb_mysql_result_fetch_field(self, i, args->symbolizeKeys);
-    if (row[i]) {
-      VALUE val = Qnil;
-      enum enum_field_types type = fields[i].type;
-
-      if (!args->cast) {
-        if (type == MYSQL_TYPE_NULL) {
-          val = Qnil;
-        } else {
-          val = rb_str_new(row[i], fieldLengths[i]);
-          val = mysql2_set_field_string_encoding(val, fields[i], default_internal_enc, conn_enc);
-        }
-      } else {
-        switch(type) {
-        case MYSQL_TYPE_NULL:       /* NULL-type field */
-          val = Qnil;
-          break;
-        case MYSQL_TYPE_BIT:        /* BIT field (MySQL 5.0.3 and up) */
-          if (args->castBool && fields[i].length == 1) {
-            val = *row[i] == 1 ? Qtrue : Qfalse;
-          }else{
-            val = rb_str_new(row[i], fieldLengths[i]);
-          }
-          break;
-        case MYSQL_TYPE_TINY:       /* TINYINT field */
-          if (args->castBool && fields[i].length == 1) {
-            val = *row[i] != '0' ? Qtrue : Qfalse;
-            break;
-          }
-        case MYSQL_TYPE_SHORT:      /* SMALLINT field */
-        case MYSQL_TYPE_LONG:       /* INTEGER field */
-        case MYSQL_TYPE_INT24:      /* MEDIUMINT field */
-        case MYSQL_TYPE_LONGLONG:   /* BIGINT field */
-        case MYSQL_TYPE_YEAR:       /* YEAR field */
-          val = rb_cstr2inum(row[i], 10);
-          break;
-        case MYSQL_TYPE_DECIMAL:    /* DECIMAL or NUMERIC field */
-        case MYSQL_TYPE_NEWDECIMAL: /* Precision math DECIMAL or NUMERIC field (MySQL 5.0.3 and up) */
-          if (fields[i].decimals == 0) {
-            val = rb_cstr2inum(row[i], 10);
-          } else if (strtod(row[i], NULL) == 0.000000){
-            val = rb_funcall(rb_mKernel, intern_BigDecimal, 1, opt_decimal_zero);
-          }else{
-            val = rb_funcall(rb_mKernel, intern_BigDecimal, 1, rb_str_new(row[i], fieldLengths[i]));
-          }
-          break;
-        case MYSQL_TYPE_FLOAT:      /* FLOAT field */
-        case MYSQL_TYPE_DOUBLE: {     /* DOUBLE or REAL field */
-          double column_to_double;
-          column_to_double = strtod(row[i], NULL);
-          if (column_to_double == 0.000000){
-            val = opt_float_zero;
-          }else{
-            val = rb_float_new(column_to_double);
-          }
-          break;
-        }
-        case MYSQL_TYPE_TIME: {     /* TIME field */
-          int tokens;
-          unsigned int hour=0, min=0, sec=0, msec=0;
-          char msec_char[7] = {'0','0','0','0','0','0','\0'};
-
-          tokens = sscanf(row[i], "%2u:%2u:%2u.%6s", &hour, &min, &sec, msec_char);
-          if (tokens < 3) {
-            val = Qnil;
-            break;
-          }
-          msec = msec_char_to_uint(msec_char, sizeof(msec_char));
-          val = rb_funcall(rb_cTime, args->db_timezone, 7, opt_time_year, opt_time_month, opt_time_month, UINT2NUM(hour), UINT2NUM(min), UINT2NUM(sec), UINT2NUM(msec));
-          if (!NIL_P(args->app_timezone)) {
-            if (args->app_timezone == intern_local) {
-              val = rb_funcall(val, intern_localtime, 0);
-            } else { /* utc */
-              val = rb_funcall(val, intern_utc, 0);
-            }
-          }
-          break;
-        }
-        case MYSQL_TYPE_TIMESTAMP:  /* TIMESTAMP field */
-        case MYSQL_TYPE_DATETIME: { /* DATETIME field */
-          int tokens;
-          unsigned int year=0, month=0, day=0, hour=0, min=0, sec=0, msec=0;
-          char msec_char[7] = {'0','0','0','0','0','0','\0'};
-          uint64_t seconds;
-
-          tokens = sscanf(row[i], "%4u-%2u-%2u %2u:%2u:%2u.%6s", &year, &month, &day, &hour, &min, &sec, msec_char);
-          if (tokens < 6) { /* msec might be empty */
-            val = Qnil;
-            break;
-          }
-          seconds = (year*31557600ULL) + (month*2592000ULL) + (day*86400ULL) + (hour*3600ULL) + (min*60ULL) + sec;
-
-          if (seconds == 0) {
-            val = Qnil;
-          } else {
-            if (month < 1 || day < 1) {
-              rb_raise(cMysql2Error, "Invalid date in field '%.*s': %s", fields[i].name_length, fields[i].name, row[i]);
-              val = Qnil;
-            } else {
-              if (seconds < MYSQL2_MIN_TIME || seconds > MYSQL2_MAX_TIME) { /* use DateTime for larger date range, does not support microseconds */
-                VALUE offset = INT2NUM(0);
-                if (args->db_timezone == intern_local) {
-                  offset = rb_funcall(cMysql2Client, intern_local_offset, 0);
-                }
-                val = rb_funcall(cDateTime, intern_civil, 7, UINT2NUM(year), UINT2NUM(month), UINT2NUM(day), UINT2NUM(hour), UINT2NUM(min), UINT2NUM(sec), offset);
-                if (!NIL_P(args->app_timezone)) {
-                  if (args->app_timezone == intern_local) {
-                    offset = rb_funcall(cMysql2Client, intern_local_offset, 0);
-                    val = rb_funcall(val, intern_new_offset, 1, offset);
-                  } else { /* utc */
-                    val = rb_funcall(val, intern_new_offset, 1, opt_utc_offset);
-                  }
-                }
-              } else {
-                msec = msec_char_to_uint(msec_char, sizeof(msec_char));
-                val = rb_funcall(rb_cTime, args->db_timezone, 7, UINT2NUM(year), UINT2NUM(month), UINT2NUM(day), UINT2NUM(hour), UINT2NUM(min), UINT2NUM(sec), UINT2NUM(msec));
-                if (!NIL_P(args->app_timezone)) {
-                  if (args->app_timezone == intern_local) {
-                    val = rb_funcall(val, intern_localtime, 0);
-                  } else { /* utc */
-                    val = rb_funcall(val, intern_utc, 0);
-                  }
-                }
-              }
-            }
-          }
-          break;
-        }
-        case MYSQL_TYPE_DATE:       /* DATE field */
-        case MYSQL_TYPE_NEWDATE: {  /* Newer const used > 5.0 */
-          int tokens;
-          unsigned int year=0, month=0, day=0;
-          tokens = sscanf(row[i], "%4u-%2u-%2u", &year, &month, &day);
-          if (tokens < 3) {
-            val = Qnil;
-            break;
-          }
-          if (year+month+day == 0) {
-            val = Qnil;
-          } else {
-            if (month < 1 || day < 1) {
-              rb_raise(cMysql2Error, "Invalid date in field '%.*s': %s", fields[i].name_length, fields[i].name, row[i]);
-              val = Qnil;
-            } else {
-              val = rb_funcall(cDate, intern_new, 3, UINT2NUM(year), UINT2NUM(month), UINT2NUM(day));
-            }
-          }
-          break;
-        }
-        case MYSQL_TYPE_TINY_BLOB:
-        case MYSQL_TYPE_MEDIUM_BLOB:
-        case MYSQL_TYPE_LONG_BLOB:
-        case MYSQL_TYPE_BLOB:
-        case MYSQL_TYPE_VAR_STRING:
-        case MYSQL_TYPE_VARCHAR:
-        case MYSQL_TYPE_STRING:     /* CHAR or BINARY field */
-        case MYSQL_TYPE_SET:        /* SET field */
-        case MYSQL_TYPE_ENUM:       /* ENUM field */
-        case MYSQL_TYPE_GEOMETRY:   /* Spatial fielda */
-        default:
-          val = rb_str_new(row[i], fieldLengths[i]);
-          val = mysql2_set_field_string_encoding(val, fields[i], default_internal_enc, conn_enc);
-          break;
-        }
-      }
-      if (args->asArray) {
-        rb_ary_push(rowVal, val);
-      } else {
-        rb_hash_aset(rowVal, field, val);
-      }
-    } else {
-      if (args->asArray) {
-        rb_ary_push(rowVal, Qnil);
-      } else {
-        rb_hash_aset(rowVal, field, Qnil);
-      }
+    if (*p == '.' && !seen_point) {
+      seen_point = 1;
+      continue;
     }
+    digit = (unsigned char)*p - '0';
+    if (digit > 9) {
+      rb_raise(cMysql2Error, "Invalid decimal in field '%.*s': %.*s", col->field->name_length, col->field->name, (int)len, cell);
+    }
+    if (seen_point && frac++ >= decimals) {
+      /* more digits than the column's scale, truncate */
+      continue;
+    }
+    val = val * 10 + digit;
+    ndigits++;
+    *d++ = (char)*p;
   }
-  return rowVal;
-}
+  for (; frac < decimals; frac++) {
+    val *= 10;
+    ndigits++;
+    *d++ = '0';
+  }
+  *d = '\0';
 
-static VALUE rb_mysql_result_fetch_fields(VALUE self) {
-  unsigned int i = 0;
-  short int symbolizeKeys = 0;
-  VALUE defaults;
+  if (ndigits > 18) {
+    return rb_cstr2inum(digits, 10);
+  }
+  return negative ? LL2NUM(-(long long)val) : ULL2NUM(val);
+}
 
-  GET_RESULT(self);
+static VALUE mysql2_decimal_scale(unsigned int decimals) {
+  static const long long pow10[] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL,
+    1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL,
+    100000000000000LL, 1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+    1000000000000000000LL
+  };
 
-  defaults = rb_iv_get(self, "@query_options");
-  Check_Type(defaults, T_HASH);
-  if (rb_hash_aref(defaults, sym_symbolize_keys) == Qtrue) {
-    symbolizeKeys = 1;
+  if (decimals < sizeof(pow10) / sizeof(pow10[0])) {
+    return LL2NUM(pow10[decimals]);
   }
+  return rb_funcall(INT2FIX(10), intern_pow, 1, UINT2NUM(decimals));
+}
 
-  if (wrapper->fields == Qnil) {
-    wrapper->numberOfFields = mysql_num_fields(wrapper->result);
-    wrapper->fields = rb_ary_new2(wrapper->numberOfFields);
+static VALUE mysql2_decode_decimal_scaled(const mysql2_result_column *col, const char *cell, unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  return mysql2_decimal_to_scaled_integer(col, cell, len);
+}
+
+static VALUE mysql2_decode_decimal_rational(const mysql2_result_column *col, const char *cell, unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  return rb_rational_new(mysql2_decimal_to_scaled_integer(col, cell, len), mysql2_decimal_scale(col->field->decimals));
+}
+
+static VALUE mysql2_decode_float(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, RB_MYSQL_UNUSED unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  double column_to_double;
+  column_to_double = strtod(cell, NULL);
+  if (column_to_double == 0.000000) {
+    return opt_float_zero;
   }
+  return rb_float_new(column_to_double);
+}
 
-  if ((my_ulonglong)RARRAY_LEN(wrapper->fields) != wrapper->numberOfFields) {
-    for (i=0; i<wrapper->numberOfFields; i++) {
-      rb_mysql_result_fetch_field(self, i, symbolizeKeys);
-    }
+static int mysql2_parse_time_sscanf(const char *cell, mysql2_time_parts *t) {
+  char msec_char[7] = {'0','0','0','0','0','0','\0'};
+  int tokens = sscanf(cell, "%2u:%2u:%2u.%6s", &t->hour, &t->min, &t->sec, msec_char);
+  if (tokens < 3) {
+    return 0;
   }
+  t->usec = msec_char_to_uint(msec_char, sizeof(msec_char));
+  return 1;
+}
 
-  return wrapper->fields;
+static int mysql2_parse_datetime_sscanf(const char *cell, mysql2_time_parts *t) {
+  char msec_char[7] = {'0','0','0','0','0','0','\0'};
+  int tokens = sscanf(cell, "%4u-%2u-%2u %2u:%2u:%2u.%6s", &t->year, &t->month, &t->day, &t->hour, &t->min, &t->sec, msec_char);
+  if (tokens < 6) { /* msec might be empty */
+    return 0;
+  }
+  t->usec = msec_char_to_uint(msec_char, sizeof(msec_char));
+  return 1;
 }
 
-static VALUE rb_mysql_result_each_(VALUE self,
-                                   VALUE(*fetch_row_func)(VALUE, MYSQL_FIELD *fields, const result_each_args *args),
-                                   const result_each_args *args)
-{
-  unsigned long i;
-  const char *errstr;
-  MYSQL_FIELD *fields = NULL;
+static int mysql2_parse_date_sscanf(const char *cell, mysql2_time_parts *t) {
+  return sscanf(cell, "%4u-%2u-%2u", &t->year, &t->month, &t->day) >= 3;
+}
 
-  GET_RESULT(self);
+static VALUE mysql2_time_value(mysql2_time_parts *t, const result_each_args *args) {
+  VALUE val;
 
-  if (wrapper->is_streaming) {
-    /* When streaming, we will only yield rows, not return them. */
-    if (wrapper->rows == Qnil) {
-      wrapper->rows = rb_ary_new();
+  t->year = 2000;
+  t->month = t->day = 1;
+  val = mysql2_time_from_utc_parts(t, args);
+  if (!NIL_P(val)) {
+    return val;
+  }
+  val = rb_funcall(rb_cTime, args->db_timezone, 7, opt_time_year, opt_time_month, opt_time_month, UINT2NUM(t->hour), UINT2NUM(t->min), UINT2NUM(t->sec), UINT2NUM(t->usec));
+  if (!NIL_P(args->app_timezone)) {
+    if (args->app_timezone == intern_local) {
+      val = rb_funcall(val, intern_localtime, 0);
+    } else { /* utc */
+      val = rb_funcall(val, intern_utc, 0);
     }
+  }
+  return val;
+}
 
-    if (!wrapper->streamingComplete) {
-      VALUE row;
-
-      fields = mysql_fetch_fields(wrapper->result);
-
-      do {
-        row = fetch_row_func(self, fields, args);
-        if (row != Qnil) {
-          wrapper->numberOfRows++;
-          if (args->block_given != Qnil) {
-            rb_yield(row);
-          }
-        }
-      } while(row != Qnil);
+static VALUE mysql2_datetime_value(const mysql2_result_column *col, const char *cell, mysql2_time_parts *t, const result_each_args *args) {
+  uint64_t seconds;
+  VALUE val;
 
-      rb_mysql_result_free_result(wrapper);
-      wrapper->streamingComplete = 1;
+  seconds = (t->year*31557600ULL) + (t->month*2592000ULL) + (t->day*86400ULL) + (t->hour*3600ULL) + (t->min*60ULL) + t->sec;
 
-      // Check for errors, the connection might have gone out from under us
-      // mysql_error returns an empty string if there is no error
-      errstr = mysql_error(wrapper->client_wrapper->client);
-      if (errstr[0]) {
-        rb_raise(cMysql2Error, "%s", errstr);
+  if (seconds == 0) {
+    return Qnil;
+  }
+  if (t->month < 1 || t->day < 1) {
+    rb_raise(cMysql2Error, "Invalid date in field '%.*s': %s", col->field->name_length, col->field->name, cell);
+  }
+  if (seconds < MYSQL2_MIN_TIME || seconds > MYSQL2_MAX_TIME) { /* use DateTime for larger date range, does not support microseconds */
+    VALUE offset = INT2NUM(0);
+    if (args->db_timezone == intern_local) {
+      offset = rb_funcall(cMysql2Client, intern_local_offset, 0);
+    }
+    val = rb_funcall(cDateTime, intern_civil, 7, UINT2NUM(t->year), UINT2NUM(t->month), UINT2NUM(t->day), UINT2NUM(t->hour), UINT2NUM(t->min), UINT2NUM(t->sec), offset);
+    if (!NIL_P(args->app_timezone)) {
+      if (args->app_timezone == intern_local) {
+        offset = rb_funcall(cMysql2Client, intern_local_offset, 0);
+        val = rb_funcall(val, intern_new_offset, 1, offset);
+      } else { /* utc */
+        val = rb_funcall(val, intern_new_offset, 1, opt_utc_offset);
       }
-    } else {
-      rb_raise(cMysql2Error, "You have already fetched all the rows for this query and streaming is true. (to reiterate you must requery).");
     }
   } else {
-    if (args->cacheRows && wrapper->lastRowProcessed == wrapper->numberOfRows) {
-      /* we've already read the entire dataset from the C result into our */
-      /* internal array. Lets hand that over to the user since it's ready to go */
-      for (i = 0; i < wrapper->numberOfRows; i++) {
-        rb_yield(rb_ary_entry(wrapper->rows, i));
+    val = mysql2_time_from_utc_parts(t, args);
+    if (!NIL_P(val)) {
+      return val;
+    }
+    val = rb_funcall(rb_cTime, args->db_timezone, 7, UINT2NUM(t->year), UINT2NUM(t->month), UINT2NUM(t->day), UINT2NUM(t->hour), UINT2NUM(t->min), UINT2NUM(t->sec), UINT2NUM(t->usec));
+    if (!NIL_P(args->app_timezone)) {
+      if (args->app_timezone == intern_local) {
+        val = rb_funcall(val, intern_localtime, 0);
+      } else { /* utc */
+        val = rb_funcall(val, intern_utc, 0);
       }
-    } else {
+    }
+  }
+  return val;
+}
+
+static VALUE mysql2_date_value(const mysql2_result_column *col, const char *cell, const mysql2_time_parts *t) {
+  if (t->year+t->month+t->day == 0) {
+    return Qnil;
+  }
+  if (t->month < 1 || t->day < 1) {
+    rb_raise(cMysql2Error, "Invalid date in field '%.*s': %s", col->field->name_length, col->field->name, cell);
+  }
+  return rb_funcall(cDate, intern_new, 3, UINT2NUM(t->year), UINT2NUM(t->month), UINT2NUM(t->day));
+}
+
+static VALUE mysql2_decode_time(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, unsigned long len, const result_each_args *args) {
+  mysql2_time_parts t = { 0, 0, 0, 0, 0, 0, 0 };
+
+  if (!mysql2_parse_time_fast(cell, len, &t) && !mysql2_parse_time_sscanf(cell, &t)) {
+    return Qnil;
+  }
+  return mysql2_time_value(&t, args);
+}
+
+static VALUE mysql2_decode_datetime(const mysql2_result_column *col, const char *cell, unsigned long len, const result_each_args *args) {
+  mysql2_time_parts t = { 0, 0, 0, 0, 0, 0, 0 };
+
+  if (!mysql2_parse_datetime_fast(cell, len, &t) && !mysql2_parse_datetime_sscanf(cell, &t)) {
+    return Qnil;
+  }
+  return mysql2_datetime_value(col, cell, &t, args);
+}
+
+static VALUE mysql2_decode_date(const mysql2_result_column *col, const char *cell, unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  mysql2_time_parts t = { 0, 0, 0, 0, 0, 0, 0 };
+
+  if (!mysql2_parse_date_fast(cell, len, &t) && !mysql2_parse_date_sscanf(cell, &t)) {
+    return Qnil;
+  }
+  return mysql2_date_value(col, cell, &t);
+}
+
+static VALUE mysql2_decode_time_legacy(RB_MYSQL_UNUSED const mysql2_result_column *col, const char *cell, RB_MYSQL_UNUSED unsigned long len, const result_each_args *args) {
+  mysql2_time_parts t = { 0, 0, 0, 0, 0, 0, 0 };
+
+  if (!mysql2_parse_time_sscanf(cell, &t)) {
+    return Qnil;
+  }
+  return mysql2_time_value(&t, args);
+}
+
+static VALUE mysql2_decode_datetime_legacy(const mysql2_result_column *col, const char *cell, RB_MYSQL_UNUSED unsigned long len, const result_each_args *args) {
+  mysql2_time_parts t = { 0, 0, 0, 0, 0, 0, 0 };
+
+  if (!mysql2_parse_datetime_sscanf(cell, &t)) {
+    return Qnil;
+  }
+  return mysql2_datetime_value(col, cell, &t, args);
+}
+
+static VALUE mysql2_decode_date_legacy(const mysql2_result_column *col, const char *cell, RB_MYSQL_UNUSED unsigned long len, RB_MYSQL_UNUSED const result_each_args *args) {
+  mysql2_time_parts t = { 0, 0, 0, 0, 0, 0, 0 };
+
+  if (!mysql2_parse_date_sscanf(cell, &t)) {
+    return Qnil;
+  }
+  return mysql2_date_value(col, cell, &t);
+}
+
+/* Pick the decoder for a text protocol column. */
+static mysql2_text_decoder mysql2_text_decoder_for(const MYSQL_FIELD *field, const result_each_args *args) {
+  if (!args->cast) {
+    return field->type == MYSQL_TYPE_NULL ? mysql2_decode_nil : mysql2_decode_string;
+  }
+
+  switch(field->type) {
+  case MYSQL_TYPE_NULL:       /* NULL-type field */
+    return mysql2_decode_nil;
+  case MYSQL_TYPE_BIT:        /* BIT field (MySQL 5.0.3 and up) */
+    if (args->castBool && field->length == 1) {
+      return mysql2_decode_bit_bool;
+    }
+    return mysql2_decode_bit;
+  case MYSQL_TYPE_TINY:       /* TINYINT field */
+    if (args->castBool && field->length == 1) {
+      return mysql2_decode_tiny_bool;
+    }
+    return mysql2_legacy_decoders ? mysql2_decode_integer_legacy : mysql2_decode_integer;
+  case MYSQL_TYPE_SHORT:      /* SMALLINT field */
+  case MYSQL_TYPE_LONG:       /* INTEGER field */
+  case MYSQL_TYPE_INT24:      /* MEDIUMINT field */
+  case MYSQL_TYPE_LONGLONG:   /* BIGINT field */
+  case MYSQL_TYPE_YEAR:       /* YEAR field */
+    return mysql2_legacy_decoders ? mysql2_decode_integer_legacy : mysql2_decode_integer;
+  case MYSQL_TYPE_DECIMAL:    /* DECIMAL or NUMERIC field */
+  case MYSQL_TYPE_NEWDECIMAL: /* Precision math DECIMAL or NUMERIC field (MySQL 5.0.3 and up) */
+    if (field->decimals == 0) {
+      return mysql2_legacy_decoders ? mysql2_decode_integer_legacy : mysql2_decode_integer;
+    }
+    switch (args->decimalAs) {
+      case MYSQL2_DECIMAL_AS_INTEGER_SCALED:
+        return mysql2_decode_decimal_scaled;
+      case MYSQL2_DECIMAL_AS_RATIONAL:
+        return mysql2_decode_decimal_rational;
+      default:
+        return mysql2_decode_decimal;
+    }
+  case MYSQL_TYPE_FLOAT:      /* FLOAT field */
+  case MYSQL_TYPE_DOUBLE:     /* DOUBLE or REAL field */
+    return mysql2_decode_float;
+  case MYSQL_TYPE_TIME:       /* TIME field */
+    return mysql2_legacy_decoders ? mysql2_decode_time_legacy : mysql2_decode_time;
+  case MYSQL_TYPE_TIMESTAMP:  /* TIMESTAMP field */
+  case MYSQL_TYPE_DATETIME:   /* DATETIME field */
+    return mysql2_legacy_decoders ? mysql2_decode_datetime_legacy : mysql2_decode_datetime;
+  case MYSQL_TYPE_DATE:       /* DATE field */
+  case MYSQL_TYPE_NEWDATE:    /* Newer const used > 5.0 */
+    return mysql2_legacy_decoders ? mysql2_decode_date_legacy : mysql2_decode_date;
+  case MYSQL_TYPE_TINY_BLOB:
+  case MYSQL_TYPE_MEDIUM_BLOB:
+  case MYSQL_TYPE_LONG_BLOB:
+  case MYSQL_TYPE_BLOB:
+  case MYSQL_TYPE_VAR_STRING:
+  case MYSQL_TYPE_VARCHAR:
+  case MYSQL_TYPE_STRING:     /* CHAR or BINARY field */
+  case MYSQL_TYPE_SET:        /* SET field */
+  case MYSQL_TYPE_ENUM:       /* ENUM field */
+  case MYSQL_TYPE_GEOMETRY:   /* Spatial fielda */
+  default:
+    return mysql2_decode_string;
+  }
+}
+
+static VALUE mysql2_decode_bind_tiny_bool(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return (*((unsigned char*)bind->buffer) != 0) ? Qtrue : Qfalse;
+}
+
+static VALUE mysql2_decode_bind_utiny(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return UINT2NUM(*((unsigned char*)bind->buffer));
+}
+
+static VALUE mysql2_decode_bind_tiny(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return INT2NUM(*((signed char*)bind->buffer));
+}
+
+static VALUE mysql2_decode_bind_bit(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return rb_str_new(bind->buffer, *(bind->length));
+}
+
+static VALUE mysql2_decode_bind_ushort(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return UINT2NUM(*((unsigned short int*)bind->buffer));
+}
+
+static VALUE mysql2_decode_bind_short(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return INT2NUM(*((short int*)bind->buffer));
+}
+
+static VALUE mysql2_decode_bind_ulong(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return UINT2NUM(*((unsigned int*)bind->buffer));
+}
+
+static VALUE mysql2_decode_bind_long(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return INT2NUM(*((int*)bind->buffer));
+}
+
+static VALUE mysql2_decode_bind_ulonglong(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return ULL2NUM(*((unsigned long long int*)bind->buffer));
+}
+
+static VALUE mysql2_decode_bind_longlong(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return LL2NUM(*((long long int*)bind->buffer));
+}
+
+static VALUE mysql2_decode_bind_float(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return rb_float_new((double)(*((float*)bind->buffer)));
+}
+
+static VALUE mysql2_decode_bind_double(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return rb_float_new((double)(*((double*)bind->buffer)));
+}
+
+static VALUE mysql2_decode_bind_date(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  const MYSQL_TIME *ts = (MYSQL_TIME*)bind->buffer;
+  return rb_funcall(cDate, intern_new, 3, INT2NUM(ts->year), INT2NUM(ts->month), INT2NUM(ts->day));
+}
+
+static VALUE mysql2_decode_bind_time(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, const result_each_args *args) {
+  const MYSQL_TIME *ts = (MYSQL_TIME*)bind->buffer;
+  mysql2_time_parts t = { 2000, 1, 1, ts->hour, ts->minute, ts->second, (unsigned int)ts->second_part };
+  VALUE val;
+
+  val = mysql2_time_from_utc_parts(&t, args);
+  if (!NIL_P(val)) {
+    return val;
+  }
+  val = rb_funcall(rb_cTime, args->db_timezone, 7, opt_time_year, opt_time_month, opt_time_month, UINT2NUM(ts->hour), UINT2NUM(ts->minute), UINT2NUM(ts->second), ULONG2NUM(ts->second_part));
+  if (!NIL_P(args->app_timezone)) {
+    if (args->app_timezone == intern_local) {
+      val = rb_funcall(val, intern_localtime, 0);
+    } else { // utc
+      val = rb_funcall(val, intern_utc, 0);
+    }
+  }
+  return val;
+}
+
+static VALUE mysql2_decode_bind_datetime(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, const result_each_args *args) {
+  const MYSQL_TIME *ts = (MYSQL_TIME*)bind->buffer;
+  uint64_t seconds;
+  VALUE val;
+
+  seconds = (ts->year*31557600ULL) + (ts->month*2592000ULL) + (ts->day*86400ULL) + (ts->hour*3600ULL) + (ts->minute*60ULL) + ts->second;
+
+  if (seconds < MYSQL2_MIN_TIME || seconds > MYSQL2_MAX_TIME) { // use DateTime instead
+    VALUE offset = INT2NUM(0);
+    if (args->db_timezone == intern_local) {
+      offset = rb_funcall(cMysql2Client, intern_local_offset, 0);
+    }
+    val = rb_funcall(cDateTime, intern_civil, 7, UINT2NUM(ts->year), UINT2NUM(ts->month), UINT2NUM(ts->day), UINT2NUM(ts->hour), UINT2NUM(ts->minute), UINT2NUM(ts->second), offset);
+    if (!NIL_P(args->app_timezone)) {
+      if (args->app_timezone == intern_local) {
+        offset = rb_funcall(cMysql2Client, intern_local_offset, 0);
+        val = rb_funcall(val, intern_new_offset, 1, offset);
+      } else { // utc
+        val = rb_funcall(val, intern_new_offset, 1, opt_utc_offset);
+      }
+    }
+  } else {
+    mysql2_time_parts t = { ts->year, ts->month, ts->day, ts->hour, ts->minute, ts->second, (unsigned int)ts->second_part };
+
+    val = mysql2_time_from_utc_parts(&t, args);
+    if (!NIL_P(val)) {
+      return val;
+    }
+    val = rb_funcall(rb_cTime, args->db_timezone, 7, UINT2NUM(ts->year), UINT2NUM(ts->month), UINT2NUM(ts->day), UINT2NUM(ts->hour), UINT2NUM(ts->minute), UINT2NUM(ts->second), ULONG2NUM(ts->second_part));
+    if (!NIL_P(args->app_timezone)) {
+      if (args->app_timezone == intern_local) {
+        val = rb_funcall(val, intern_localtime, 0);
+      } else { // utc
+        val = rb_funcall(val, intern_utc, 0);
+      }
+    }
+  }
+  return val;
+}
+
+static VALUE mysql2_decode_bind_decimal(RB_MYSQL_UNUSED const mysql2_result_column *col, const MYSQL_BIND *bind, const result_each_args *args) {
+  return mysql2_bigdecimal_new(bind->buffer, *(bind->length), args);
+}
+
+static VALUE mysql2_decode_bind_decimal_scaled(const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return mysql2_decimal_to_scaled_integer(col, bind->buffer, *(bind->length));
+}
+
+static VALUE mysql2_decode_bind_decimal_rational(const mysql2_result_column *col, const MYSQL_BIND *bind, RB_MYSQL_UNUSED const result_each_args *args) {
+  return rb_rational_new(mysql2_decimal_to_scaled_integer(col, bind->buffer, *(bind->length)), mysql2_decimal_scale(col->field->decimals));
+}
+
+static VALUE mysql2_decode_bind_string(const mysql2_result_column *col, const MYSQL_BIND *bind, const result_each_args *args) {
+  return mysql2_decode_string(col, bind->buffer, *(bind->length), args);
+}
+
+/* Pick the decoder for a binary protocol (prepared statement) column. */
+static mysql2_bind_decoder mysql2_bind_decoder_for(const MYSQL_FIELD *field, const result_each_args *args) {
+  int is_unsigned = (field->flags & UNSIGNED_FLAG) != 0;
+
+  //      mysql type    |            C type
+  switch(field->type) {
+    case MYSQL_TYPE_TINY:         // signed char
+      if (args->castBool && field->length == 1) {
+        return mysql2_decode_bind_tiny_bool;
+      }
+      return is_unsigned ? mysql2_decode_bind_utiny : mysql2_decode_bind_tiny;
+    case MYSQL_TYPE_BIT:          // BIT field (MySQL 5.0.3 and up)
+      if (args->castBool && field->length == 1) {
+        return mysql2_decode_bind_tiny_bool;
+      }
+      return mysql2_decode_bind_bit;
+    case MYSQL_TYPE_SHORT:        // short int
+    case MYSQL_TYPE_YEAR:         // short int
+      return is_unsigned ? mysql2_decode_bind_ushort : mysql2_decode_bind_short;
+    case MYSQL_TYPE_INT24:        // int
+    case MYSQL_TYPE_LONG:         // int
+      return is_unsigned ? mysql2_decode_bind_ulong : mysql2_decode_bind_long;
+    case MYSQL_TYPE_LONGLONG:     // long long int
+      return is_unsigned ? mysql2_decode_bind_ulonglong : mysql2_decode_bind_longlong;
+    case MYSQL_TYPE_FLOAT:        // float
+      return mysql2_decode_bind_float;
+    case MYSQL_TYPE_DOUBLE:       // double
+      return mysql2_decode_bind_double;
+    case MYSQL_TYPE_DATE:         // MYSQL_TIME
+    case MYSQL_TYPE_NEWDATE:      // MYSQL_TIME
+      return mysql2_decode_bind_date;
+    case MYSQL_TYPE_TIME:         // MYSQL_TIME
+      return mysql2_decode_bind_time;
+    case MYSQL_TYPE_DATETIME:     // MYSQL_TIME
+    case MYSQL_TYPE_TIMESTAMP:    // MYSQL_TIME
+      return mysql2_decode_bind_datetime;
+    case MYSQL_TYPE_DECIMAL:      // char[]
+    case MYSQL_TYPE_NEWDECIMAL:   // char[]
+      switch (args->decimalAs) {
+        case MYSQL2_DECIMAL_AS_INTEGER_SCALED:
+          return mysql2_decode_bind_decimal_scaled;
+        case MYSQL2_DECIMAL_AS_RATIONAL:
+          return mysql2_decode_bind_decimal_rational;
+        default:
+          return mysql2_decode_bind_decimal;
+      }
+    case MYSQL_TYPE_STRING:       // char[]
+    case MYSQL_TYPE_VAR_STRING:   // char[]
+    case MYSQL_TYPE_VARCHAR:      // char[]
+    case MYSQL_TYPE_TINY_BLOB:    // char[]
+    case MYSQL_TYPE_BLOB:         // char[]
+    case MYSQL_TYPE_MEDIUM_BLOB:  // char[]
+    case MYSQL_TYPE_LONG_BLOB:    // char[]
+    case MYSQL_TYPE_SET:          // char[]
+    case MYSQL_TYPE_ENUM:         // char[]
+    case MYSQL_TYPE_GEOMETRY:     // char[]
+    default:
+      return mysql2_decode_bind_string;
+  }
+}
+
+/* Return the column table for this result, building it on first use and
+ * rebuilding it only if options that affect decoder selection have changed.
+ */
+static mysql2_result_column *rb_mysql_result_columns_for(VALUE self, MYSQL_FIELD *fields, const result_each_args *args) {
+  unsigned int i;
+  int flags;
+  GET_RESULT(self);
+
+  flags = (args->cast ? MYSQL2_COLUMNS_CAST : 0) |
+          (args->castBool ? MYSQL2_COLUMNS_CAST_BOOL : 0) |
+          (args->symbolizeKeys ? MYSQL2_COLUMNS_SYMBOLIZE : 0) |
+          (mysql2_legacy_decoders ? MYSQL2_COLUMNS_LEGACY : 0) |
+          (args->decimalAs << MYSQL2_COLUMNS_DECIMAL_AS_SHIFT);
+
+  if (wrapper->columns && wrapper->columnsFlags == flags) {
+    return wrapper->columns;
+  }
+
+  if (wrapper->fields == Qnil) {
+    wrapper->numberOfFields = mysql_num_fields(wrapper->result);
+    wrapper->fields = rb_ary_new2(wrapper->numberOfFields);
+  }
+  if (wrapper->columns == NULL) {
+    wrapper->columns = xcalloc(wrapper->numberOfFields, sizeof(mysql2_result_column));
+  }
+
+  for (i = 0; i < wrapper->numberOfFields; i++) {
+    mysql2_result_column *col = &wrapper->columns[i];
+    col->field = &fields[i];
+    col->decode_text = mysql2_text_decoder_for(&fields[i], args);
+    col->decode_bind = mysql2_bind_decoder_for(&fields[i], args);
+    col->enc = mysql2_field_encoding(&fields[i], args->conn_enc, &col->export_internal);
+    col->key = rb_mysql_result_fetch_field(self, i, args->symbolizeKeys);
+  }
+  wrapper->columnsFlags = flags;
+
+  return wrapper->columns;
+}
+
+/* Hash rows are copied from a template holding every key (mapped to nil) in
+ * column order, so filling in a row only replaces values and the Hash never
+ * has to grow or rehash while it's being built.
+ */
+static VALUE rb_mysql_result_new_row_hash(mysql2_result_wrapper *wrapper, const mysql2_result_column *columns) {
+  if (wrapper->rowTemplate == Qnil) {
+    unsigned int i;
+#ifdef HAVE_RB_HASH_NEW_CAPA
+    VALUE rowTemplate = rb_hash_new_capa(wrapper->numberOfFields);
+#else
+    VALUE rowTemplate = rb_hash_new();
+#endif
+
+    for (i = 0; i < wrapper->numberOfFields; i++) {
+      rb_hash_aset(rowTemplate, columns[i].key, Qnil);
+    }
+    wrapper->rowTemplate = rowTemplate;
+  }
+  return rb_hash_dup(wrapper->rowTemplate);
+}
+
+static VALUE rb_mysql_result_fetch_row_stmt(VALUE self, MYSQL_FIELD * fields, const result_each_args *args)
+{
+  VALUE rowVal;
+  unsigned int i = 0;
+  const mysql2_result_column *columns;
+  GET_RESULT(self);
+
+  columns = rb_mysql_result_columns_for(self, fields, args);
+
+  if (args->asArray) {
+    rowVal = rb_ary_new2(wrapper->numberOfFields);
+  } else {
+    rowVal = rb_mysql_result_new_row_hash(wrapper, columns);
+  }
+
+  if (wrapper->result_buffers == NULL) {
+    rb_mysql_result_alloc_result_buffers(self, fields);
+  }
+
+  if (mysql_stmt_bind_result(wrapper->stmt_wrapper->stmt, wrapper->result_buffers)) {
+    rb_raise_mysql2_stmt_error(wrapper->stmt_wrapper);
+  }
+
+  {
+    switch((uintptr_t)rb_thread_call_without_gvl(nogvl_stmt_fetch, wrapper->stmt_wrapper->stmt, RUBY_UBF_IO, 0)) {
+      case 0:
+        /* success */
+        break;
+
+      case 1:
+        /* error */
+        rb_raise_mysql2_stmt_error(wrapper->stmt_wrapper);
+
+      case MYSQL_NO_DATA:
+        /* no more row */
+        return Qnil;
+
+      case MYSQL_DATA_TRUNCATED:
+        rb_raise(cMysql2Error, "IMPLBUG: caught MYSQL_DATA_TRUNCATED. should not come here as buffer_length is set to fields[i].max_length.");
+    }
+  }
+
+  for (i = 0; i < wrapper->numberOfFields; i++) {
+    const mysql2_result_column *col = &columns[i];
+    VALUE val = wrapper->is_null[i] ? Qnil : col->decode_bind(col, &wrapper->result_buffers[i], args);
+
+    if (args->asArray) {
+      rb_ary_push(rowVal, val);
+    } else {
+      rb_hash_aset(rowVal, col->key, val);
+    }
+  }
+
+  return rowVal;
+}
+
+/* as: :raw rows are the cells in the text protocol's own row encoding: each
+ * one a length-encoded integer followed by that many bytes, or 0xFB for NULL.
+ */
+static size_t mysql2_raw_row_size(MYSQL_ROW row, const unsigned long *lengths, unsigned int numberOfFields) {
+  size_t size = 0;
+  unsigned int i;
+
+  for (i = 0; i < numberOfFields; i++) {
+    if (row[i] == NULL) {
+      size += 1;
+    } else if (lengths[i] < 251) {
+      size += 1 + lengths[i];
+    } else if (lengths[i] < 0x10000) {
+      size += 3 + lengths[i];
+    } else if (lengths[i] < 0x1000000) {
+      size += 4 + lengths[i];
+    } else {
+      size += 9 + lengths[i];
+    }
+  }
+  return size;
+}
+
+static char *mysql2_raw_row_write(char *dest, MYSQL_ROW row, const unsigned long *lengths, unsigned int numberOfFields) {
+  unsigned int i;
+
+  for (i = 0; i < numberOfFields; i++) {
+    unsigned long long len = lengths[i];
+    int n, bytes;
+
+    if (row[i] == NULL) {
+      *dest++ = (char)0xFB;
+      continue;
+    }
+    if (len < 251) {
+      *dest++ = (char)len;
+      bytes = 0;
+    } else if (len < 0x10000) {
+      *dest++ = (char)0xFC;
+      bytes = 2;
+    } else if (len < 0x1000000) {
+      *dest++ = (char)0xFD;
+      bytes = 3;
+    } else {
+      *dest++ = (char)0xFE;
+      bytes = 8;
+    }
+    for (n = 0; n < bytes; n++) {
+      *dest++ = (char)(len >> (8 * n));
+    }
+    memcpy(dest, row[i], len);
+    dest += len;
+  }
+  return dest;
+}
+
+static VALUE rb_mysql_result_raw_row(MYSQL_ROW row, const unsigned long *lengths, unsigned int numberOfFields) {
+  VALUE rowVal = rb_str_new(NULL, mysql2_raw_row_size(row, lengths, numberOfFields));
+
+  mysql2_raw_row_write(RSTRING_PTR(rowVal), row, lengths, numberOfFields);
+  return rowVal;
+}
+
+/* Build the Hash / Array / Mysql2::Row for one row of a text protocol result. */
+static VALUE rb_mysql_result_build_row(VALUE self, MYSQL_FIELD * fields, MYSQL_ROW row, unsigned long * fieldLengths, const result_each_args *args)
+{
+  VALUE rowVal;
+  unsigned int i = 0;
+  const mysql2_result_column *columns;
+  GET_RESULT(self);
+
+  if (args->asRaw) {
+    return rb_mysql_result_raw_row(row, fieldLengths, (unsigned int)wrapper->numberOfFields);
+  }
+
+  columns = rb_mysql_result_columns_for(self, fields, args);
+
+  if (args->asLazy) {
+    return rb_mysql_row_new(self, row, fieldLengths, wrapper->numberOfFields, args);
+  }
+
+  if (args->asArray) {
+    rowVal = rb_ary_new2(wrapper->numberOfFields);
+  } else {
+    rowVal = rb_mysql_result_new_row_hash(wrapper, columns);
+  }
+
+  for (i = 0; i < wrapper->numberOfFields; i++) {
+    const mysql2_result_column *col = &columns[i];
+    VALUE val = row[i] ? col->decode_text(col, row[i], fieldLengths[i], args) : Qnil;
+
+    if (args->asArray) {
+      rb_ary_push(rowVal, val);
+    } else {
+      rb_hash_aset(rowVal, col->key, val);
+    }
+  }
+  return rowVal;
+}
+
+static VALUE rb_mysql_result_fetch_row(VALUE self, MYSQL_FIELD * fields, const result_each_args *args)
+{
+  MYSQL_ROW row;
+  void * ptr;
+  GET_RESULT(self);
+
+  ptr = wrapper->result;
+  row = (MYSQL_ROW)rb_thread_call_without_gvl(nogvl_fetch_row, ptr, RUBY_UBF_IO, 0);
+  if (row == NULL) {
+    return Qnil;
+  }
+
+  return rb_mysql_result_build_row(self, fields, row, mysql_fetch_lengths(wrapper->result), args);
+}
+
+/* Streaming rows fetched batch_size at a time. The cells are copied out of
+ * libmysql (which reuses its row buffer on every mysql_fetch_row) into one
+ * arena, so a whole batch can be read with a single GVL release and decoded
+ * afterwards. The arena grows without the GVL, so it uses plain malloc.
+ */
+#define MYSQL2_BATCH_NULL ((size_t)-1)
+
+typedef struct {
+  MYSQL_RES *result;
+  unsigned int numberOfFields;
+  long maxRows;
+  long numberOfRows;
+  char *data;
+  size_t size;
+  size_t capacity;
+  size_t *offsets;        /* maxRows * numberOfFields, MYSQL2_BATCH_NULL for NULL */
+  unsigned long *lengths; /* maxRows * numberOfFields */
+  int done;
+  int oom;
+} mysql2_row_batch;
+
+typedef struct {
+  VALUE self;
+  MYSQL_FIELD *fields;
+  const result_each_args *args;
+  mysql2_row_batch *batch;
+} mysql2_row_batch_args;
+
+static void *nogvl_fetch_row_batch(void *ptr) {
+  mysql2_row_batch *batch = ptr;
+  MYSQL_ROW row;
+  unsigned long *lengths;
+  unsigned int i;
+
+  batch->numberOfRows = 0;
+  batch->size = 0;
+
+  while (batch->numberOfRows < batch->maxRows) {
+    size_t *rowOffsets = batch->offsets + batch->numberOfRows * batch->numberOfFields;
+    unsigned long *rowLengths = batch->lengths + batch->numberOfRows * batch->numberOfFields;
+
+    row = mysql_fetch_row(batch->result);
+    if (row == NULL) {
+      batch->done = 1;
+      break;
+    }
+    lengths = mysql_fetch_lengths(batch->result);
+
+    for (i = 0; i < batch->numberOfFields; i++) {
+      size_t needed;
+
+      if (row[i] == NULL) {
+        rowOffsets[i] = MYSQL2_BATCH_NULL;
+        rowLengths[i] = 0;
+        continue;
+      }
+
+      needed = batch->size + lengths[i] + 1;
+      if (needed > batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity : 4096;
+        char *data;
+
+        while (capacity < needed) {
+          capacity *= 2;
+        }
+        data = realloc(batch->data, capacity);
+        if (data == NULL) {
+          batch->oom = 1;
+          return NULL;
+        }
+        batch->data = data;
+        batch->capacity = capacity;
+      }
+
+      memcpy(batch->data + batch->size, row[i], lengths[i]);
+      batch->data[batch->size + lengths[i]] = '\0';
+      rowOffsets[i] = batch->size;
+      rowLengths[i] = lengths[i];
+      batch->size = needed;
+    }
+    batch->numberOfRows++;
+  }
+
+  return NULL;
+}
+
+static VALUE rb_mysql_result_each_batched_rows(VALUE ptr) {
+  mysql2_row_batch_args *batchArgs = (mysql2_row_batch_args *)ptr;
+  mysql2_row_batch *batch = batchArgs->batch;
+  VALUE self = batchArgs->self;
+  MYSQL_ROW row;
+  long r;
+  unsigned int i;
+  GET_RESULT(self);
+
+  row = ALLOCA_N(char *, batch->numberOfFields);
+
+  do {
+    rb_thread_call_without_gvl(nogvl_fetch_row_batch, batch, RUBY_UBF_IO, 0);
+    if (batch->oom) {
+      rb_memerror();
+    }
+
+    for (r = 0; r < batch->numberOfRows; r++) {
+      const size_t *rowOffsets = batch->offsets + r * batch->numberOfFields;
+      unsigned long *rowLengths = batch->lengths + r * batch->numberOfFields;
+      VALUE rowVal;
+
+      for (i = 0; i < batch->numberOfFields; i++) {
+        row[i] = rowOffsets[i] == MYSQL2_BATCH_NULL ? NULL : batch->data + rowOffsets[i];
+      }
+
+      rowVal = rb_mysql_result_build_row(self, batchArgs->fields, row, rowLengths, batchArgs->args);
+      wrapper->numberOfRows++;
+      if (batchArgs->args->block_given != Qnil) {
+        rb_yield(rowVal);
+      }
+    }
+  } while (!batch->done);
+
+  return Qnil;
+}
+
+static VALUE rb_mysql_result_free_row_batch(VALUE ptr) {
+  mysql2_row_batch *batch = (mysql2_row_batch *)ptr;
+
+  free(batch->data);
+  xfree(batch->offsets);
+  xfree(batch->lengths);
+  return Qnil;
+}
+
+static void rb_mysql_result_stream_batches(VALUE self, MYSQL_FIELD * fields, const result_each_args *args) {
+  mysql2_row_batch batch;
+  mysql2_row_batch_args batchArgs;
+  GET_RESULT(self);
+
+  memset(&batch, 0, sizeof(batch));
+  batch.result = wrapper->result;
+  batch.numberOfFields = (unsigned int)wrapper->numberOfFields;
+  batch.maxRows = args->batchSize;
+  batch.offsets = ALLOC_N(size_t, (size_t)batch.maxRows * batch.numberOfFields);
+  batch.lengths = ALLOC_N(unsigned long, (size_t)batch.maxRows * batch.numberOfFields);
+
+  batchArgs.self = self;
+  batchArgs.fields = fields;
+  batchArgs.args = args;
+  batchArgs.batch = &batch;
+
+  rb_ensure(rb_mysql_result_each_batched_rows, (VALUE)&batchArgs, rb_mysql_result_free_row_batch, (VALUE)&batch);
+}
+
+/* Decode cell +idx+ of a lazy row (see row.c). The stored rows are owned by
+ * the result, so this raises once the result has been freed.
+ */
+VALUE rb_mysql_result_lazy_value(VALUE self, const result_each_args *args, MYSQL_ROW row, const unsigned long *lengths, unsigned int idx) {
+  const mysql2_result_column *col;
+  GET_RESULT(self);
+
+  if (wrapper->resultFreed || wrapper->columns == NULL) {
+    rb_raise(cMysql2Error, "Result set has already been freed");
+  }
+  if (row[idx] == NULL) {
+    return Qnil;
+  }
+  /* the table may have been rebuilt for other options since, so only take the
+   * option independent parts (field, encoding) from it */
+  col = &wrapper->columns[idx];
+  return mysql2_text_decoder_for(col->field, args)(col, row[idx], lengths[idx], args);
+}
+
+/* Hash of field key => column offset, used to look up lazy row values. */
+VALUE rb_mysql_result_field_offsets(VALUE self) {
+  unsigned int i;
+  GET_RESULT(self);
+
+  if (wrapper->fieldOffsets == Qnil) {
+    VALUE offsets = rb_hash_new();
+    for (i = 0; i < wrapper->numberOfFields; i++) {
+      rb_hash_aset(offsets, rb_ary_entry(wrapper->fields, i), UINT2NUM(i));
+    }
+    wrapper->fieldOffsets = offsets;
+  }
+  return wrapper->fieldOffsets;
+}
+
+static VALUE rb_mysql_result_fetch_fields(VALUE self) {
+  unsigned int i = 0;
+  short int symbolizeKeys = 0;
+  VALUE defaults;
+
+  GET_RESULT(self);
+
+  defaults = rb_iv_get(self, "@query_options");
+  Check_Type(defaults, T_HASH);
+  if (rb_hash_aref(defaults, sym_symbolize_keys) == Qtrue) {
+    symbolizeKeys = 1;
+  }
+
+  if (wrapper->fields == Qnil) {
+    wrapper->numberOfFields = mysql_num_fields(wrapper->result);
+    wrapper->fields = rb_ary_new2(wrapper->numberOfFields);
+  }
+
+  if ((my_ulonglong)RARRAY_LEN(wrapper->fields) != wrapper->numberOfFields) {
+    for (i=0; i<wrapper->numberOfFields; i++) {
+      rb_mysql_result_fetch_field(self, i, symbolizeKeys);
+    }
+  }
+
+  return wrapper->fields;
+}
+
+static VALUE rb_mysql_result_each_(VALUE self,
+                                   VALUE(*fetch_row_func)(VALUE, MYSQL_FIELD *fields, const result_each_args *args),
+                                   const result_each_args *args)
+{
+  unsigned long i;
+  const char *errstr;
+  MYSQL_FIELD *fields = NULL;
+
+  GET_RESULT(self);
+
+  if (wrapper->is_streaming) {
+    /* When streaming, we will only yield rows, not return them. */
+    if (wrapper->rows == Qnil) {
+      wrapper->rows = rb_ary_new();
+    }
+
+    if (!wrapper->streamingComplete) {
+      VALUE row;
+
+      fields = mysql_fetch_fields(wrapper->result);
+
+      if (args->batchSize > 1 && !wrapper->stmt_wrapper) {
+        rb_mysql_result_stream_batches(self, fields, args);
+      } else {
+        do {
+          row = fetch_row_func(self, fields, args);
+          if (row != Qnil) {
+            wrapper->numberOfRows++;
+            if (args->block_given != Qnil) {
+              rb_yield(row);
+            }
+          }
+        } while(row != Qnil);
+      }
+
+      rb_mysql_result_free_result(wrapper);
+      wrapper->streamingComplete = 1;
+
+      // Check for errors, the connection might have gone out from under us
+      // mysql_error returns an empty string if there is no error
+      errstr = mysql_error(wrapper->client_wrapper->client);
+      if (errstr[0]) {
+        rb_raise(cMysql2Error, "%s", errstr);
+      }
+    } else {
+      rb_raise(cMysql2Error, "You have already fetched all the rows for this query and streaming is true. (to reiterate you must requery).");
+    }
+  } else {
+    if (args->cacheRows && wrapper->lastRowProcessed == wrapper->numberOfRows) {
+      /* we've already read the entire dataset from the C result into our */
+      /* internal array. Lets hand that over to the user since it's ready to go */
+      for (i = 0; i < wrapper->numberOfRows; i++) {
+        rb_yield(rb_ary_entry(wrapper->rows, i));
+      }
+    } else {
       unsigned long rowsProcessed = 0;
       rowsProcessed = RARRAY_LEN(wrapper->rows);
       fields = mysql_fetch_fields(wrapper->result);
@@ -783,7 +1574,7 @@ static VALUE rb_mysql_result_each_(VALUE self,
 
         if (row == Qnil) {
           /* we don't need the mysql C dataset around anymore, peace it */
-          if (args->cacheRows) {
+          if (args->cacheRows && !args->asLazy) {
             rb_mysql_result_free_result(wrapper);
           }
           return Qnil;
@@ -793,8 +1584,9 @@ static VALUE rb_mysql_result_each_(VALUE self,
           rb_yield(row);
         }
       }
-      if (wrapper->lastRowProcessed == wrapper->numberOfRows && args->cacheRows) {
+      if (wrapper->lastRowProcessed == wrapper->numberOfRows && args->cacheRows && !args->asLazy) {
         /* we don't need the mysql C dataset around anymore, peace it */
+        /* (unless lazy rows still point into it) */
         rb_mysql_result_free_result(wrapper);
       }
     }
@@ -805,17 +1597,12 @@ static VALUE rb_mysql_result_each_(VALUE self,
   return wrapper->rows;
 }
 
-static VALUE rb_mysql_result_each(int argc, VALUE * argv, VALUE self) {
-  result_each_args args;
-  VALUE defaults, opts, block, (*fetch_row_func)(VALUE, MYSQL_FIELD *fields, const result_each_args *args);
+/* Merge the per-call options into @query_options and fill in +args+. */
+static void rb_mysql_result_scan_args(VALUE self, int argc, VALUE * argv, result_each_args *args) {
+  VALUE defaults, opts, block;
+  VALUE decimalAs, batchSize;
   ID db_timezone, app_timezone, dbTz, appTz;
-  int symbolizeKeys, asArray, castBool, cacheRows, cast;
-
-  GET_RESULT(self);
-
-  if (wrapper->stmt_wrapper && wrapper->stmt_wrapper->closed) {
-    rb_raise(cMysql2Error, "Statement handle already closed");
-  }
+  GET_RESULT(self);
 
   defaults = rb_iv_get(self, "@query_options");
   Check_Type(defaults, T_HASH);
@@ -825,23 +1612,34 @@ static VALUE rb_mysql_result_each(int argc, VALUE * argv, VALUE self) {
     opts = defaults;
   }
 
-  symbolizeKeys = RTEST(rb_hash_aref(opts, sym_symbolize_keys));
-  asArray       = rb_hash_aref(opts, sym_as) == sym_array;
-  castBool      = RTEST(rb_hash_aref(opts, sym_cast_booleans));
-  cacheRows     = RTEST(rb_hash_aref(opts, sym_cache_rows));
-  cast          = RTEST(rb_hash_aref(opts, sym_cast));
-
-  if (wrapper->is_streaming && cacheRows) {
-    rb_warn(":cache_rows is ignored if :stream is true");
-  }
-
-  if (wrapper->stmt_wrapper && !cacheRows && !wrapper->is_streaming) {
-    rb_warn(":cache_rows is forced for prepared statements (if not streaming)");
-    cacheRows = 1;
+  args->symbolizeKeys = RTEST(rb_hash_aref(opts, sym_symbolize_keys));
+  args->asArray       = rb_hash_aref(opts, sym_as) == sym_array;
+  args->asLazy        = rb_hash_aref(opts, sym_as) == sym_lazy;
+  args->asRaw         = rb_hash_aref(opts, sym_as) == sym_raw;
+  args->castBool      = RTEST(rb_hash_aref(opts, sym_cast_booleans));
+  args->cacheRows     = RTEST(rb_hash_aref(opts, sym_cache_rows));
+  args->cast          = RTEST(rb_hash_aref(opts, sym_cast));
+
+  batchSize = rb_hash_aref(opts, sym_batch_size);
+  if (NIL_P(batchSize)) {
+    args->batchSize = 1;
+  } else {
+    args->batchSize = NUM2LONG(batchSize);
+    if (args->batchSize < 1) {
+      rb_raise(rb_eArgError, ":batch_size must be a positive Integer");
+    }
   }
 
-  if (wrapper->stmt_wrapper && !cast) {
-    rb_warn(":cast is forced for prepared statements");
+  decimalAs = rb_hash_aref(opts, sym_decimal_as);
+  if (decimalAs == sym_integer_scaled) {
+    args->decimalAs = MYSQL2_DECIMAL_AS_INTEGER_SCALED;
+  } else if (decimalAs == sym_rational) {
+    args->decimalAs = MYSQL2_DECIMAL_AS_RATIONAL;
+  } else {
+    if (!NIL_P(decimalAs) && decimalAs != sym_bigdecimal) {
+      rb_warn(":decimal_as option must be :bigdecimal, :integer_scaled or :rational - defaulting to :bigdecimal");
+    }
+    args->decimalAs = MYSQL2_DECIMAL_AS_BIGDECIMAL;
   }
 
   dbTz = rb_hash_aref(opts, sym_database_timezone);
@@ -865,10 +1663,57 @@ static VALUE rb_mysql_result_each(int argc, VALUE * argv, VALUE self) {
     app_timezone = Qnil;
   }
 
+  args->db_timezone = db_timezone;
+  args->app_timezone = app_timezone;
+  args->block_given = block;
+  args->default_internal_enc = rb_default_internal_encoding();
+  args->conn_enc = rb_to_encoding(wrapper->encoding);
+  args->decimal_buffer = rb_str_buf_new(0);
+}
+
+static VALUE rb_mysql_result_each(int argc, VALUE * argv, VALUE self) {
+  result_each_args args;
+  VALUE (*fetch_row_func)(VALUE, MYSQL_FIELD *fields, const result_each_args *args);
+
+  GET_RESULT(self);
+
+  if (wrapper->stmt_wrapper && wrapper->stmt_wrapper->closed) {
+    rb_raise(cMysql2Error, "Statement handle already closed");
+  }
+
+  rb_mysql_result_scan_args(self, argc, argv, &args);
+
+  if (wrapper->is_streaming && args.cacheRows) {
+    rb_warn(":cache_rows is ignored if :stream is true");
+  }
+
+  if (args.asLazy && (wrapper->stmt_wrapper || wrapper->is_streaming)) {
+    rb_raise(cMysql2Error, "as: :lazy is not supported for streaming or prepared statement results");
+  }
+
+  if (args.asRaw && wrapper->stmt_wrapper) {
+    rb_raise(cMysql2Error, "as: :raw is not supported for prepared statement results");
+  }
+
+  if (args.asRaw && wrapper->fields == Qnil) {
+    /* raw rows skip the column decoders, which is where this is set otherwise */
+    wrapper->numberOfFields = mysql_num_fields(wrapper->result);
+    wrapper->fields = rb_ary_new2(wrapper->numberOfFields);
+  }
+
+  if (wrapper->stmt_wrapper && !args.cacheRows && !wrapper->is_streaming) {
+    rb_warn(":cache_rows is forced for prepared statements (if not streaming)");
+    args.cacheRows = 1;
+  }
+
+  if (wrapper->stmt_wrapper && !args.cast) {
+    rb_warn(":cast is forced for prepared statements");
+  }
+
   if (wrapper->rows == Qnil && !wrapper->is_streaming) {
     wrapper->numberOfRows = wrapper->stmt_wrapper ? mysql_stmt_num_rows(wrapper->stmt_wrapper->stmt) : mysql_num_rows(wrapper->result);
     wrapper->rows = rb_ary_new2(wrapper->numberOfRows);
-  } else if (wrapper->rows && !cacheRows) {
+  } else if (wrapper->rows && !args.cacheRows) {
     if (wrapper->resultFreed) {
       rb_raise(cMysql2Error, "Result set has already been freed");
     }
@@ -877,16 +1722,6 @@ static VALUE rb_mysql_result_each(int argc, VALUE * argv, VALUE self) {
     wrapper->rows = rb_ary_new2(wrapper->numberOfRows);
   }
 
-  // Backward compat
-  args.symbolizeKeys = symbolizeKeys;
-  args.asArray = asArray;
-  args.castBool = castBool;
-  args.cacheRows = cacheRows;
-  args.cast = cast;
-  args.db_timezone = db_timezone;
-  args.app_timezone = app_timezone;
-  args.block_given = block;
-
   if (wrapper->stmt_wrapper) {
     fetch_row_func = rb_mysql_result_fetch_row_stmt;
   } else {
@@ -896,6 +1731,621 @@ static VALUE rb_mysql_result_each(int argc, VALUE * argv, VALUE self) {
   return rb_mysql_result_each_(self, fetch_row_func, &args);
 }
 
+/* CSV / TSV formatting for Result#write_csv. With a quote character, cells
+ * holding it, the separator or a line break are quoted with the quote
+ * doubled, as Ruby's CSV does. Without one, those bytes are backslash
+ * escaped the way LOAD DATA reads them back.
+ */
+typedef struct {
+  char col_sep;
+  char quote; /* 0 to backslash escape instead */
+  const char *null;
+  size_t null_len;
+  const char *row_sep;
+  size_t row_sep_len;
+} mysql2_csv_format;
+
+static size_t mysql2_csv_row_size(const mysql2_csv_format *csv, MYSQL_ROW row, const unsigned long *lengths, unsigned int numberOfFields) {
+  size_t size = numberOfFields + csv->row_sep_len;
+  unsigned int i;
+
+  for (i = 0; i < numberOfFields; i++) {
+    size += row[i] ? 2 * lengths[i] + 2 : csv->null_len;
+  }
+  return size;
+}
+
+static char mysql2_csv_escape_char(const mysql2_csv_format *csv, char c) {
+  switch (c) {
+    case '\0': return '0';
+    case '\n': return 'n';
+    case '\r': return 'r';
+    case '\t': return 't';
+    case '\\': return '\\';
+    default:   return c == csv->col_sep ? c : 0;
+  }
+}
+
+static char *mysql2_csv_row_write(const mysql2_csv_format *csv, char *dest, MYSQL_ROW row, const unsigned long *lengths, unsigned int numberOfFields) {
+  unsigned int i;
+  unsigned long j;
+
+  for (i = 0; i < numberOfFields; i++) {
+    const char *cell = row[i];
+    unsigned long len = lengths[i];
+
+    if (i > 0) {
+      *dest++ = csv->col_sep;
+    }
+    if (cell == NULL) {
+      memcpy(dest, csv->null, csv->null_len);
+      dest += csv->null_len;
+    } else if (csv->quote) {
+      int quoted = len == 0;
+
+      for (j = 0; j < len && !quoted; j++) {
+        quoted = cell[j] == csv->col_sep || cell[j] == csv->quote || cell[j] == '\n' || cell[j] == '\r';
+      }
+      if (!quoted) {
+        memcpy(dest, cell, len);
+        dest += len;
+        continue;
+      }
+      *dest++ = csv->quote;
+      for (j = 0; j < len; j++) {
+        if (cell[j] == csv->quote) {
+          *dest++ = csv->quote;
+        }
+        *dest++ = cell[j];
+      }
+      *dest++ = csv->quote;
+    } else {
+      for (j = 0; j < len; j++) {
+        char escaped = mysql2_csv_escape_char(csv, cell[j]);
+        if (escaped) {
+          *dest++ = '\\';
+          *dest++ = escaped;
+        } else {
+          *dest++ = cell[j];
+        }
+      }
+    }
+  }
+  memcpy(dest, csv->row_sep, csv->row_sep_len);
+  return dest + csv->row_sep_len;
+}
+
+/* Rows for Result#each_raw_row(io) and Result#write_csv, formatted without
+ * the GVL into a malloc'd buffer until it holds about MYSQL2_WRITE_FLUSH
+ * bytes, then written out in one piece: straight to the file descriptor
+ * (again without the GVL) for a real IO, or with #write otherwise.
+ */
+#define MYSQL2_WRITE_FLUSH (64 * 1024)
+
+typedef struct {
+  MYSQL_RES *result;
+  unsigned int numberOfFields;
+  const mysql2_csv_format *csv; /* NULL for as: :raw rows */
+  char *data;
+  size_t size;
+  size_t capacity;
+  unsigned long numberOfRows;
+  unsigned long maxRows; /* rows left for a buffered result */
+  int done;
+  int oom;
+} mysql2_row_writer;
+
+typedef struct {
+  mysql2_row_writer *writer;
+  VALUE io;
+  int fd; /* -1 to go through io.write */
+} mysql2_row_writer_args;
+
+typedef struct {
+  int fd;
+  const char *data;
+  size_t len;
+  int error;
+} mysql2_fd_write;
+
+static int mysql2_row_writer_reserve(mysql2_row_writer *w, size_t needed) {
+  size_t capacity;
+  char *data;
+
+  if (needed <= w->capacity) {
+    return 1;
+  }
+  capacity = w->capacity ? w->capacity : 2 * MYSQL2_WRITE_FLUSH;
+  while (capacity < needed) {
+    capacity *= 2;
+  }
+  data = realloc(w->data, capacity);
+  if (data == NULL) {
+    w->oom = 1;
+    return 0;
+  }
+  w->data = data;
+  w->capacity = capacity;
+  return 1;
+}
+
+static void *nogvl_fill_rows(void *ptr) {
+  mysql2_row_writer *w = ptr;
+  MYSQL_ROW row;
+  unsigned long *lengths;
+  size_t bound;
+  char *end;
+
+  while (w->size < MYSQL2_WRITE_FLUSH) {
+    if (w->maxRows == 0 || (row = mysql_fetch_row(w->result)) == NULL) {
+      w->done = 1;
+      break;
+    }
+    lengths = mysql_fetch_lengths(w->result);
+
+    if (w->csv) {
+      bound = mysql2_csv_row_size(w->csv, row, lengths, w->numberOfFields);
+    } else {
+      bound = mysql2_raw_row_size(row, lengths, w->numberOfFields);
+    }
+    if (!mysql2_row_writer_reserve(w, w->size + bound)) {
+      return NULL;
+    }
+
+    if (w->csv) {
+      end = mysql2_csv_row_write(w->csv, w->data + w->size, row, lengths, w->numberOfFields);
+    } else {
+      end = mysql2_raw_row_write(w->data + w->size, row, lengths, w->numberOfFields);
+    }
+    w->size = end - w->data;
+    w->numberOfRows++;
+    w->maxRows--;
+  }
+
+  return NULL;
+}
+
+static void *nogvl_fd_write(void *ptr) {
+  mysql2_fd_write *args = ptr;
+
+  while (args->len > 0) {
+    ssize_t n = write(args->fd, args->data, args->len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      args->error = errno;
+      break;
+    }
+    args->data += n;
+    args->len -= n;
+  }
+  return NULL;
+}
+
+/* Write +size+ bytes to +fd+ without the GVL, or to +io+ with #write when
+ * +fd+ is -1.
+ */
+static void rb_mysql_result_flush(VALUE io, int fd, const char *data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (fd < 0) {
+    rb_io_write(io, rb_str_new(data, size));
+  } else {
+    mysql2_fd_write args;
+
+    args.fd = fd;
+    args.data = data;
+    args.len = size;
+    for (;;) {
+      args.error = 0;
+      rb_thread_call_without_gvl(nogvl_fd_write, &args, RUBY_UBF_IO, 0);
+      if (args.error == EAGAIN || args.error == EWOULDBLOCK) {
+        rb_wait_for_single_fd(args.fd, RB_WAITFD_OUT, NULL);
+      } else if (args.error) {
+        errno = args.error;
+        rb_sys_fail("write");
+      } else {
+        break;
+      }
+    }
+  }
+}
+
+static VALUE rb_mysql_result_write_row_chunks(VALUE ptr) {
+  mysql2_row_writer_args *writerArgs = (mysql2_row_writer_args *)ptr;
+  mysql2_row_writer *w = writerArgs->writer;
+
+  do {
+    rb_thread_call_without_gvl(nogvl_fill_rows, w, RUBY_UBF_IO, 0);
+    if (w->oom) {
+      rb_memerror();
+    }
+    rb_mysql_result_flush(writerArgs->io, writerArgs->fd, w->data, w->size);
+    w->size = 0;
+  } while (!w->done);
+
+  return Qnil;
+}
+
+static VALUE rb_mysql_result_free_row_writer(VALUE ptr) {
+  free(((mysql2_row_writer *)ptr)->data);
+  return Qnil;
+}
+
+/* The descriptor to write to directly, or -1 for anything but a real IO.
+ * Whatever Ruby has buffered for the IO is flushed first so it stays in order.
+ */
+static int mysql2_io_write_fd(VALUE io) {
+  rb_io_t *fptr;
+
+  if (!RB_TYPE_P(io, T_FILE)) {
+    return -1;
+  }
+  io = rb_io_get_write_io(io);
+  GetOpenFile(io, fptr);
+  rb_io_check_writable(fptr);
+  rb_io_flush(io);
+#ifdef HAVE_RB_IO_DESCRIPTOR
+  return rb_io_descriptor(io);
+#else
+  return fptr->fd;
+#endif
+}
+
+/* Checks and setup shared by the writers below. Returns how many rows are
+ * left to fetch.
+ */
+static unsigned long rb_mysql_result_write_begin(VALUE self, const char *method) {
+  GET_RESULT(self);
+
+  if (wrapper->stmt_wrapper) {
+    rb_raise(cMysql2Error, "%s is not supported for prepared statement results", method);
+  }
+  if (wrapper->is_streaming && wrapper->streamingComplete) {
+    rb_raise(cMysql2Error, "You have already fetched all the rows for this query and streaming is true. (to reiterate you must requery).");
+  }
+  if (wrapper->resultFreed) {
+    rb_raise(cMysql2Error, "Result set has already been freed");
+  }
+
+  if (wrapper->fields == Qnil) {
+    wrapper->numberOfFields = mysql_num_fields(wrapper->result);
+    wrapper->fields = rb_ary_new2(wrapper->numberOfFields);
+  }
+
+  if (wrapper->is_streaming) {
+    return (unsigned long)-1;
+  }
+  mysql_data_seek(wrapper->result, 0);
+  return (unsigned long)mysql_num_rows(wrapper->result);
+}
+
+static void rb_mysql_result_write_end(VALUE self, unsigned long numberOfRows) {
+  const char *errstr;
+  GET_RESULT(self);
+
+  if (wrapper->is_streaming) {
+    wrapper->numberOfRows += numberOfRows;
+    if (wrapper->rows == Qnil) {
+      wrapper->rows = rb_ary_new();
+    }
+    rb_mysql_result_free_result(wrapper);
+    wrapper->streamingComplete = 1;
+
+    errstr = mysql_error(wrapper->client_wrapper->client);
+    if (errstr[0]) {
+      rb_raise(cMysql2Error, "%s", errstr);
+    }
+  } else {
+    /* put the cursor back where #each left off */
+    mysql_data_seek(wrapper->result, wrapper->lastRowProcessed);
+  }
+}
+
+/* Write every remaining row to +io+, as raw rows or as CSV, optionally after
+ * +header+ (already formatted). Returns the number of rows written.
+ */
+static VALUE rb_mysql_result_write_rows(VALUE self, VALUE io, const mysql2_csv_format *csv, VALUE header) {
+  mysql2_row_writer writer;
+  mysql2_row_writer_args writerArgs;
+  unsigned long maxRows;
+  GET_RESULT(self);
+
+  maxRows = rb_mysql_result_write_begin(self, csv ? "write_csv" : "as: :raw");
+
+  memset(&writer, 0, sizeof(writer));
+  writer.result = wrapper->result;
+  writer.numberOfFields = (unsigned int)wrapper->numberOfFields;
+  writer.csv = csv;
+  writer.maxRows = maxRows;
+
+  writerArgs.writer = &writer;
+  writerArgs.io = io;
+  writerArgs.fd = mysql2_io_write_fd(io);
+  if (!NIL_P(header)) {
+    /* goes out with the first chunk of rows */
+    if (!mysql2_row_writer_reserve(&writer, RSTRING_LEN(header))) {
+      rb_memerror();
+    }
+    memcpy(writer.data, RSTRING_PTR(header), RSTRING_LEN(header));
+    writer.size = RSTRING_LEN(header);
+  }
+  rb_ensure(rb_mysql_result_write_row_chunks, (VALUE)&writerArgs, rb_mysql_result_free_row_writer, (VALUE)&writer);
+
+  rb_mysql_result_write_end(self, writer.numberOfRows);
+  return ULONG2NUM(writer.numberOfRows);
+}
+
+/* call-seq:
+ *    result._write_raw_rows(io)
+ *
+ * Write every row, in the as: :raw encoding, to +io+ and return the number
+ * of rows written. Rows are not cached or yielded.
+ */
+static VALUE rb_mysql_result_write_raw_rows(VALUE self, VALUE io) {
+  return rb_mysql_result_write_rows(self, io, NULL, Qnil);
+}
+
+static char mysql2_csv_char_option(VALUE value, const char *name) {
+  if (NIL_P(value) || value == Qfalse) {
+    return 0;
+  }
+  StringValue(value);
+  if (RSTRING_LEN(value) != 1) {
+    rb_raise(rb_eArgError, "%s must be a single byte", name);
+  }
+  return RSTRING_PTR(value)[0];
+}
+
+/* call-seq:
+ *    result._write_csv(io, col_sep, quote, null, row_sep, headers)
+ *
+ * Write every row to +io+ as CSV (see Result#write_csv) and return the
+ * number of rows written, not counting the header line.
+ */
+static VALUE rb_mysql_result_write_csv(VALUE self, VALUE io, VALUE col_sep, VALUE quote, VALUE null, VALUE row_sep, VALUE headers) {
+  mysql2_csv_format csv;
+  VALUE header = Qnil;
+  GET_RESULT(self);
+
+  csv.col_sep = mysql2_csv_char_option(col_sep, ":col_sep");
+  csv.quote = mysql2_csv_char_option(quote, ":quote");
+  if (!csv.col_sep) {
+    rb_raise(rb_eArgError, ":col_sep must be a single byte");
+  }
+  StringValue(null);
+  StringValue(row_sep);
+  csv.null = RSTRING_PTR(null);
+  csv.null_len = RSTRING_LEN(null);
+  csv.row_sep = RSTRING_PTR(row_sep);
+  csv.row_sep_len = RSTRING_LEN(row_sep);
+
+  if (RTEST(headers) && !wrapper->resultFreed && !wrapper->stmt_wrapper) {
+    MYSQL_FIELD *fields = mysql_fetch_fields(wrapper->result);
+    unsigned int i, numberOfFields = mysql_num_fields(wrapper->result);
+    char **names = ALLOCA_N(char *, numberOfFields);
+    unsigned long *lengths = ALLOCA_N(unsigned long, numberOfFields);
+
+    for (i = 0; i < numberOfFields; i++) {
+      names[i] = fields[i].name;
+      lengths[i] = fields[i].name_length;
+    }
+    header = rb_str_new(NULL, mysql2_csv_row_size(&csv, names, lengths, numberOfFields));
+    rb_str_set_len(header, mysql2_csv_row_write(&csv, RSTRING_PTR(header), names, lengths, numberOfFields) - RSTRING_PTR(header));
+  }
+
+  RB_GC_GUARD(null);
+  RB_GC_GUARD(row_sep);
+  return rb_mysql_result_write_rows(self, io, &csv, header);
+}
+
+typedef struct {
+  mysql2_arrow_stream stream;
+  mysql2_arrow_buf out;
+  MYSQL_RES *result;
+  unsigned long maxRows;
+  unsigned long numberOfRows;
+  int done;
+  VALUE io;
+  int fd;
+} mysql2_arrow_writer;
+
+static void *nogvl_arrow_batch(void *ptr) {
+  mysql2_arrow_writer *w = ptr;
+  unsigned long rows = mysql2_arrow_write_batch(&w->stream, w->result, w->maxRows, &w->out);
+
+  w->done = rows == 0;
+  w->maxRows -= rows;
+  w->numberOfRows += rows;
+  return NULL;
+}
+
+static VALUE rb_mysql_result_write_arrow_batches(VALUE ptr) {
+  mysql2_arrow_writer *w = (mysql2_arrow_writer *)ptr;
+
+  /* the schema is already in the buffer */
+  do {
+    rb_mysql_result_flush(w->io, w->fd, w->out.data, w->out.size);
+    w->out.size = 0;
+    rb_thread_call_without_gvl(nogvl_arrow_batch, w, RUBY_UBF_IO, 0);
+    if (w->stream.error == MYSQL2_ARROW_OOM) {
+      rb_memerror();
+    } else if (w->stream.error == MYSQL2_ARROW_TOO_LARGE) {
+      rb_raise(cMysql2Error, "Row %lu has a value too large for an Arrow record batch", w->numberOfRows);
+    }
+  } while (!w->done);
+
+  if (!mysql2_arrow_write_eos(&w->out)) {
+    rb_memerror();
+  }
+  rb_mysql_result_flush(w->io, w->fd, w->out.data, w->out.size);
+  return Qnil;
+}
+
+static VALUE rb_mysql_result_free_arrow_writer(VALUE ptr) {
+  mysql2_arrow_writer *w = (mysql2_arrow_writer *)ptr;
+
+  mysql2_arrow_stream_free(&w->stream);
+  free(w->out.data);
+  return Qnil;
+}
+
+/* call-seq:
+ *    result._write_arrow(io, batch_size)
+ *
+ * Write the remaining rows to +io+ as an Arrow IPC stream, in record batches
+ * of up to +batch_size+ rows built without the GVL. Returns the number of
+ * rows written.
+ */
+static VALUE rb_mysql_result_write_arrow(VALUE self, VALUE io, VALUE batchSize) {
+  mysql2_arrow_writer writer;
+  rb_encoding *conn_enc;
+  MYSQL_FIELD *fields;
+  long batch;
+  int utf8;
+  GET_RESULT(self);
+
+  batch = NUM2LONG(batchSize);
+  if (batch < 1) {
+    rb_raise(rb_eArgError, ":batch_size must be a positive Integer");
+  }
+
+  memset(&writer, 0, sizeof(writer));
+  writer.maxRows = rb_mysql_result_write_begin(self, "to_arrow");
+  writer.result = wrapper->result;
+  writer.io = io;
+  writer.fd = mysql2_io_write_fd(io);
+
+  conn_enc = rb_to_encoding(wrapper->encoding);
+  utf8 = conn_enc == rb_utf8_encoding() || conn_enc == rb_usascii_encoding();
+  fields = mysql_fetch_fields(wrapper->result);
+  if (!mysql2_arrow_stream_init(&writer.stream, fields, (unsigned int)wrapper->numberOfFields, (unsigned long)batch, utf8) ||
+      !mysql2_arrow_write_schema(&writer.stream, fields, &writer.out)) {
+    rb_mysql_result_free_arrow_writer((VALUE)&writer);
+    rb_memerror();
+  }
+  rb_ensure(rb_mysql_result_write_arrow_batches, (VALUE)&writer, rb_mysql_result_free_arrow_writer, (VALUE)&writer);
+
+  rb_mysql_result_write_end(self, writer.numberOfRows);
+  return ULONG2NUM(writer.numberOfRows);
+}
+
+/* Once #each has cached every row, the MYSQL_RES is freed, so the columns
+ * have to be read back out of the cached rows instead.
+ */
+static VALUE rb_mysql_result_columns_from_rows(mysql2_result_wrapper *wrapper) {
+  VALUE hash, key, row, column;
+  long i, count;
+  unsigned int j;
+
+  count = RARRAY_LEN(wrapper->rows);
+  if (wrapper->fields == Qnil || (my_ulonglong)count != wrapper->numberOfRows) {
+    rb_raise(cMysql2Error, "Result set has already been freed");
+  }
+
+  hash = rb_hash_new();
+  for (j = 0; j < wrapper->numberOfFields; j++) {
+    key = rb_ary_entry(wrapper->fields, j);
+    column = rb_ary_new2(count);
+    for (i = 0; i < count; i++) {
+      row = rb_ary_entry(wrapper->rows, i);
+      if (RB_TYPE_P(row, T_ARRAY)) {
+        rb_ary_push(column, rb_ary_entry(row, j));
+      } else if (RB_TYPE_P(row, T_HASH)) {
+        rb_ary_push(column, rb_hash_aref(row, key));
+      } else {
+        rb_raise(cMysql2Error, "Result set has already been freed");
+      }
+    }
+    rb_hash_aset(hash, key, column);
+  }
+  return hash;
+}
+
+/* call-seq:
+ *    result.columns(options = {})
+ *
+ * Decode the whole result set column by column and return a Hash of
+ * field name => Array of values. The decoder for each column is picked once
+ * from its field type, and no per-row Hash or Array is allocated.
+ *
+ * When streaming, this consumes the result just like #each does. Once #each
+ * has cached every row, the columns are built from the cached rows, with
+ * the keys and values decoded as #each did.
+ */
+static VALUE rb_mysql_result_columns(int argc, VALUE * argv, VALUE self) {
+  result_each_args args;
+  MYSQL_FIELD *fields;
+  MYSQL_ROW row;
+  const mysql2_result_column *table;
+  VALUE *columns, columnsVal, hash;
+  unsigned long *fieldLengths;
+  unsigned int i;
+  const char *errstr;
+  GET_RESULT(self);
+
+  if (wrapper->stmt_wrapper) {
+    rb_raise(cMysql2Error, "Result#columns is not supported for prepared statement results");
+  }
+  if (wrapper->is_streaming && wrapper->streamingComplete) {
+    rb_raise(cMysql2Error, "You have already fetched all the rows for this query and streaming is true. (to reiterate you must requery).");
+  }
+  if (wrapper->resultFreed) {
+    if (wrapper->is_streaming || wrapper->rows == Qnil) {
+      rb_raise(cMysql2Error, "Result set has already been freed");
+    }
+    return rb_mysql_result_columns_from_rows(wrapper);
+  }
+
+  rb_mysql_result_scan_args(self, argc, argv, &args);
+
+  fields = mysql_fetch_fields(wrapper->result);
+  table = rb_mysql_result_columns_for(self, fields, &args);
+
+  columns = ALLOCA_N(VALUE, wrapper->numberOfFields);
+  columnsVal = rb_ary_new2(wrapper->numberOfFields);
+  for (i = 0; i < wrapper->numberOfFields; i++) {
+    columns[i] = rb_ary_new2(wrapper->is_streaming ? 0 : (long)mysql_num_rows(wrapper->result));
+    rb_ary_push(columnsVal, columns[i]);
+  }
+
+  if (!wrapper->is_streaming) {
+    mysql_data_seek(wrapper->result, 0);
+  }
+
+  while ((row = (MYSQL_ROW)rb_thread_call_without_gvl(nogvl_fetch_row, wrapper->result, RUBY_UBF_IO, 0)) != NULL) {
+    fieldLengths = mysql_fetch_lengths(wrapper->result);
+    for (i = 0; i < wrapper->numberOfFields; i++) {
+      const mysql2_result_column *col = &table[i];
+      rb_ary_push(columns[i], row[i] ? col->decode_text(col, row[i], fieldLengths[i], &args) : Qnil);
+    }
+    if (wrapper->is_streaming) {
+      wrapper->numberOfRows++;
+    }
+  }
+
+  hash = rb_hash_new();
+  for (i = 0; i < wrapper->numberOfFields; i++) {
+    rb_hash_aset(hash, table[i].key, columns[i]);
+  }
+  RB_GC_GUARD(columnsVal);
+
+  if (wrapper->is_streaming) {
+    rb_mysql_result_free_result(wrapper);
+    wrapper->streamingComplete = 1;
+
+    errstr = mysql_error(wrapper->client_wrapper->client);
+    if (errstr[0]) {
+      rb_raise(cMysql2Error, "%s", errstr);
+    }
+  } else {
+    /* leave the row cursor where #each expects it */
+    mysql_data_seek(wrapper->result, wrapper->lastRowProcessed);
+  }
+
+  return hash;
+}
+
 static VALUE rb_mysql_result_count(VALUE self) {
   GET_RESULT(self);
 
@@ -939,6 +2389,10 @@ VALUE rb_mysql_result_to_obj(VALUE client, VALUE encoding, VALUE options, MYSQL_
   wrapper->is_null = NULL;
   wrapper->error = NULL;
   wrapper->length = NULL;
+  wrapper->columns = NULL;
+  wrapper->columnsFlags = 0;
+  wrapper->rowTemplate = Qnil;
+  wrapper->fieldOffsets = Qnil;
 
   /* Keep a handle to the Statement to ensure it doesn't get garbage collected first */
   wrapper->statement = statement;
@@ -959,16 +2413,29 @@ VALUE rb_mysql_result_to_obj(VALUE client, VALUE encoding, VALUE options, MYSQL_
   return obj;
 }
 
+/* Switches between the fast and the legacy integer and date/time decoders
+ * for results whose column table is built afterwards. Used by the benchmarks.
+ */
+static VALUE rb_mysql_result_set_legacy_decoders(RB_MYSQL_UNUSED VALUE klass, VALUE value) {
+  mysql2_legacy_decoders = RTEST(value);
+  return value;
+}
+
 void init_mysql2_result() {
   cDate = rb_const_get(rb_cObject, rb_intern("Date"));
   cDateTime = rb_const_get(rb_cObject, rb_intern("DateTime"));
 
   cMysql2Result = rb_define_class_under(mMysql2, "Result", rb_cObject);
   rb_define_method(cMysql2Result, "each", rb_mysql_result_each, -1);
+  rb_define_method(cMysql2Result, "columns", rb_mysql_result_columns, -1);
   rb_define_method(cMysql2Result, "fields", rb_mysql_result_fetch_fields, 0);
   rb_define_method(cMysql2Result, "free", rb_mysql_result_free_, 0);
   rb_define_method(cMysql2Result, "count", rb_mysql_result_count, 0);
+  rb_define_private_method(cMysql2Result, "_write_raw_rows", rb_mysql_result_write_raw_rows, 1);
+  rb_define_private_method(cMysql2Result, "_write_csv", rb_mysql_result_write_csv, 6);
+  rb_define_private_method(cMysql2Result, "_write_arrow", rb_mysql_result_write_arrow, 2);
   rb_define_alias(cMysql2Result, "size", "count");
+  rb_define_private_method(rb_singleton_class(cMysql2Result), "_legacy_decoders=", rb_mysql_result_set_legacy_decoders, 1);
 
   intern_new          = rb_intern("new");
   intern_utc          = rb_intern("utc");
@@ -979,6 +2446,7 @@ void init_mysql2_result() {
   intern_civil        = rb_intern("civil");
   intern_new_offset   = rb_intern("new_offset");
   intern_BigDecimal   = rb_intern("BigDecimal");
+  intern_pow          = rb_intern("**");
 
   sym_symbolize_keys  = ID2SYM(rb_intern("symbolize_keys"));
   sym_as              = ID2SYM(rb_intern("as"));
@@ -992,6 +2460,13 @@ void init_mysql2_result() {
   sym_cast           = ID2SYM(rb_intern("cast"));
   sym_stream         = ID2SYM(rb_intern("stream"));
   sym_name           = ID2SYM(rb_intern("name"));
+  sym_decimal_as     = ID2SYM(rb_intern("decimal_as"));
+  sym_bigdecimal     = ID2SYM(rb_intern("bigdecimal"));
+  sym_integer_scaled = ID2SYM(rb_intern("integer_scaled"));
+  sym_rational       = ID2SYM(rb_intern("rational"));
+  sym_lazy           = ID2SYM(rb_intern("lazy"));
+  sym_raw            = ID2SYM(rb_intern("raw"));
+  sym_batch_size     = ID2SYM(rb_intern("batch_size"));
 
   opt_decimal_zero = rb_str_new2("0.0");
   rb_global_variable(&opt_decimal_zero); /*never GC */
@@ -4,12 +4,48 @@
 void init_mysql2_result(void);
 VALUE rb_mysql_result_to_obj(VALUE client, VALUE encoding, VALUE options, MYSQL_RES *r, VALUE statement);
 
+/* options for a single Result#each (or #columns) call */
+typedef struct {
+  int symbolizeKeys;
+  int asArray;
+  int asLazy;
+  int asRaw;
+  int castBool;
+  int cacheRows;
+  int cast;
+  int streaming;
+  int decimalAs;
+  long batchSize;
+  ID db_timezone;
+  ID app_timezone;
+  VALUE block_given;
+  rb_encoding *default_internal_enc;
+  rb_encoding *conn_enc;
+  VALUE decimal_buffer;
+} result_each_args;
+
+/* Broken out DATE, TIME and DATETIME components as sent by the server. */
+typedef struct {
+  unsigned int year, month, day, hour, min, sec, usec;
+} mysql2_time_parts;
+
+int mysql2_parse_date_fast(const char *cell, unsigned long len, mysql2_time_parts *t);
+int mysql2_parse_datetime_fast(const char *cell, unsigned long len, mysql2_time_parts *t);
+int64_t mysql2_days_from_civil(int64_t year, unsigned int month, unsigned int day);
+
+VALUE rb_mysql_result_lazy_value(VALUE self, const result_each_args *args, MYSQL_ROW row, const unsigned long *lengths, unsigned int idx);
+VALUE rb_mysql_result_field_offsets(VALUE self);
+
+typedef struct mysql2_result_column mysql2_result_column;
+
 typedef struct {
   VALUE fields;
   VALUE rows;
   VALUE client;
   VALUE encoding;
   VALUE statement;
+  VALUE rowTemplate;
+  VALUE fieldOffsets;
   my_ulonglong numberOfFields;
   my_ulonglong numberOfRows;
   unsigned long lastRowProcessed;
@@ -24,6 +60,9 @@ typedef struct {
   my_bool *is_null;
   my_bool *error;
   unsigned long *length;
+  /* per-column decoders, built on first fetch */
+  mysql2_result_column *columns;
+  int columnsFlags;
 } mysql2_result_wrapper;
 
 #endif
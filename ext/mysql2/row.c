@@ -0,0 +1,168 @@
+#include <mysql2_ext.h>
+
+extern VALUE mMysql2;
+static VALUE cMysql2Row;
+static ID intern_keys;
+
+/* A row of a buffered (non-streaming) result whose cells are only decoded
+ * when they are read. It points into the MYSQL_ROW owned by the result, so it
+ * keeps the result alive, and it remembers the options of the Result#each
+ * call that created it.
+ */
+typedef struct {
+  VALUE result;
+  MYSQL_ROW row;
+  unsigned long *lengths;
+  unsigned int numberOfFields;
+  VALUE *values;
+  char *decoded;
+  result_each_args args;
+} mysql2_row_wrapper;
+
+#define GET_ROW(self) \
+  mysql2_row_wrapper *wrapper; \
+  Data_Get_Struct(self, mysql2_row_wrapper, wrapper);
+
+static void rb_mysql_row_mark(void *ptr) {
+  mysql2_row_wrapper *w = ptr;
+  unsigned int i;
+
+  if (w) {
+    rb_gc_mark(w->result);
+    rb_gc_mark(w->args.decimal_buffer);
+    for (i = 0; i < w->numberOfFields; i++) {
+      if (w->decoded[i]) {
+        rb_gc_mark(w->values[i]);
+      }
+    }
+  }
+}
+
+static void rb_mysql_row_free(void *ptr) {
+  mysql2_row_wrapper *w = ptr;
+
+  xfree(w->lengths);
+  xfree(w->values);
+  xfree(w->decoded);
+  xfree(w);
+}
+
+VALUE rb_mysql_row_new(VALUE result, MYSQL_ROW row, const unsigned long *lengths, unsigned int numberOfFields, const result_each_args *args) {
+  VALUE obj;
+  mysql2_row_wrapper *wrapper;
+
+  obj = Data_Make_Struct(cMysql2Row, mysql2_row_wrapper, rb_mysql_row_mark, rb_mysql_row_free, wrapper);
+  wrapper->result = result;
+  wrapper->row = row;
+  wrapper->numberOfFields = numberOfFields;
+  /* mysql_fetch_lengths reuses its buffer for every row */
+  wrapper->lengths = xmalloc(numberOfFields * sizeof(unsigned long));
+  memcpy(wrapper->lengths, lengths, numberOfFields * sizeof(unsigned long));
+  wrapper->values = xmalloc(numberOfFields * sizeof(VALUE));
+  wrapper->decoded = xcalloc(numberOfFields, sizeof(char));
+  wrapper->args = *args;
+  wrapper->args.block_given = Qnil;
+
+  return obj;
+}
+
+static VALUE rb_mysql_row_value(mysql2_row_wrapper *wrapper, unsigned int idx) {
+  if (!wrapper->decoded[idx]) {
+    wrapper->values[idx] = rb_mysql_result_lazy_value(wrapper->result, &wrapper->args, wrapper->row, wrapper->lengths, idx);
+    wrapper->decoded[idx] = 1;
+  }
+  return wrapper->values[idx];
+}
+
+/* call-seq:
+ *    row[key]
+ *
+ * Returns the value of the field +key+, decoding it on first access, or nil
+ * if there is no such field. Keys are Strings, or Symbols when the result
+ * was iterated with :symbolize_keys.
+ */
+static VALUE rb_mysql_row_aref(VALUE self, VALUE key) {
+  VALUE offset;
+  GET_ROW(self);
+
+  offset = rb_hash_lookup2(rb_mysql_result_field_offsets(wrapper->result), key, Qnil);
+  if (NIL_P(offset)) {
+    return Qnil;
+  }
+  return rb_mysql_row_value(wrapper, NUM2UINT(offset));
+}
+
+/* call-seq:
+ *    row.key?(key)
+ *
+ * Whether the row has a field +key+. Does not decode anything.
+ */
+static VALUE rb_mysql_row_has_key(VALUE self, VALUE key) {
+  GET_ROW(self);
+
+  return rb_hash_lookup2(rb_mysql_result_field_offsets(wrapper->result), key, Qnil) == Qnil ? Qfalse : Qtrue;
+}
+
+/* call-seq:
+ *    row.keys
+ *
+ * The field keys of the row, in column order. Does not decode anything.
+ */
+static VALUE rb_mysql_row_keys(VALUE self) {
+  GET_ROW(self);
+
+  return rb_funcall(rb_mysql_result_field_offsets(wrapper->result), intern_keys, 0);
+}
+
+/* call-seq:
+ *    row.size
+ *
+ * The number of fields in the row.
+ */
+static VALUE rb_mysql_row_size(VALUE self) {
+  GET_ROW(self);
+
+  return LONG2NUM(RHASH_SIZE(rb_mysql_result_field_offsets(wrapper->result)));
+}
+
+/* call-seq:
+ *    row.to_h
+ *
+ * Decode every field and return them as a Hash, like the rows of a result
+ * iterated without :as => :lazy.
+ */
+typedef struct {
+  mysql2_row_wrapper *wrapper;
+  VALUE hash;
+} mysql2_row_to_h_args;
+
+static int rb_mysql_row_to_h_i(VALUE key, VALUE offset, VALUE arg) {
+  mysql2_row_to_h_args *args = (mysql2_row_to_h_args *)arg;
+
+  rb_hash_aset(args->hash, key, rb_mysql_row_value(args->wrapper, NUM2UINT(offset)));
+  return ST_CONTINUE;
+}
+
+static VALUE rb_mysql_row_to_h(VALUE self) {
+  mysql2_row_to_h_args args;
+  GET_ROW(self);
+
+  args.wrapper = wrapper;
+  args.hash = rb_hash_new();
+  /* with duplicate field names the last column wins, as it does in Hash rows */
+  rb_hash_foreach(rb_mysql_result_field_offsets(wrapper->result), rb_mysql_row_to_h_i, (VALUE)&args);
+  return args.hash;
+}
+
+void init_mysql2_row() {
+  cMysql2Row = rb_define_class_under(mMysql2, "Row", rb_cObject);
+  rb_undef_alloc_func(cMysql2Row);
+
+  rb_define_method(cMysql2Row, "[]", rb_mysql_row_aref, 1);
+  rb_define_method(cMysql2Row, "key?", rb_mysql_row_has_key, 1);
+  rb_define_method(cMysql2Row, "keys", rb_mysql_row_keys, 0);
+  rb_define_method(cMysql2Row, "size", rb_mysql_row_size, 0);
+  rb_define_method(cMysql2Row, "to_h", rb_mysql_row_to_h, 0);
+
+  intern_keys = rb_intern("keys");
+}
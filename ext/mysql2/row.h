@@ -0,0 +1,7 @@
+#ifndef MYSQL2_ROW_H
+#define MYSQL2_ROW_H
+
+void init_mysql2_row(void);
+VALUE rb_mysql_row_new(VALUE result, MYSQL_ROW row, const unsigned long *lengths, unsigned int numberOfFields, const result_each_args *args);
+
+#endif
@@ -1,8 +1,9 @@
 #include <mysql2_ext.h>
 
 extern VALUE mMysql2, cMysql2Error;
-static VALUE cMysql2Statement, cBigDecimal, cDateTime, cDate;
-static VALUE sym_stream, intern_new_with_args, intern_each, intern_to_s, intern_merge_bang;
+static VALUE cMysql2Statement, cMysql2BatchResult, cBigDecimal, cDateTime, cDate;
+static VALUE sym_stream, intern_new_with_args, intern_each, intern_to_s, intern_merge_bang,
+  intern_at_batch_row, intern_at_batch_affected_rows;
 static VALUE intern_sec_fraction, intern_usec, intern_sec, intern_min, intern_hour, intern_day, intern_month, intern_year;
 
 #define GET_STATEMENT(self) \
@@ -37,12 +38,16 @@ void decr_mysql2_stmt(mysql_stmt_wrapper *stmt_wrapper) {
 
   if (stmt_wrapper->refcount == 0) {
     nogvl_stmt_close(stmt_wrapper);
+    if (stmt_wrapper->param_binds) {
+      xfree(stmt_wrapper->param_binds);
+      xfree(stmt_wrapper->param_lengths);
+      xfree(stmt_wrapper->param_values);
+    }
     xfree(stmt_wrapper);
   }
 }
 
-void rb_raise_mysql2_stmt_error(mysql_stmt_wrapper *stmt_wrapper) {
-  VALUE e;
+static VALUE mysql2_stmt_error(mysql_stmt_wrapper *stmt_wrapper) {
   GET_CLIENT(stmt_wrapper->client);
   VALUE rb_error_msg = rb_str_new2(mysql_stmt_error(stmt_wrapper->stmt));
   VALUE rb_sql_state = rb_tainted_str_new2(mysql_stmt_sqlstate(stmt_wrapper->stmt));
@@ -59,12 +64,15 @@ void rb_raise_mysql2_stmt_error(mysql_stmt_wrapper *stmt_wrapper) {
     rb_sql_state = rb_str_export_to_enc(rb_sql_state, default_internal_enc);
   }
 
-  e = rb_funcall(cMysql2Error, intern_new_with_args, 4,
-                 rb_error_msg,
-                 LONG2FIX(wrapper->server_version),
-                 UINT2NUM(mysql_stmt_errno(stmt_wrapper->stmt)),
-                 rb_sql_state);
-  rb_exc_raise(e);
+  return rb_funcall(cMysql2Error, intern_new_with_args, 4,
+                    rb_error_msg,
+                    LONG2FIX(wrapper->server_version),
+                    UINT2NUM(mysql_stmt_errno(stmt_wrapper->stmt)),
+                    rb_sql_state);
+}
+
+void rb_raise_mysql2_stmt_error(mysql_stmt_wrapper *stmt_wrapper) {
+  rb_exc_raise(mysql2_stmt_error(stmt_wrapper));
 }
 
 /*
@@ -101,6 +109,12 @@ VALUE rb_mysql_stmt_new(VALUE rb_client, VALUE sql) {
     stmt_wrapper->refcount = 1;
     stmt_wrapper->closed = 0;
     stmt_wrapper->stmt = NULL;
+    stmt_wrapper->param_count = 0;
+    stmt_wrapper->param_binds = NULL;
+    stmt_wrapper->param_lengths = NULL;
+    stmt_wrapper->param_values = NULL;
+    stmt_wrapper->params_bound = 0;
+    stmt_wrapper->streaming_result = NULL;
   }
 
   // instantiate stmt
@@ -168,31 +182,45 @@ static void *nogvl_stmt_execute(void *ptr) {
   }
 }
 
-static void set_buffer_for_string(MYSQL_BIND* bind_buffer, unsigned long *length_buffer, VALUE string) {
-  unsigned long length;
+/* Allocate the bind area on first use. Every length pointer is fixed to its
+ * slot in param_lengths so that only buffer_type and buffer can go stale.
+ */
+static void alloc_param_binds(mysql_stmt_wrapper *stmt_wrapper, unsigned long count) {
+  unsigned long i;
 
-  bind_buffer->buffer = RSTRING_PTR(string);
+  if (stmt_wrapper->param_binds) return;
 
-  length = RSTRING_LEN(string);
-  bind_buffer->buffer_length = length;
-  *length_buffer = length;
+  stmt_wrapper->param_binds = xcalloc(count, sizeof(MYSQL_BIND));
+  stmt_wrapper->param_lengths = xcalloc(count, sizeof(unsigned long));
+  stmt_wrapper->param_values = xcalloc(count, sizeof(mysql2_stmt_param));
+  stmt_wrapper->param_count = count;
+  stmt_wrapper->params_bound = 0;
 
-  bind_buffer->length = length_buffer;
+  for (i = 0; i < count; i++) {
+    stmt_wrapper->param_binds[i].length = &stmt_wrapper->param_lengths[i];
+  }
 }
 
-/* Free each bind_buffer[i].buffer except when params_enc is non-nil, this means
- * the buffer is a Ruby string pointer and not our memory to manage.
+/* mysql_stmt_bind_param copies the bind array, so a parameter whose type or
+ * buffer moved since the last call means it has to be called again.
  */
-#define FREE_BINDS                                          \
-  for (i = 0; i < bind_count; i++) {                        \
-    if (bind_buffers[i].buffer && NIL_P(params_enc[i])) {   \
-      xfree(bind_buffers[i].buffer);                        \
-    }                                                       \
-  }                                                         \
-  if (argc > 0) {                                           \
-    xfree(bind_buffers);                                    \
-    xfree(length_buffers);                                  \
+static void set_param_bind(mysql_stmt_wrapper *stmt_wrapper, unsigned long i, enum enum_field_types type, void *buffer) {
+  MYSQL_BIND *bind_buffer = &stmt_wrapper->param_binds[i];
+
+  if (bind_buffer->buffer_type != type || bind_buffer->buffer != buffer) {
+    stmt_wrapper->params_bound = 0;
+    bind_buffer->buffer_type = type;
+    bind_buffer->buffer = buffer;
   }
+}
+
+static void set_buffer_for_string(mysql_stmt_wrapper *stmt_wrapper, unsigned long i, enum enum_field_types type, VALUE string) {
+  unsigned long length = RSTRING_LEN(string);
+
+  set_param_bind(stmt_wrapper, i, type, RSTRING_PTR(string));
+  stmt_wrapper->param_binds[i].buffer_length = length;
+  stmt_wrapper->param_lengths[i] = length;
+}
 
 /* return 0 if the given bignum can cast as LONG_LONG, otherwise 1 */
 static int my_big2ll(VALUE bignum, LONG_LONG *ptr)
@@ -239,13 +267,103 @@ overflow:
   return 1;
 }
 
+/* Convert a Ruby bind parameter. Scalars are written to +value+, strings and
+ * decimals are exported to the connection encoding and returned in +string+,
+ * which is Qnil otherwise. Returns the buffer_type to bind the value with;
+ * unsupported objects come back as MYSQL_TYPE_DECIMAL with no buffer.
+ */
+static enum enum_field_types convert_param(VALUE param, rb_encoding *conn_enc, mysql2_stmt_param *value, VALUE *string) {
+  *string = Qnil;
+
+  switch (TYPE(param)) {
+    case T_NIL:
+      return MYSQL_TYPE_NULL;
+    case T_FIXNUM:
+#if SIZEOF_INT < SIZEOF_LONG
+      value->ll = FIX2LONG(param);
+      return MYSQL_TYPE_LONGLONG;
+#else
+      value->i = FIX2INT(param);
+      return MYSQL_TYPE_LONG;
+#endif
+    case T_BIGNUM:
+      {
+        LONG_LONG num;
+        if (my_big2ll(param, &num) == 0) {
+          value->ll = num;
+          return MYSQL_TYPE_LONGLONG;
+        }
+        /* The bignum was larger than we can fit in LONG_LONG, send it as a string */
+        *string = rb_str_export_to_enc(rb_big2str(param, 10), conn_enc);
+        return MYSQL_TYPE_NEWDECIMAL;
+      }
+    case T_FLOAT:
+      value->d = NUM2DBL(param);
+      return MYSQL_TYPE_DOUBLE;
+    case T_STRING:
+      *string = rb_str_export_to_enc(param, conn_enc);
+      return MYSQL_TYPE_STRING;
+    case T_TRUE:
+      value->tiny = 1;
+      return MYSQL_TYPE_TINY;
+    case T_FALSE:
+      value->tiny = 0;
+      return MYSQL_TYPE_TINY;
+    default:
+      // TODO: what Ruby type should support MYSQL_TYPE_TIME
+      if (CLASS_OF(param) == rb_cTime || CLASS_OF(param) == cDateTime) {
+        MYSQL_TIME t;
+
+        memset(&t, 0, sizeof(MYSQL_TIME));
+        t.neg = 0;
+
+        if (CLASS_OF(param) == rb_cTime) {
+          t.second_part = FIX2INT(rb_funcall(param, intern_usec, 0));
+        } else if (CLASS_OF(param) == cDateTime) {
+          t.second_part = NUM2DBL(rb_funcall(param, intern_sec_fraction, 0)) * 1000000;
+        }
+
+        t.second = FIX2INT(rb_funcall(param, intern_sec, 0));
+        t.minute = FIX2INT(rb_funcall(param, intern_min, 0));
+        t.hour = FIX2INT(rb_funcall(param, intern_hour, 0));
+        t.day = FIX2INT(rb_funcall(param, intern_day, 0));
+        t.month = FIX2INT(rb_funcall(param, intern_month, 0));
+        t.year = FIX2INT(rb_funcall(param, intern_year, 0));
+
+        value->t = t;
+        return MYSQL_TYPE_DATETIME;
+      } else if (CLASS_OF(param) == cDate) {
+        MYSQL_TIME t;
+
+        memset(&t, 0, sizeof(MYSQL_TIME));
+        t.second_part = 0;
+        t.neg = 0;
+        t.day = FIX2INT(rb_funcall(param, intern_day, 0));
+        t.month = FIX2INT(rb_funcall(param, intern_month, 0));
+        t.year = FIX2INT(rb_funcall(param, intern_year, 0));
+
+        value->t = t;
+        return MYSQL_TYPE_DATE;
+      } else if (CLASS_OF(param) == cBigDecimal) {
+        // DECIMAL are represented with the "string representation of the
+        // original server-side value", see
+        // https://dev.mysql.com/doc/refman/5.7/en/c-api-prepared-statement-type-conversions.html
+        // This should be independent of the locale used both on the server
+        // and the client side.
+        VALUE rb_val_as_string = rb_funcall(param, intern_to_s, 0);
+
+        *string = rb_str_export_to_enc(rb_val_as_string, conn_enc);
+        return MYSQL_TYPE_NEWDECIMAL;
+      }
+      return MYSQL_TYPE_DECIMAL;
+  }
+}
+
 /* call-seq: stmt.execute
  *
  * Executes the current prepared statement, returns +result+.
  */
 static VALUE rb_mysql_stmt_execute(int argc, VALUE *argv, VALUE self) {
-  MYSQL_BIND *bind_buffers = NULL;
-  unsigned long *length_buffers = NULL;
   unsigned long bind_count;
   unsigned long i;
   MYSQL_STMT *stmt;
@@ -276,130 +394,34 @@ static VALUE rb_mysql_stmt_execute(int argc, VALUE *argv, VALUE self) {
 
   // setup any bind variables in the query
   if (bind_count > 0) {
+    mysql2_stmt_param *values;
+
     // Scratch space for string encoding exports, allocate on the stack
     params_enc = alloca(sizeof(VALUE) * bind_count);
-    bind_buffers = xcalloc(bind_count, sizeof(MYSQL_BIND));
-    length_buffers = xcalloc(bind_count, sizeof(unsigned long));
+    alloc_param_binds(stmt_wrapper, bind_count);
+    values = stmt_wrapper->param_values;
 
     for (i = 0; i < bind_count; i++) {
-      bind_buffers[i].buffer = NULL;
-      params_enc[i] = Qnil;
-
-      switch (TYPE(argv[i])) {
-        case T_NIL:
-          bind_buffers[i].buffer_type = MYSQL_TYPE_NULL;
-          break;
-        case T_FIXNUM:
-#if SIZEOF_INT < SIZEOF_LONG
-          bind_buffers[i].buffer_type = MYSQL_TYPE_LONGLONG;
-          bind_buffers[i].buffer = xmalloc(sizeof(long long int));
-          *(long*)(bind_buffers[i].buffer) = FIX2LONG(argv[i]);
-#else
-          bind_buffers[i].buffer_type = MYSQL_TYPE_LONG;
-          bind_buffers[i].buffer = xmalloc(sizeof(int));
-          *(long*)(bind_buffers[i].buffer) = FIX2INT(argv[i]);
-#endif
-          break;
-        case T_BIGNUM:
-          {
-            LONG_LONG num;
-            if (my_big2ll(argv[i], &num) == 0) {
-              bind_buffers[i].buffer_type = MYSQL_TYPE_LONGLONG;
-              bind_buffers[i].buffer = xmalloc(sizeof(long long int));
-              *(LONG_LONG*)(bind_buffers[i].buffer) = num;
-            } else {
-              /* The bignum was larger than we can fit in LONG_LONG, send it as a string */
-              bind_buffers[i].buffer_type = MYSQL_TYPE_NEWDECIMAL;
-              params_enc[i] = rb_str_export_to_enc(rb_big2str(argv[i], 10), conn_enc);
-              set_buffer_for_string(&bind_buffers[i], &length_buffers[i], params_enc[i]);
-            }
-          }
-          break;
-        case T_FLOAT:
-          bind_buffers[i].buffer_type = MYSQL_TYPE_DOUBLE;
-          bind_buffers[i].buffer = xmalloc(sizeof(double));
-          *(double*)(bind_buffers[i].buffer) = NUM2DBL(argv[i]);
-          break;
-        case T_STRING:
-          bind_buffers[i].buffer_type = MYSQL_TYPE_STRING;
-
-          params_enc[i] = argv[i];
-          params_enc[i] = rb_str_export_to_enc(params_enc[i], conn_enc);
-          set_buffer_for_string(&bind_buffers[i], &length_buffers[i], params_enc[i]);
-          break;
-        case T_TRUE:
-          bind_buffers[i].buffer_type = MYSQL_TYPE_TINY;
-          bind_buffers[i].buffer = xmalloc(sizeof(signed char));
-          *(signed char*)(bind_buffers[i].buffer) = 1;
-          break;
-        case T_FALSE:
-          bind_buffers[i].buffer_type = MYSQL_TYPE_TINY;
-          bind_buffers[i].buffer = xmalloc(sizeof(signed char));
-          *(signed char*)(bind_buffers[i].buffer) = 0;
-          break;
-        default:
-          // TODO: what Ruby type should support MYSQL_TYPE_TIME
-          if (CLASS_OF(argv[i]) == rb_cTime || CLASS_OF(argv[i]) == cDateTime) {
-            MYSQL_TIME t;
-            VALUE rb_time = argv[i];
-
-            bind_buffers[i].buffer_type = MYSQL_TYPE_DATETIME;
-            bind_buffers[i].buffer = xmalloc(sizeof(MYSQL_TIME));
-
-            memset(&t, 0, sizeof(MYSQL_TIME));
-            t.neg = 0;
-
-            if (CLASS_OF(argv[i]) == rb_cTime) {
-              t.second_part = FIX2INT(rb_funcall(rb_time, intern_usec, 0));
-            } else if (CLASS_OF(argv[i]) == cDateTime) {
-              t.second_part = NUM2DBL(rb_funcall(rb_time, intern_sec_fraction, 0)) * 1000000;
-            }
-
-            t.second = FIX2INT(rb_funcall(rb_time, intern_sec, 0));
-            t.minute = FIX2INT(rb_funcall(rb_time, intern_min, 0));
-            t.hour = FIX2INT(rb_funcall(rb_time, intern_hour, 0));
-            t.day = FIX2INT(rb_funcall(rb_time, intern_day, 0));
-            t.month = FIX2INT(rb_funcall(rb_time, intern_month, 0));
-            t.year = FIX2INT(rb_funcall(rb_time, intern_year, 0));
-
-            *(MYSQL_TIME*)(bind_buffers[i].buffer) = t;
-          } else if (CLASS_OF(argv[i]) == cDate) {
-            MYSQL_TIME t;
-            VALUE rb_time = argv[i];
-
-            bind_buffers[i].buffer_type = MYSQL_TYPE_DATE;
-            bind_buffers[i].buffer = xmalloc(sizeof(MYSQL_TIME));
-
-            memset(&t, 0, sizeof(MYSQL_TIME));
-            t.second_part = 0;
-            t.neg = 0;
-            t.day = FIX2INT(rb_funcall(rb_time, intern_day, 0));
-            t.month = FIX2INT(rb_funcall(rb_time, intern_month, 0));
-            t.year = FIX2INT(rb_funcall(rb_time, intern_year, 0));
-
-            *(MYSQL_TIME*)(bind_buffers[i].buffer) = t;
-          } else if (CLASS_OF(argv[i]) == cBigDecimal) {
-            bind_buffers[i].buffer_type = MYSQL_TYPE_NEWDECIMAL;
-
-            // DECIMAL are represented with the "string representation of the
-            // original server-side value", see
-            // https://dev.mysql.com/doc/refman/5.7/en/c-api-prepared-statement-type-conversions.html
-            // This should be independent of the locale used both on the server
-            // and the client side.
-            VALUE rb_val_as_string = rb_funcall(argv[i], intern_to_s, 0);
-
-            params_enc[i] = rb_val_as_string;
-            params_enc[i] = rb_str_export_to_enc(params_enc[i], conn_enc);
-            set_buffer_for_string(&bind_buffers[i], &length_buffers[i], params_enc[i]);
-          }
-          break;
+      enum enum_field_types type = convert_param(argv[i], conn_enc, &values[i], &params_enc[i]);
+
+      if (!NIL_P(params_enc[i])) {
+        set_buffer_for_string(stmt_wrapper, i, type, params_enc[i]);
+      } else if (type == MYSQL_TYPE_NULL || type == MYSQL_TYPE_DECIMAL) {
+        set_param_bind(stmt_wrapper, i, type, NULL);
+        stmt_wrapper->param_binds[i].buffer_length = 0;
+        stmt_wrapper->param_lengths[i] = 0;
+      } else {
+        set_param_bind(stmt_wrapper, i, type, &values[i]);
       }
     }
 
-    // copies bind_buffers into internal storage
-    if (mysql_stmt_bind_param(stmt, bind_buffers)) {
-      FREE_BINDS;
-      rb_raise_mysql2_stmt_error(stmt_wrapper);
+    // copies param_binds into internal storage, only needed when a type or
+    // buffer moved since the last execute; scalar values are read in place
+    if (!stmt_wrapper->params_bound) {
+      if (mysql_stmt_bind_param(stmt, stmt_wrapper->param_binds)) {
+        rb_raise_mysql2_stmt_error(stmt_wrapper);
+      }
+      stmt_wrapper->params_bound = 1;
     }
   }
 
@@ -431,18 +453,14 @@ static VALUE rb_mysql_stmt_execute(int argc, VALUE *argv, VALUE self) {
   if (is_streaming) {
     unsigned long type = CURSOR_TYPE_READ_ONLY;
     if (mysql_stmt_attr_set(stmt, STMT_ATTR_CURSOR_TYPE, &type)) {
-      FREE_BINDS;
       rb_raise(cMysql2Error, "Unable to stream prepared statement, could not set CURSOR_TYPE_READ_ONLY");
     }
   }
 
   if ((VALUE)rb_thread_call_without_gvl(nogvl_stmt_execute, stmt, RUBY_UBF_IO, 0) == Qfalse) {
-    FREE_BINDS;
     rb_raise_mysql2_stmt_error(stmt_wrapper);
   }
 
-  FREE_BINDS;
-
   metadata = mysql_stmt_result_metadata(stmt);
   if (metadata == NULL) {
     if (mysql_stmt_errno(stmt) != 0) {
@@ -464,6 +482,7 @@ static VALUE rb_mysql_stmt_execute(int argc, VALUE *argv, VALUE self) {
   }
 
   resultObj = rb_mysql_result_to_obj(stmt_wrapper->client, wrapper->encoding, current, metadata, self);
+  stmt_wrapper->streaming_result = is_streaming ? DATA_PTR(resultObj) : NULL;
 
   rb_mysql_set_server_query_flags(wrapper->client, resultObj);
 
@@ -475,6 +494,263 @@ static VALUE rb_mysql_stmt_execute(int argc, VALUE *argv, VALUE self) {
   return resultObj;
 }
 
+/* Everything #execute_batch needs, released by batch_free even when a row
+ * fails to convert or execute.
+ */
+typedef struct {
+  mysql_stmt_wrapper *stmt_wrapper;
+  VALUE rows;
+  VALUE strings; /* keeps exported string parameters alive */
+  rb_encoding *conn_enc;
+  unsigned long param_count;
+  unsigned long row_count;
+  MYSQL_BIND *binds; /* row_count * param_count, one row after another */
+  unsigned long *lengths;
+  mysql2_stmt_param *values;
+  my_ulonglong affected_rows; /* so far, when a row fails */
+  my_ulonglong insert_id;
+  long failed_row; /* -1 unless a row failed to execute on its own */
+#ifdef HAVE_CONST_STMT_ATTR_ARRAY_SIZE
+  int bulk;
+  MYSQL_BIND *columns; /* param_count column-wise binds for the bulk protocol */
+  mysql2_stmt_param *cells;
+  unsigned long *column_lengths;
+  char *indicators;
+#endif
+} mysql2_stmt_batch;
+
+static void *nogvl_stmt_execute_batch(void *ptr) {
+  mysql2_stmt_batch *batch = ptr;
+  MYSQL_STMT *stmt = batch->stmt_wrapper->stmt;
+  unsigned long r;
+
+  for (r = 0; r < batch->row_count; r++) {
+    if ((batch->param_count > 0 && mysql_stmt_bind_param(stmt, &batch->binds[r * batch->param_count])) ||
+        mysql_stmt_execute(stmt)) {
+      batch->failed_row = (long)r;
+      return (void*)Qfalse;
+    }
+    batch->affected_rows += mysql_stmt_affected_rows(stmt);
+    if (batch->insert_id == 0) {
+      batch->insert_id = mysql_stmt_insert_id(stmt);
+    }
+  }
+
+  return (void*)Qtrue;
+}
+
+#ifdef HAVE_CONST_STMT_ATTR_ARRAY_SIZE
+static void *nogvl_stmt_execute_bulk(void *ptr) {
+  mysql2_stmt_batch *batch = ptr;
+  MYSQL_STMT *stmt = batch->stmt_wrapper->stmt;
+  unsigned int array_size = (unsigned int)batch->row_count;
+
+  if (mysql_stmt_attr_set(stmt, STMT_ATTR_ARRAY_SIZE, &array_size) ||
+      mysql_stmt_bind_param(stmt, batch->columns) ||
+      mysql_stmt_execute(stmt)) {
+    return (void*)Qfalse;
+  }
+  batch->affected_rows = mysql_stmt_affected_rows(stmt);
+  batch->insert_id = mysql_stmt_insert_id(stmt);
+
+  return (void*)Qtrue;
+}
+
+/* Turn the converted rows into column-wise binds for MariaDB's bulk protocol.
+ * Fixed size values are packed per column, everything else is passed as an
+ * array of pointers, and NULLs become indicators. Returns 0 when the server
+ * lacks bulk support or a column mixes types, leaving the per-row loop to it.
+ */
+static int batch_prepare_bulk(mysql2_stmt_batch *batch, MYSQL *client) {
+  unsigned long caps = 0, n = batch->param_count, m = batch->row_count, r, j;
+
+  if (m < 2 || m > UINT_MAX || n == 0) return 0;
+  if (mariadb_get_infov(client, MARIADB_CONNECTION_EXTENDED_SERVER_CAPABILITIES, &caps) ||
+      !(caps & (MARIADB_CLIENT_STMT_BULK_OPERATIONS >> 32))) {
+    return 0;
+  }
+
+  batch->columns = xcalloc(n, sizeof(MYSQL_BIND));
+  for (j = 0; j < n; j++) {
+    enum enum_field_types type = MYSQL_TYPE_NULL;
+
+    for (r = 0; r < m; r++) {
+      enum enum_field_types t = batch->binds[r * n + j].buffer_type;
+      if (t == MYSQL_TYPE_NULL) continue;
+      if (t == MYSQL_TYPE_DECIMAL || (type != MYSQL_TYPE_NULL && type != t)) return 0;
+      type = t;
+    }
+    batch->columns[j].buffer_type = type;
+  }
+
+  batch->cells = xcalloc(n * m, sizeof(mysql2_stmt_param));
+  batch->column_lengths = xcalloc(n * m, sizeof(unsigned long));
+  batch->indicators = xcalloc(n * m, sizeof(char));
+
+  for (j = 0; j < n; j++) {
+    MYSQL_BIND *column = &batch->columns[j];
+    void *cells = &batch->cells[j * m];
+
+    column->buffer = cells;
+    column->length = &batch->column_lengths[j * m];
+    column->u.indicator = &batch->indicators[j * m];
+
+    for (r = 0; r < m; r++) {
+      MYSQL_BIND *bind = &batch->binds[r * n + j];
+
+      if (bind->buffer_type == MYSQL_TYPE_NULL) {
+        column->u.indicator[r] = STMT_INDICATOR_NULL;
+        continue;
+      }
+      switch (column->buffer_type) {
+        case MYSQL_TYPE_TINY:
+          ((signed char*)cells)[r] = *(signed char*)bind->buffer;
+          break;
+        case MYSQL_TYPE_LONG:
+          ((int*)cells)[r] = *(int*)bind->buffer;
+          break;
+        case MYSQL_TYPE_LONGLONG:
+          ((long long*)cells)[r] = *(long long*)bind->buffer;
+          break;
+        case MYSQL_TYPE_DOUBLE:
+          ((double*)cells)[r] = *(double*)bind->buffer;
+          break;
+        default:
+          ((void**)cells)[r] = bind->buffer;
+          column->length[r] = *bind->length;
+          break;
+      }
+    }
+  }
+
+  return 1;
+}
+#endif
+
+static VALUE batch_run(VALUE ptr) {
+  mysql2_stmt_batch *batch = (mysql2_stmt_batch *)ptr;
+  mysql_stmt_wrapper *stmt_wrapper = batch->stmt_wrapper;
+  unsigned long n = batch->param_count, r, j;
+  void *(*execute)(void *) = nogvl_stmt_execute_batch;
+
+  for (r = 0; r < batch->row_count; r++) {
+    VALUE row = rb_ary_entry(batch->rows, r);
+
+    Check_Type(row, T_ARRAY);
+    if (RARRAY_LEN(row) != (long)n) {
+      rb_raise(cMysql2Error, "Bind parameter count (%ld) doesn't match number of arguments (%ld) in row %ld", n, RARRAY_LEN(row), r);
+    }
+
+    for (j = 0; j < n; j++) {
+      unsigned long k = r * n + j;
+      MYSQL_BIND *bind = &batch->binds[k];
+      VALUE string;
+
+      bind->buffer_type = convert_param(rb_ary_entry(row, j), batch->conn_enc, &batch->values[k], &string);
+      bind->length = &batch->lengths[k];
+      if (!NIL_P(string)) {
+        rb_ary_push(batch->strings, string);
+        bind->buffer = RSTRING_PTR(string);
+        bind->buffer_length = batch->lengths[k] = RSTRING_LEN(string);
+      } else if (bind->buffer_type != MYSQL_TYPE_NULL && bind->buffer_type != MYSQL_TYPE_DECIMAL) {
+        bind->buffer = &batch->values[k];
+      }
+    }
+  }
+
+#ifdef HAVE_CONST_STMT_ATTR_ARRAY_SIZE
+  {
+    GET_CLIENT(stmt_wrapper->client);
+    if (batch_prepare_bulk(batch, wrapper->client)) {
+      batch->bulk = 1;
+      execute = nogvl_stmt_execute_bulk;
+    }
+  }
+#endif
+
+  // libmysql's copy of the binds is about to point at batch memory
+  stmt_wrapper->params_bound = 0;
+
+  if ((VALUE)rb_thread_call_without_gvl(execute, batch, RUBY_UBF_IO, 0) == Qfalse) {
+    VALUE e = mysql2_stmt_error(stmt_wrapper);
+
+    /* the rows before the failing one have already been executed */
+    rb_ivar_set(e, intern_at_batch_row, batch->failed_row < 0 ? Qnil : LONG2NUM(batch->failed_row));
+    rb_ivar_set(e, intern_at_batch_affected_rows, ULL2NUM(batch->affected_rows));
+    rb_exc_raise(e);
+  }
+
+  return rb_struct_new(cMysql2BatchResult, ULL2NUM(batch->affected_rows), ULL2NUM(batch->insert_id));
+}
+
+static VALUE batch_free(VALUE ptr) {
+  mysql2_stmt_batch *batch = (mysql2_stmt_batch *)ptr;
+
+#ifdef HAVE_CONST_STMT_ATTR_ARRAY_SIZE
+  if (batch->bulk && batch->stmt_wrapper->stmt) {
+    unsigned int array_size = 0;
+    mysql_stmt_attr_set(batch->stmt_wrapper->stmt, STMT_ATTR_ARRAY_SIZE, &array_size);
+  }
+  if (batch->columns) xfree(batch->columns);
+  if (batch->cells) xfree(batch->cells);
+  if (batch->column_lengths) xfree(batch->column_lengths);
+  if (batch->indicators) xfree(batch->indicators);
+#endif
+  xfree(batch->binds);
+  xfree(batch->lengths);
+  xfree(batch->values);
+
+  return Qnil;
+}
+
+/* call-seq: stmt._execute_batch(rows)
+ *
+ * Executes the statement once for each array of parameters in +rows+,
+ * converting them all up front and running every execution in a single
+ * section without the GVL. On MariaDB servers that support it the rows are
+ * sent with the bulk protocol (STMT_ATTR_ARRAY_SIZE) instead of one at a
+ * time. Returns a Mysql2::Statement::BatchResult with the total affected rows
+ * and the first AUTO_INCREMENT value generated.
+ *
+ * If a row fails, the Mysql2::Error raised carries the index of that row in
+ * +batch_row+ (nil for a bulk request, which fails as a whole) and the rows
+ * affected by the ones executed before it in +batch_affected_rows+.
+ */
+static VALUE rb_mysql_stmt_execute_batch(VALUE self, VALUE rows) {
+  mysql2_stmt_batch batch;
+  VALUE result;
+
+  GET_STATEMENT(self);
+  GET_CLIENT(stmt_wrapper->client);
+  Check_Type(rows, T_ARRAY);
+
+  if (mysql_stmt_field_count(stmt_wrapper->stmt) > 0) {
+    rb_raise(cMysql2Error, "execute_batch does not support statements that return rows");
+  }
+
+  memset(&batch, 0, sizeof(batch));
+  batch.stmt_wrapper = stmt_wrapper;
+  batch.rows = rows;
+  batch.strings = rb_ary_new();
+  batch.conn_enc = rb_to_encoding(wrapper->encoding);
+  batch.param_count = mysql_stmt_param_count(stmt_wrapper->stmt);
+  batch.row_count = RARRAY_LEN(rows);
+  batch.failed_row = -1;
+  if (batch.param_count > 0 && batch.row_count > (ULONG_MAX - 1) / batch.param_count) {
+    rb_raise(rb_eArgError, "too many rows for execute_batch (%lu rows of %lu parameters)",
+             batch.row_count, batch.param_count);
+  }
+  batch.binds = xcalloc(batch.row_count * batch.param_count + 1, sizeof(MYSQL_BIND));
+  batch.lengths = xcalloc(batch.row_count * batch.param_count + 1, sizeof(unsigned long));
+  batch.values = xcalloc(batch.row_count * batch.param_count + 1, sizeof(mysql2_stmt_param));
+
+  result = rb_ensure(batch_run, (VALUE)&batch, batch_free, (VALUE)&batch);
+  RB_GC_GUARD(batch.strings);
+  RB_GC_GUARD(rows);
+
+  return result;
+}
+
 /* call-seq: stmt.fields # => array
  *
  * Returns a list of fields that will be returned by this statement.
@@ -569,6 +845,31 @@ static VALUE rb_mysql_stmt_close(VALUE self) {
   return Qnil;
 }
 
+/* call-seq:
+ *    stmt.closed?
+ *
+ * Whether #close has been called on this statement.
+ */
+static VALUE rb_mysql_stmt_closed(VALUE self) {
+  mysql_stmt_wrapper *stmt_wrapper;
+  Data_Get_Struct(self, mysql_stmt_wrapper, stmt_wrapper);
+
+  return (stmt_wrapper->closed || !stmt_wrapper->stmt) ? Qtrue : Qfalse;
+}
+
+/* call-seq:
+ *    stmt.streaming?
+ *
+ * Whether the result of the last #execute is streaming and still has rows
+ * to read. Executing the statement again would cut it short.
+ */
+static VALUE rb_mysql_stmt_streaming(VALUE self) {
+  mysql_stmt_wrapper *stmt_wrapper;
+  Data_Get_Struct(self, mysql_stmt_wrapper, stmt_wrapper);
+
+  return stmt_wrapper->streaming_result ? Qtrue : Qfalse;
+}
+
 void init_mysql2_statement() {
   cDate = rb_const_get(rb_cObject, rb_intern("Date"));
   cDateTime = rb_const_get(rb_cObject, rb_intern("DateTime"));
@@ -578,14 +879,23 @@ void init_mysql2_statement() {
   rb_define_method(cMysql2Statement, "param_count", rb_mysql_stmt_param_count, 0);
   rb_define_method(cMysql2Statement, "field_count", rb_mysql_stmt_field_count, 0);
   rb_define_method(cMysql2Statement, "_execute", rb_mysql_stmt_execute, -1);
+  rb_define_private_method(cMysql2Statement, "_execute_batch", rb_mysql_stmt_execute_batch, 1);
   rb_define_method(cMysql2Statement, "fields", rb_mysql_stmt_fields, 0);
   rb_define_method(cMysql2Statement, "last_id", rb_mysql_stmt_last_id, 0);
   rb_define_method(cMysql2Statement, "affected_rows", rb_mysql_stmt_affected_rows, 0);
   rb_define_method(cMysql2Statement, "close", rb_mysql_stmt_close, 0);
+  rb_define_method(cMysql2Statement, "closed?", rb_mysql_stmt_closed, 0);
+  rb_define_method(cMysql2Statement, "streaming?", rb_mysql_stmt_streaming, 0);
+
+  /* Outcome of Statement#execute_batch */
+  cMysql2BatchResult = rb_struct_define_under(cMysql2Statement, "BatchResult", "affected_rows", "last_id", NULL);
+  rb_global_variable(&cMysql2BatchResult);
 
   sym_stream = ID2SYM(rb_intern("stream"));
 
   intern_new_with_args = rb_intern("new_with_args");
+  intern_at_batch_row = rb_intern("@batch_row");
+  intern_at_batch_affected_rows = rb_intern("@batch_affected_rows");
   intern_each = rb_intern("each");
 
   intern_sec_fraction = rb_intern("sec_fraction");
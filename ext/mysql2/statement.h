@@ -1,11 +1,28 @@
 #ifndef MYSQL2_STATEMENT_H
 #define MYSQL2_STATEMENT_H
 
+/* storage for a scalar bind parameter, strings point into Ruby memory */
+typedef union {
+  long long ll;
+  int i;
+  double d;
+  signed char tiny;
+  MYSQL_TIME t;
+} mysql2_stmt_param;
+
 typedef struct {
   VALUE client;
   MYSQL_STMT *stmt;
   int refcount;
   int closed;
+  /* bind area reused by every #execute, see rb_mysql_stmt_execute */
+  unsigned long param_count;
+  MYSQL_BIND *param_binds;
+  unsigned long *param_lengths;
+  mysql2_stmt_param *param_values;
+  int params_bound; /* libmysql's copy of param_binds is current */
+  /* result wrapper of the last #execute while it is still streaming rows */
+  void *streaming_result;
 } mysql_stmt_wrapper;
 
 void init_mysql2_statement(void);
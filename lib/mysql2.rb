@@ -32,9 +32,12 @@ require 'mysql2/version' unless defined? Mysql2::VERSION
 require 'mysql2/error'
 require 'mysql2/mysql2'
 require 'mysql2/result'
+require 'mysql2/row'
 require 'mysql2/client'
 require 'mysql2/field'
 require 'mysql2/statement'
+require 'mysql2/statement_cache'
+require 'mysql2/pool'
 
 # = Mysql2
 #
@@ -31,10 +31,10 @@ module Mysql2
       opts[:connect_timeout] = 120 unless opts.key?(:connect_timeout)
 
       # TODO: stricter validation rather than silent massaging
-      %i[reconnect connect_timeout local_infile read_timeout write_timeout default_file default_group secure_auth init_command automatic_close enable_cleartext_plugin].each do |key|
+      %i[reconnect connect_timeout local_infile local_infile_mmap read_timeout write_timeout default_file default_group secure_auth init_command automatic_close enable_cleartext_plugin].each do |key|
         next unless opts.key?(key)
         case key
-        when :reconnect, :local_infile, :secure_auth, :automatic_close, :enable_cleartext_plugin
+        when :reconnect, :local_infile, :local_infile_mmap, :secure_auth, :automatic_close, :enable_cleartext_plugin
           send(:"#{key}=", !!opts[key]) # rubocop:disable Style/DoubleNegation
         when :connect_timeout, :read_timeout, :write_timeout
           send(:"#{key}=", Integer(opts[key])) unless opts[key].nil?
@@ -43,6 +43,12 @@ module Mysql2
         end
       end
 
+      cache_size = opts[:statement_cache_size].to_i
+      @statement_cache = StatementCache.new(cache_size) if cache_size > 0
+      @statement_cache_thread_id = nil
+      @server_max_allowed_packet = nil
+      @query_templates = {}
+
       # force the encoding to utf8
       self.charset_name = opts[:encoding] || 'utf8'
 
@@ -132,6 +138,180 @@ module Mysql2
       end
     end
 
+    QUERY_TEMPLATE_CACHE_SIZE = 256
+
+    # Run +sql+ with each ? placeholder replaced by the matching value as an
+    # escaped SQL literal, without a server-side prepared statement. The
+    # placeholders are found once per distinct +sql+. Values may be nil,
+    # booleans, numbers, Strings, Symbols, Time, Date, DateTime, BigDecimal,
+    # or an Array of those for IN (?). A trailing Hash is taken as the query
+    # options.
+    def query_with_binds(sql, *values)
+      options = values.last.is_a?(Hash) ? values.pop : {}
+      template = @query_templates[sql]
+      unless template
+        @query_templates.clear if @query_templates.size >= QUERY_TEMPLATE_CACHE_SIZE
+        template = @query_templates[sql.frozen? ? sql : sql.dup.freeze] = _query_template(sql)
+      end
+
+      Thread.handle_interrupt(::Mysql2::Util::TIMEOUT_ERROR_CLASS => :never) do
+        _query_with_binds(template, values, @query_options.merge(options))
+      end
+    end
+
+    # Prepare +sql+ as a Mysql2::Statement. With the :statement_cache_size
+    # option, the statement is cached and returned again for the same SQL
+    # text, so it must not be used by two callers at once.
+    def prepare(sql)
+      return _prepare(sql) unless @statement_cache
+
+      # statement handles do not survive a reconnect
+      if @statement_cache_thread_id != thread_id
+        @statement_cache.clear
+        @statement_cache_thread_id = thread_id
+      end
+      key = [encoding, sql.frozen? ? sql : sql.dup.freeze]
+      @statement_cache.fetch(key) { _prepare(sql) }
+    end
+
+    # Hit, miss and eviction counters of the statement cache, or nil when it
+    # is disabled.
+    def statement_cache_stats
+      @statement_cache && @statement_cache.stats
+    end
+
+    # Collects the queries of a Client#pipeline block.
+    class Pipeline
+      attr_reader :queries
+
+      def initialize
+        @queries = []
+      end
+
+      def query(sql, options = {})
+        @queries << [sql, options]
+        nil
+      end
+    end
+
+    # Send every query added in the block in one packet, then read their
+    # results back in order. Returns an Array with a Mysql2::Result (or nil)
+    # per query. Each query must be a single statement.
+    #
+    # Unless multiple statements are already enabled (see
+    # #multi_statements?), they are switched on and back off around the
+    # call, which adds two round trips.
+    def pipeline(options = {})
+      pipe = Pipeline.new
+      yield pipe
+      return [] if pipe.queries.empty?
+
+      sql = pipe.queries.map { |query, _| query.sub(/[\s;]+\z/, '') }.join("\n;")
+      query_options = pipe.queries.map do |_, opts|
+        opts = @query_options.merge(options).merge(opts)
+        raise ArgumentError, ":stream is not supported in a pipeline" if opts[:stream]
+        opts.merge(async: false)
+      end
+
+      Thread.handle_interrupt(::Mysql2::Util::TIMEOUT_ERROR_CLASS => :never) do
+        with_multi_statements { _pipeline(sql, query_options) }
+      end
+    end
+
+    # Run +sql+, which may hold several statements, and read every result
+    # set it produces. Returns a Mysql2::Client::QueryResult per statement,
+    # with its result (nil for statements that return no rows), affected_rows
+    # and last_id. The first statement that fails raises its Mysql2::Error.
+    def query_multi(sql, options = {})
+      options = @query_options.merge(options)
+      raise ArgumentError, ":stream is not supported by query_multi" if options[:stream]
+
+      Thread.handle_interrupt(::Mysql2::Util::TIMEOUT_ERROR_CLASS => :never) do
+        with_multi_statements { _query_multi(sql, options.merge(async: false)) }
+      end
+    end
+
+    # Insert +rows+ (an Array of value Arrays, in +columns+ order) into
+    # +table+ with as few multi-row INSERT statements as fit under the
+    # :max_packet option, which defaults to the server's max_allowed_packet.
+    # Returns the total number of affected rows.
+    def insert_rows(table, columns, rows, options = {})
+      return 0 if rows.empty?
+
+      max_packet = options[:max_packet] || server_max_allowed_packet
+      identifiers = columns.map { |column| quote_identifier(column) }.join(', ')
+      prefix = "INSERT INTO #{table.to_s.split('.').map { |part| quote_identifier(part) }.join('.')} (#{identifiers}) VALUES "
+
+      affected = 0
+      _each_insert(prefix, columns.size, rows, max_packet) do |sql|
+        query(sql, async: false)
+        affected += affected_rows
+      end
+      affected
+    end
+
+    # Run +sql+ as a streaming query and convert its rows with
+    # Result#to_arrow, without caching them in Ruby. Returns what to_arrow
+    # returns, or nil if the statement produced no result set.
+    def query_arrow(sql, io = nil, options = {})
+      if io.is_a?(Hash)
+        options = io
+        io = nil
+      end
+      result = query(sql, options.merge(stream: true, cache_rows: false))
+      result && result.to_arrow(io, options)
+    end
+
+    LOAD_DATA_FORMATS = {
+      tsv: { fields_terminated_by: "\t", enclosed_by: '', escaped_by: '\\', lines_terminated_by: "\n" },
+      csv: { fields_terminated_by: ',', enclosed_by: '"', escaped_by: '', lines_terminated_by: "\n" },
+    }.freeze
+
+    # Bulk load +source+ into the :table option with LOAD DATA LOCAL INFILE,
+    # without a file on disk. +source+ is an IO (anything with #read) or an
+    # Enumerable of String chunks. The connection needs local_infile: true.
+    # Returns the number of affected rows.
+    def load_data(source, options = {})
+      table = options.fetch(:table) { raise ArgumentError, "load_data needs a :table" }
+      format = LOAD_DATA_FORMATS.fetch(options.fetch(:format, :tsv)) do
+        raise ArgumentError, "unknown load_data :format #{options[:format].inspect}"
+      end
+      format = format.merge(options.select { |key, _| format.key?(key) })
+      if options[:character_set] && options[:character_set].to_s !~ /\A\w+\z/
+        raise ArgumentError, "invalid load_data :character_set #{options[:character_set].inspect}"
+      end
+
+      sql = "LOAD DATA LOCAL INFILE 'mysql2-stream'"
+      sql << " #{options[:on_duplicate].to_s.upcase}" if %i[replace ignore].include?(options[:on_duplicate])
+      sql << " INTO TABLE #{table.to_s.split('.').map { |part| quote_identifier(part) }.join('.')}"
+      sql << " CHARACTER SET #{options[:character_set]}" if options[:character_set]
+      sql << " FIELDS TERMINATED BY '#{escape(format[:fields_terminated_by])}'"
+      sql << " OPTIONALLY ENCLOSED BY '#{escape(format[:enclosed_by])}'" unless format[:enclosed_by].empty?
+      sql << " ESCAPED BY '#{escape(format[:escaped_by])}'"
+      sql << " LINES TERMINATED BY '#{escape(format[:lines_terminated_by])}'"
+      sql << " IGNORE #{Integer(options[:ignore_lines])} LINES" if options[:ignore_lines]
+      sql << " (#{options[:columns].map { |column| quote_identifier(column) }.join(', ')})" if options[:columns]
+
+      if source.respond_to?(:read)
+        chunk_size = options.fetch(:chunk_size, 64 * 1024)
+        reader = -> { source.read(chunk_size) }
+      else
+        chunks = source.each_entry
+        reader = lambda do
+          begin
+            chunks.next
+          rescue StopIteration
+            nil
+          end
+        end
+      end
+
+      Thread.handle_interrupt(::Mysql2::Util::TIMEOUT_ERROR_CLASS => :never) do
+        _load_data(sql, reader, @query_options.merge(async: false))
+      end
+      affected_rows
+    end
+
     def query_info
       info = query_info_string
       return {} unless info
@@ -144,6 +324,30 @@ module Mysql2
       self.class.info
     end
 
+    private
+
+    def quote_identifier(name)
+      "`#{name.to_s.gsub('`', '``')}`"
+    end
+
+    def server_max_allowed_packet
+      @server_max_allowed_packet ||= query('SELECT @@max_allowed_packet', as: :array, async: false).first.first
+    end
+
+    # Runs the block with multiple statements enabled, leaving the connection
+    # in whatever state it was in before (connect flag or set_server_option).
+    # Each set_server_option call is a round trip of its own.
+    def with_multi_statements
+      return yield if multi_statements?
+
+      set_server_option(OPTION_MULTI_STATEMENTS_ON)
+      begin
+        yield
+      ensure
+        set_server_option(OPTION_MULTI_STATEMENTS_OFF) unless closed?
+      end
+    end
+
     class << self
       private
 
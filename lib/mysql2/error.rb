@@ -45,6 +45,11 @@ module Mysql2
 
     attr_reader :error_number, :sql_state
 
+    # Set when Statement#execute_batch fails to execute a row: the index of
+    # that row (nil when the whole bulk request failed), and the rows affected
+    # by the ones that ran before it.
+    attr_reader :batch_row, :batch_affected_rows
+
     # Mysql gem compatibility
     alias errno error_number
     alias error message
@@ -0,0 +1,52 @@
+module Mysql2
+  class Pool
+    TimeoutError = Class.new(Mysql2::Error)
+
+    attr_reader :client_options, :checkout_timeout
+
+    # Accepts the Mysql2::Client options, plus:
+    #
+    # * +size+: number of connections, all opened up front (default 5)
+    # * +checkout_timeout+: seconds #checkout waits for a free connection
+    #   before raising Mysql2::Pool::TimeoutError, nil to wait forever (default 5)
+    # * +health_check_interval+: ping connections that sat idle for at least
+    #   this many seconds before handing them out, nil to never ping (default 30)
+    def initialize(opts = {})
+      raise Mysql2::Error, "Options parameter must be a Hash" unless opts.is_a? Hash
+      opts = Mysql2::Util.key_hash_as_symbols(opts)
+      size = Integer(opts.delete(:size) || 5)
+      @checkout_timeout = opts.key?(:checkout_timeout) ? opts.delete(:checkout_timeout) : 5
+      health_check_interval = opts.key?(:health_check_interval) ? opts.delete(:health_check_interval) : 30
+      @client_options = opts.freeze
+
+      initialize_ext(size, health_check_interval)
+      begin
+        size.times { add_client(new_client) }
+      rescue StandardError
+        # don't leave the connections opened so far to the garbage collector
+        close
+        raise
+      end
+    end
+
+    def checkout(timeout = @checkout_timeout)
+      _checkout(timeout)
+    end
+
+    # Check out a connection for the duration of the block.
+    def with(timeout = @checkout_timeout)
+      client = checkout(timeout)
+      begin
+        yield client
+      ensure
+        checkin(client)
+      end
+    end
+
+    private
+
+    def new_client
+      Mysql2::Client.new(@client_options)
+    end
+  end
+end
@@ -3,5 +3,85 @@ module Mysql2
     attr_reader :server_flags
 
     include Enumerable
+
+    # Yields the rows in Arrays of up to +batch_size+ rows, like each_slice.
+    # For streaming results the rows are also fetched from the server
+    # +batch_size+ at a time (see the :batch_size option of #each).
+    def each_batch(options = {})
+      return enum_for(:each_batch, options) unless block_given?
+
+      batch_size = options.fetch(:batch_size) { @query_options.fetch(:batch_size, nil) || 1000 }
+      raise ArgumentError, ":batch_size must be a positive Integer" unless batch_size.is_a?(Integer) && batch_size > 0
+
+      batch = []
+      each(options.merge(batch_size: batch_size)) do |row|
+        batch << row
+        next if batch.size < batch_size
+
+        yield batch
+        batch = []
+      end
+      yield batch unless batch.empty?
+      self
+    end
+
+    # Yields each row as one binary String holding the undecoded cells, in
+    # the MySQL text protocol's row encoding: a length-encoded integer then
+    # that many bytes per cell, or "\xFB" for NULL. With an +io+, the rows
+    # are instead written to it with #write in large chunks, and the number
+    # of rows written is returned. Rows are not cached unless :cache_rows
+    # is passed.
+    def each_raw_row(io = nil, options = {}, &block)
+      return _write_raw_rows(io) if io
+      return enum_for(:each_raw_row, nil, options) unless block
+
+      each({ cache_rows: false }.merge(options).merge(as: :raw), &block)
+    end
+
+    # Write the rows to +io+ as CSV, formatted in C straight from the
+    # undecoded cells, and return the number of rows written. Options:
+    #
+    # :col_sep - field separator, a single byte (default ",")
+    # :quote - quote character (default '"'), or nil to backslash escape
+    #          separators, line breaks and backslashes as LOAD DATA expects
+    # :null - text for NULL (default "", or "\\N" when :quote is nil)
+    # :row_sep - line terminator (default "\n")
+    # :headers - write the field names first (default false)
+    #
+    # Cells are written in the connection encoding, as the server sent
+    # them. A streaming result is consumed like #each would.
+    def write_csv(io, options = {})
+      quote = options.fetch(:quote, '"')
+      _write_csv(
+        io,
+        options.fetch(:col_sep, ','),
+        quote,
+        options.fetch(:null) { quote ? '' : '\N' },
+        options.fetch(:row_sep, "\n"),
+        options.fetch(:headers, false),
+      )
+    end
+
+    # Convert the rows to an Arrow IPC stream, column by column in C, and
+    # write it to +io+ (returning the number of rows), or return it as a
+    # binary String. Integers become int64 (uint64 for BIGINT UNSIGNED),
+    # floats float64, DATETIME and TIMESTAMP timestamp[us] without a time
+    # zone, DATE date32, binary strings binary and everything else utf8
+    # (binary too when the connection encoding isn't UTF-8). Values that
+    # don't fit, like zero dates, are NULL. Rows are grouped into record
+    # batches of up to the :batch_size option (default 65536).
+    def to_arrow(io = nil, options = {})
+      if io.is_a?(Hash)
+        options = io
+        io = nil
+      end
+      batch_size = options.fetch(:batch_size, 65_536)
+      return _write_arrow(io, batch_size) if io
+
+      require 'stringio'
+      io = StringIO.new(''.b)
+      _write_arrow(io, batch_size)
+      io.string
+    end
   end
 end
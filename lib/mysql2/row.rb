@@ -0,0 +1,37 @@
+module Mysql2
+  # Returned by Result#each when iterating with <tt>as: :lazy</tt>. Values are
+  # only cast when they're read, then remembered.
+  class Row
+    include Enumerable
+
+    def each(&block)
+      return enum_for(:each) { size } unless block_given?
+      to_h.each(&block)
+      self
+    end
+
+    def fetch(key, *default)
+      return self[key] if key?(key)
+      return yield(key) if block_given?
+      return default.first unless default.empty?
+      raise KeyError, "key not found: #{key.inspect}"
+    end
+
+    def values
+      to_h.values
+    end
+
+    alias has_key? key?
+    alias include? key?
+    alias length size
+
+    def ==(other)
+      other = other.to_h if other.is_a?(Row)
+      to_h == other
+    end
+
+    def inspect
+      "#<#{self.class.name} #{to_h.inspect}>"
+    end
+  end
+end
@@ -7,5 +7,11 @@ module Mysql2
         _execute(*args, **kwargs)
       end
     end
+
+    def execute_batch(rows)
+      Thread.handle_interrupt(::Mysql2::Util::TIMEOUT_ERROR_CLASS => :never) do
+        _execute_batch(rows)
+      end
+    end
   end
 end
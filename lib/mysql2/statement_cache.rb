@@ -0,0 +1,61 @@
+module Mysql2
+  # Least recently used cache of prepared statements behind Client#prepare,
+  # enabled with the :statement_cache_size client option.
+  class StatementCache
+    attr_reader :capacity, :hits, :misses, :evictions
+
+    def initialize(capacity)
+      @capacity = capacity
+      @statements = {}
+      @hits = 0
+      @misses = 0
+      @evictions = 0
+    end
+
+    # Returns the cached statement for +key+, or caches the one the block
+    # prepares. Statements closed by their user are prepared again. While
+    # the cached statement is still streaming a result, executing it again
+    # would cut that result short, so the block's statement is returned
+    # without caching it.
+    def fetch(key)
+      stmt = @statements.delete(key)
+      if stmt && !stmt.closed?
+        @statements[key] = stmt
+        if stmt.streaming?
+          @misses += 1
+          return yield
+        end
+        @hits += 1
+        return stmt
+      end
+
+      @misses += 1
+      stmt = yield
+      @statements[key] = stmt
+      evict while @statements.size > @capacity
+      stmt
+    end
+
+    def size
+      @statements.size
+    end
+
+    # Close and forget every cached statement.
+    def clear
+      @statements.each_value { |stmt| stmt.close unless stmt.closed? }
+      @statements.clear
+    end
+
+    def stats
+      { size: size, capacity: @capacity, hits: @hits, misses: @misses, evictions: @evictions }
+    end
+
+    private
+
+    def evict
+      _, stmt = @statements.shift
+      stmt.close unless stmt.closed?
+      @evictions += 1
+    end
+  end
+end
@@ -1,4 +1,5 @@
 require 'spec_helper'
+require 'stringio'
 
 RSpec.describe Mysql2::Client do
   context "using defaults file" do
@@ -452,6 +453,86 @@ RSpec.describe Mysql2::Client do
       result = client.query "SELECT * FROM infileTest"
       expect(result.first).to eql('id' => 1, 'foo' => 'Hello', 'bar' => 'World')
     end
+
+    it "should report the counters of the last load" do
+      client = new_client(local_infile: true)
+      expect(client.infile_stats).to be_nil
+
+      client.query "LOAD DATA LOCAL INFILE 'spec/test_data' INTO TABLE infileTest"
+      stats = client.infile_stats
+      expect(stats[:source]).to eql(:read)
+      expect(stats[:bytes]).to eql(File.size('spec/test_data'))
+      expect(stats[:reads]).to be >= 1
+      expect(stats[:seconds]).to be >= 0
+      client.query "DELETE FROM infileTest WHERE id > 1"
+    end
+
+    it "should only map the file with local_infile_mmap" do
+      client = new_client(local_infile: true, local_infile_mmap: true)
+      client.query "LOAD DATA LOCAL INFILE 'spec/test_data' INTO TABLE infileTest"
+      stats = client.infile_stats
+      expect(%i[mmap read]).to include(stats[:source])
+      expect(stats[:bytes]).to eql(File.size('spec/test_data'))
+      client.query "DELETE FROM infileTest WHERE id > 1"
+    end
+
+    context "#load_data" do
+      before(:each) do
+        @infile_client = new_client(local_infile: true)
+        @infile_client.query "TRUNCATE infileTest"
+      end
+
+      after(:each) do
+        @infile_client.query "TRUNCATE infileTest"
+      end
+
+      def loaded_rows
+        @infile_client.query("SELECT foo, bar FROM infileTest ORDER BY id", as: :array).to_a
+      end
+
+      it "should load rows from an IO" do
+        io = StringIO.new("a\tone\nb\ttwo\n")
+        expect(@infile_client.load_data(io, table: 'infileTest', columns: %w[foo bar])).to eql(2)
+        expect(loaded_rows).to eql([%w[a one], %w[b two]])
+        expect(@infile_client.infile_stats).to include(source: :ruby, bytes: io.string.bytesize)
+      end
+
+      it "should load rows from an Enumerable of chunks split anywhere" do
+        chunks = ["foo,bar\n", "\"x,1\",y\n\"z", "\",\"\"\"\n"]
+        @infile_client.load_data(chunks, table: :infileTest, columns: %i[foo bar], format: :csv, ignore_lines: 1)
+        expect(loaded_rows).to eql([['x,1', 'y'], ['z', '"']])
+      end
+
+      it "should stream more data than the staging buffer holds" do
+        lines = Enumerator.new do |y|
+          20_000.times { |i| y << "row#{i}\t#{'x' * 40}\n" }
+        end
+        expect(@infile_client.load_data(lines, table: 'infileTest', columns: %w[foo bar])).to eql(20_000)
+        expect(@infile_client.query("SELECT COUNT(*) AS c FROM infileTest").first['c']).to eql(20_000)
+      end
+
+      it "should re-raise an exception from the source and leave the connection usable" do
+        chunks = Enumerator.new do |y|
+          y << "a\tone\n"
+          raise ArgumentError, "broken source"
+        end
+        expect do
+          @infile_client.load_data(chunks, table: 'infileTest', columns: %w[foo bar])
+        end.to raise_error(ArgumentError, "broken source")
+        expect(@infile_client.query("SELECT 1 AS a").first).to eql('a' => 1)
+      end
+
+      it "should require a table" do
+        expect { @infile_client.load_data([]) }.to raise_error(ArgumentError)
+      end
+
+      it "should reject a character set that is not a plain name" do
+        expect do
+          @infile_client.load_data([], table: 'infileTest', character_set: "utf8mb4 FIELDS TERMINATED BY ','")
+        end.to raise_error(ArgumentError)
+        expect(@infile_client.load_data(["a\tb\n"], table: 'infileTest', columns: %w[foo bar], character_set: :utf8mb4)).to eql(1)
+      end
+    end
   end
 
   it "should expect connect_timeout to be a positive integer" do
@@ -710,6 +791,39 @@ RSpec.describe Mysql2::Client do
         expect(values).to match_array(threads.map(&:object_id))
       end
 
+      it "queries should yield to a Fiber scheduler while reading a result" do
+        skip "Fiber.set_scheduler requires Ruby 3.0+" unless Fiber.respond_to?(:set_scheduler)
+        skip "mysql2 was built without a non-blocking client API" unless Mysql2::Client::NONBLOCKING
+
+        digits = "(#{(0..9).map { |d| "SELECT #{d} AS d" }.join(' UNION ALL ')})"
+        # about 1MB of rows is on the wire before the server stalls on the
+        # last one, so that fiber waits in the middle of reading its result
+        streaming = "SELECT IF((@n := @n + 1) = 1000, SLEEP(0.5), 0) AS s, REPEAT('x', 1024) AS pad " \
+                    "FROM (SELECT @n := 0) init, #{digits} a, #{digits} b, #{digits} c"
+        finished = []
+
+        thread = Thread.new do
+          Fiber.set_scheduler(MinimalFiberScheduler.new)
+          # connect inside the fibers so the connections are non-blocking
+          Fiber.schedule do
+            client = new_client
+            expect(client.query(streaming).count).to eql(1000)
+            finished << :streaming
+          end
+          Fiber.schedule do
+            client = new_client
+            client.query("SELECT SLEEP(0.1)")
+            finished << :short
+          end
+        end
+
+        Timeout.timeout(5) { thread.join }
+
+        # a blocking read of the streaming result would hold the thread
+        # until its SLEEP(0.5) is over
+        expect(finished).to eql(%i[short streaming])
+      end
+
       it "evented async queries should be supported" do
         # should immediately return nil
         expect(@client.query("SELECT sleep(0.1)", async: true)).to eql(nil)
@@ -798,6 +912,209 @@ RSpec.describe Mysql2::Client do
     end
   end
 
+  context "#pipeline" do
+    it "should return the results of every query in order" do
+      results = @client.pipeline do |p|
+        p.query("SELECT 1 AS a")
+        p.query("SELECT 2 AS b;")
+        p.query("SELECT 3 AS c -- trailing comment")
+      end
+      expect(results.map(&:first)).to eql([{ 'a' => 1 }, { 'b' => 2 }, { 'c' => 3 }])
+    end
+
+    it "should apply per query options" do
+      results = @client.pipeline(symbolize_keys: true) do |p|
+        p.query("SELECT 1 AS a")
+        p.query("SELECT 2 AS b", as: :array)
+      end
+      expect(results[0].first).to eql(a: 1)
+      expect(results[1].first).to eql([2])
+    end
+
+    it "should return nil for statements without a result set" do
+      @client.query "CREATE TEMPORARY TABLE pipeline_test (id INT)"
+      results = @client.pipeline do |p|
+        p.query("INSERT INTO pipeline_test VALUES (1), (2)")
+        p.query("SELECT COUNT(*) AS n FROM pipeline_test")
+      end
+      expect(results[0]).to be_nil
+      expect(results[1].first).to eql('n' => 2)
+    end
+
+    it "should raise the error of a failing query and leave the connection usable" do
+      expect do
+        @client.pipeline do |p|
+          p.query("SELECT 1")
+          p.query("SELECT * FROM invalid_table_name")
+          p.query("SELECT 3")
+        end
+      end.to raise_error(Mysql2::Error)
+      expect(@client.query("SELECT 4 AS d").first).to eql('d' => 4)
+    end
+
+    it "should not leave multiple statements enabled" do
+      @client.pipeline { |p| p.query("SELECT 1") }
+      expect(@client.multi_statements?).to be false
+      expect { @client.query("SELECT 1; SELECT 2") }.to raise_error(Mysql2::Error)
+    end
+
+    it "should only toggle multiple statements when they are off" do
+      expect(@client).to receive(:set_server_option).twice.and_call_original
+      @client.pipeline { |p| p.query("SELECT 1") }
+
+      multi_client = new_client(flags: Mysql2::Client::MULTI_STATEMENTS)
+      expect(multi_client).not_to receive(:set_server_option)
+      expect(multi_client.pipeline { |p| p.query("SELECT 1") }.size).to eql(1)
+    end
+
+    it "should keep multiple statements enabled by set_server_option" do
+      @client.set_server_option(Mysql2::Client::OPTION_MULTI_STATEMENTS_ON)
+      expect(@client.multi_statements?).to be true
+      expect(@client).not_to receive(:set_server_option)
+      @client.pipeline { |p| p.query("SELECT 1") }
+      expect(@client.multi_statements?).to be true
+
+      @client.query("SELECT 1; SELECT 2")
+      expect(@client.next_result).to be true
+      expect(@client.store_result.first).to eql('2' => 2)
+      expect(@client.next_result).to be false
+    end
+
+    it "should return an empty Array when no queries were added" do
+      expect(@client.pipeline { |_| nil }).to eql([])
+    end
+  end
+
+  context "#query_multi" do
+    before(:each) do
+      @client.query "CREATE TEMPORARY TABLE query_multi_test (id INT AUTO_INCREMENT PRIMARY KEY, val INT)"
+    end
+
+    it "should return every result set with its affected rows and insert id" do
+      results = @client.query_multi(%(
+        INSERT INTO query_multi_test (val) VALUES (1), (2);
+        UPDATE query_multi_test SET val = val + 1;
+        SELECT val FROM query_multi_test ORDER BY id
+      ))
+      expect(results.size).to eql(3)
+      expect(results.map(&:affected_rows)).to eql([2, 2, 2])
+      expect(results[0].result).to be_nil
+      expect(results[0].last_id).to eql(1)
+      expect(results[2].result.map { |row| row['val'] }).to eql([2, 3])
+    end
+
+    it "should apply the query options to every result" do
+      results = @client.query_multi("SELECT 1 AS a; SELECT 2 AS b", as: :array)
+      expect(results.map { |r| r.result.first }).to eql([[1], [2]])
+    end
+
+    it "should raise the error of a failing statement and leave the connection usable" do
+      expect do
+        @client.query_multi("SELECT 1; SELECT * FROM invalid_table_name; SELECT 3")
+      end.to raise_error(Mysql2::Error)
+      expect(@client.query("SELECT 4 AS d").first).to eql('d' => 4)
+    end
+
+    it "should work on connections opened with MULTI_STATEMENTS" do
+      multi_client = new_client(flags: Mysql2::Client::MULTI_STATEMENTS)
+      expect(multi_client.query_multi("SELECT 1; SELECT 2").size).to eql(2)
+      expect(multi_client.multi_statements?).to be true
+    end
+
+    it "should keep multiple statements enabled by set_server_option" do
+      @client.set_server_option(Mysql2::Client::OPTION_MULTI_STATEMENTS_ON)
+      expect(@client.query_multi("SELECT 1; SELECT 2").size).to eql(2)
+      expect(@client.multi_statements?).to be true
+      expect(@client.query_multi("SELECT 3; SELECT 4").size).to eql(2)
+    end
+
+    it "should not leave multiple statements enabled" do
+      @client.query_multi("SELECT 1; SELECT 2")
+      expect(@client.multi_statements?).to be false
+      expect { @client.query("SELECT 1; SELECT 2") }.to raise_error(Mysql2::Error)
+    end
+  end
+
+  context "#insert_rows" do
+    before(:each) do
+      @client.query "CREATE TEMPORARY TABLE insert_rows_test (id INT AUTO_INCREMENT PRIMARY KEY, `na``me` VARCHAR(255), n BIGINT, f DOUBLE, d DECIMAL(10,2), t DATETIME(6), b TINYINT)"
+    end
+
+    it "should insert every row and return the affected row count" do
+      rows = [
+        ["it's \\ \"quoted\"", 1, 1.5, BigDecimal("12.34"), Time.new(2020, 1, 2, 3, 4, 5.5), true],
+        [nil, 2**62, -0.25, nil, nil, false],
+      ]
+      columns = ['na`me', :n, :f, :d, :t, :b]
+      expect(@client.insert_rows(:insert_rows_test, columns, rows)).to eql(2)
+
+      result = @client.query("SELECT `na``me`, n, f, d, t, b FROM insert_rows_test ORDER BY id", as: :array).to_a
+      expect(result[0][0..3]).to eql(["it's \\ \"quoted\"", 1, 1.5, BigDecimal("12.34")])
+      expect(result[0][4].usec).to eql(500000)
+      expect(result[0][5]).to eql(1)
+      expect(result[1]).to eql([nil, 2**62, -0.25, nil, nil, 0])
+    end
+
+    it "should split the rows across statements to stay under max_packet" do
+      statements = 0
+      allow(@client).to receive(:query).and_wrap_original do |method, sql, *args|
+        statements += 1 if sql.start_with?('INSERT')
+        expect(sql.bytesize).to be < 200
+        method.call(sql, *args)
+      end
+
+      rows = Array.new(50) { |i| ["row #{i}"] }
+      expect(@client.insert_rows('insert_rows_test', ['na`me'], rows, max_packet: 200)).to eql(50)
+      expect(statements).to be > 1
+      expect(@client.query("SELECT COUNT(*) AS c FROM insert_rows_test").first['c']).to eql(50)
+    end
+
+    it "should raise when a single row does not fit in max_packet" do
+      expect do
+        @client.insert_rows('insert_rows_test', ['na`me'], [['x' * 300]], max_packet: 200)
+      end.to raise_error(Mysql2::Error, /does not fit/)
+    end
+
+    it "should raise on rows of the wrong size and unsupported values" do
+      expect { @client.insert_rows('insert_rows_test', [:n, :f], [[1]]) }.to raise_error(ArgumentError)
+      expect { @client.insert_rows('insert_rows_test', [:n], [[Object.new]]) }.to raise_error(TypeError)
+    end
+  end
+
+  context "#query_with_binds" do
+    it "should interpolate escaped values for each placeholder" do
+      result = @client.query_with_binds("SELECT ? AS s, ? AS n, ? AS z, ? AS b", "it's \"quoted\"", 42, nil, true).first
+      expect(result).to eql('s' => "it's \"quoted\"", 'n' => 42, 'z' => nil, 'b' => 1)
+    end
+
+    it "should interpolate non-ASCII values between non-ASCII fragments" do
+      result = @client.query_with_binds("SELECT ? AS `\u00fc`, ? AS `\u00e9t\u00e9`", "\u00e9", "caf\u00e9's").first
+      expect(result).to eql("\u00fc" => "\u00e9", "\u00e9t\u00e9" => "caf\u00e9's")
+    end
+
+    it "should leave question marks in literals, identifiers and comments alone" do
+      sql = "SELECT '?' AS `a?`, \"it\\'s?\" AS b, ? AS c /* ? */ -- ?\n# ?\n"
+      expect(@client.query_with_binds(sql, 'x').first).to eql('a?' => '?', 'b' => "it's?", 'c' => 'x')
+    end
+
+    it "should expand Arrays into lists and take trailing query options" do
+      result = @client.query_with_binds("SELECT 2 IN (?) AS hit, 5 IN (?) AS miss", [1, 2, 3], [4], as: :array).first
+      expect(result).to eql([1, 0])
+    end
+
+    it "should reuse templates across calls" do
+      sql = "SELECT ? AS v"
+      expect(@client.query_with_binds(sql, 1).first['v']).to eql(1)
+      expect(@client.query_with_binds(sql, 'two').first['v']).to eql('two')
+    end
+
+    it "should raise on the wrong number of values and unsupported values" do
+      expect { @client.query_with_binds("SELECT ?, ?", 1) }.to raise_error(ArgumentError)
+      expect { @client.query_with_binds("SELECT ?", Object.new) }.to raise_error(TypeError)
+      expect { @client.query_with_binds("SELECT ?", []) }.to raise_error(ArgumentError)
+    end
+  end
+
   it "should respond to #socket" do
     expect(@client).to respond_to(:socket)
   end
@@ -861,6 +1178,23 @@ RSpec.describe Mysql2::Client do
       expect(@client.escape(str).object_id).to eql(str.object_id)
     end
 
+    it "should escape every special character across long strings" do
+      special = "\0\n\r\\'\"\x1a"
+      str = (("x" * 37) + special) * 100
+      expected = (("x" * 37) + "\\0\\n\\r\\\\\\'\\\"\\Z") * 100
+      expect(@client.escape(str)).to eql(expected)
+      expect(Mysql2::Client.escape(str)).to eql(expected)
+      expect(@client.escape("x" * 1000 + "'")).to eql("x" * 1000 + "\\'")
+    end
+
+    it "should agree with a byte-by-byte escape at every alignment" do
+      map = { "\0" => "\\0", "\n" => "\\n", "\r" => "\\r", "\\" => "\\\\", "'" => "\\'", '"' => '\\"', "\x1a" => "\\Z" }
+      (0..70).each do |offset|
+        str = ("a" * offset) + "'" + ("b" * (70 - offset)) + "\n"
+        expect(Mysql2::Client.escape(str)).to eql(str.gsub(/[\0\n\r\\'"\x1a]/, map))
+      end
+    end
+
     it "should not overflow the thread stack" do
       expect do
         Thread.new { @client.escape("'" * 256 * 1024) }.join
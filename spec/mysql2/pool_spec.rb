@@ -0,0 +1,140 @@
+require 'spec_helper'
+
+RSpec.describe Mysql2::Pool do
+  let(:pool) { Mysql2::Pool.new(DatabaseCredentials['root'].merge(size: 2, checkout_timeout: 0.2)) }
+
+  after(:each) do
+    pool.close
+  end
+
+  it "should open every connection up front" do
+    expect(pool.size).to eql(2)
+    expect(pool.available).to eql(2)
+  end
+
+  it "should close the connections it opened when one fails to connect" do
+    opened = []
+    attempts = 0
+    allow(Mysql2::Client).to receive(:new).and_wrap_original do |original, *args|
+      attempts += 1
+      raise Mysql2::Error, "connect failed" if attempts == 2
+      original.call(*args).tap { |client| opened << client }
+    end
+
+    expect { Mysql2::Pool.new(DatabaseCredentials['root'].merge(size: 3)) }.to raise_error(Mysql2::Error, "connect failed")
+    expect(opened.size).to eql(1)
+    expect(opened).to all(be_closed)
+  end
+
+  it "should hand out and take back clients" do
+    client = pool.checkout
+    expect(client).to be_an_instance_of(Mysql2::Client)
+    expect(pool.available).to eql(1)
+    pool.checkin(client)
+    expect(pool.available).to eql(2)
+  end
+
+  it "should check a client in after #with, even when the block raises" do
+    expect do
+      pool.with { |client| client.query("SELECT * FROM invalid_table_name") }
+    end.to raise_error(Mysql2::Error)
+    expect(pool.available).to eql(2)
+    expect(pool.with { |client| client.query("SELECT 1 AS a").first }).to eql("a" => 1)
+  end
+
+  it "should give a thread back the connection it used last" do
+    held = Queue.new
+    release = Queue.new
+    other = Thread.new do
+      pool.with do |client|
+        held << client.thread_id
+        release.pop
+      end
+    end
+    other_id = held.pop
+    mine = pool.with(&:thread_id)
+    # the other thread's connection is now the most recently checked in
+    release << true
+    other.join
+
+    expect(mine).not_to eql(other_id)
+    expect(pool.with(&:thread_id)).to eql(mine)
+    expect(pool.stats[:affinity_hits]).to eql(1)
+  end
+
+  it "should raise Mysql2::Pool::TimeoutError when every connection stays checked out" do
+    clients = Array.new(2) { pool.checkout }
+    expect { pool.checkout }.to raise_error(Mysql2::Pool::TimeoutError)
+    expect(pool.stats[:timeouts]).to eql(1)
+    clients.each { |client| pool.checkin(client) }
+  end
+
+  it "should wake a waiting thread when a connection is checked in" do
+    clients = Array.new(2) { pool.checkout }
+    waiter = Thread.new { pool.with(1) { |client| client.query("SELECT 1 AS a").first['a'] } }
+    sleep 0.05
+    pool.checkin(clients.pop)
+
+    expect(waiter.value).to eql(1)
+    expect(pool.stats[:waits]).to eql(1)
+    expect(pool.stats[:wait_time]).to be > 0
+    pool.checkin(clients.pop)
+  end
+
+  it "should replace connections that were closed" do
+    pool.with(&:close)
+    expect(pool.with { |client| client.query("SELECT 1 AS a").first['a'] }).to eql(1)
+    expect(pool.stats[:reconnects]).to eql(1)
+  end
+
+  it "should let other fibers run while a fiber waits for a connection" do
+    skip "Fiber.set_scheduler requires Ruby 3.0+" unless Fiber.respond_to?(:set_scheduler)
+    single = Mysql2::Pool.new(DatabaseCredentials['root'].merge(size: 1, checkout_timeout: 2))
+    order = []
+
+    thread = Thread.new do
+      Fiber.set_scheduler(MinimalFiberScheduler.new)
+      2.times do |i|
+        Fiber.schedule do
+          single.with do |client|
+            order << [:checkout, i]
+            # hold the connection across a scheduler switch
+            sleep 0.1
+            client.query("SELECT 1")
+            order << [:checkin, i]
+          end
+        end
+      end
+    end
+
+    begin
+      Timeout.timeout(5) { thread.join }
+    ensure
+      single.close
+    end
+    expect(order).to eql([[:checkout, 0], [:checkin, 0], [:checkout, 1], [:checkin, 1]])
+    expect(single.stats[:waits]).to eql(1)
+  end
+
+  it "should ping connections that sat idle longer than health_check_interval" do
+    idle_pool = Mysql2::Pool.new(DatabaseCredentials['root'].merge(size: 1, health_check_interval: 0))
+    idle_pool.with { |client| client.query("SELECT 1") }
+    expect(idle_pool.stats[:health_checks]).to eql(1)
+    idle_pool.close
+  end
+
+  it "should count checkouts" do
+    3.times { pool.with { |client| client.query("SELECT 1") } }
+    expect(pool.stats[:checkouts]).to eql(3)
+  end
+
+  it "should refuse clients from elsewhere" do
+    expect { pool.checkin(@client) }.to raise_error(Mysql2::Error)
+  end
+
+  it "should not hand out connections once closed" do
+    pool.close
+    expect(pool).to be_closed
+    expect { pool.checkout }.to raise_error(Mysql2::Error, /closed/)
+  end
+end
@@ -1,4 +1,5 @@
 require 'spec_helper'
+require 'stringio'
 
 RSpec.describe Mysql2::Result do
   before(:each) do
@@ -86,6 +87,18 @@ RSpec.describe Mysql2::Result do
       expect(result.to_a).to eql(result.to_a)
     end
 
+    it "should yield independent row hashes" do
+      rows = @client.query("SELECT 1 AS a, 2 AS b UNION SELECT 3, 4").to_a
+      rows.first['c'] = 5
+      expect(rows).to eql([{ 'a' => 1, 'b' => 2, 'c' => 5 }, { 'a' => 3, 'b' => 4 }])
+    end
+
+    it "should honor a different :cast on a second iteration" do
+      result = @client.query "SELECT 1 AS one", cache_rows: false
+      expect(result.each(cast: true).first).to eql('one' => 1)
+      expect(result.each(cast: false).first).to eql('one' => '1')
+    end
+
     it "should yield different value for #first if streaming" do
       result = @client.query "SELECT 1 UNION SELECT 2", stream: true, cache_rows: false
       expect(result.first).not_to eql(result.first)
@@ -106,6 +119,222 @@ RSpec.describe Mysql2::Result do
     end
   end
 
+  context "#columns" do
+    it "should return a hash of field names to arrays of values" do
+      result = @client.query "SELECT 1 AS a, 'x' AS b UNION SELECT 2, NULL"
+      expect(result.columns).to eql('a' => [1, 2], 'b' => ['x', nil])
+    end
+
+    it "should respect :symbolize_keys and :cast" do
+      result = @client.query "SELECT 1 AS a UNION SELECT 2"
+      expect(result.columns(symbolize_keys: true, cast: false)).to eql(a: %w[1 2])
+    end
+
+    it "should cast values the same way #each does" do
+      result = @client.query "SELECT * FROM mysql2_test ORDER BY id DESC LIMIT 1"
+      columns = result.columns
+      result.first.each do |field, value|
+        expect(columns[field]).to eql([value])
+      end
+    end
+
+    it "should not disturb a later #each" do
+      result = @client.query "SELECT 1 AS a UNION SELECT 2", cache_rows: false
+      expect(result.columns).to eql('a' => [1, 2])
+      expect(result.map { |row| row['a'] }).to eql([1, 2])
+    end
+
+    it "should work after every row has been cached" do
+      result = @client.query "SELECT 1 AS a, 'x' AS b UNION SELECT 2, NULL"
+      expect(result.to_a.size).to eql(2)
+      expect(result.columns).to eql('a' => [1, 2], 'b' => ['x', nil])
+
+      result = @client.query "SELECT 1 AS a UNION SELECT 2", as: :array
+      result.each { |_| nil }
+      expect(result.columns).to eql('a' => [1, 2])
+    end
+
+    it "should consume a streaming result" do
+      result = @client.query "SELECT 1 AS a UNION SELECT 2", stream: true, cache_rows: false
+      expect(result.columns).to eql('a' => [1, 2])
+      expect(result.count).to eql(2)
+      expect { result.columns }.to raise_error(Mysql2::Error)
+    end
+
+    it "should raise for prepared statement results" do
+      result = @client.prepare("SELECT 1 AS a").execute
+      expect { result.columns }.to raise_error(Mysql2::Error)
+    end
+  end
+
+  context "as: :lazy" do
+    let(:sql) { "SELECT 1 AS a, CAST('2010-04-04 11:44:00' AS DATETIME) AS b, 'x' AS c UNION SELECT 2, NULL, 'y'" }
+
+    it "should yield Mysql2::Row objects that decode like hash rows" do
+      rows = @client.query(sql).each(as: :lazy).to_a
+      expect(rows.map(&:class).uniq).to eql([Mysql2::Row])
+      expect(rows.map(&:to_h)).to eql(@client.query(sql).to_a)
+    end
+
+    it "should look up values by key" do
+      row = @client.query(sql).each(as: :lazy).first
+      expect(row['a']).to eql(1)
+      expect(row['b']).to be_an_instance_of(Time)
+      expect(row['missing']).to be_nil
+      expect(row.keys).to eql(%w[a b c])
+      expect(row.key?('c')).to be true
+      expect(row.fetch('c')).to eql('x')
+      expect { row.fetch('missing') }.to raise_error(KeyError)
+    end
+
+    it "should memoize decoded values" do
+      row = @client.query(sql).each(as: :lazy).first
+      expect(row['b']).to equal(row['b'])
+    end
+
+    it "should respect :symbolize_keys" do
+      row = @client.query(sql).each(as: :lazy, symbolize_keys: true).first
+      expect(row[:c]).to eql('x')
+    end
+
+    it "should raise when reading a row after the result was freed" do
+      result = @client.query(sql)
+      row = result.each(as: :lazy).first
+      result.free
+      expect { row['a'] }.to raise_error(Mysql2::Error)
+    end
+
+    it "should not be supported for streaming results" do
+      result = @client.query(sql, stream: true, cache_rows: false)
+      expect { result.each(as: :lazy).to_a }.to raise_error(Mysql2::Error)
+    end
+  end
+
+  context "as: :raw" do
+    let(:sql) { "SELECT 1 AS a, NULL AS b, 'x' AS c UNION SELECT 22, REPEAT('y', 300), ''" }
+    let(:raw_rows) { ["\x011\xFB\x01x".b, "\x0222\xFC\x2C\x01#{'y' * 300}\x00".b] }
+
+    it "should yield each row as a binary String of length-encoded cells" do
+      rows = @client.query(sql).each(as: :raw).to_a
+      expect(rows).to eql(raw_rows)
+      expect(rows.map(&:encoding).uniq).to eql([Encoding::BINARY])
+    end
+
+    it "should be yielded by #each_raw_row, also when streaming" do
+      expect(@client.query(sql).each_raw_row.to_a).to eql(raw_rows)
+
+      rows = []
+      @client.query(sql, stream: true, cache_rows: false, batch_size: 10).each_raw_row { |row| rows << row }
+      expect(rows).to eql(raw_rows)
+    end
+
+    it "should write rows to an IO and return how many were written" do
+      io = StringIO.new(''.b)
+      result = @client.query(sql)
+      expect(result.each_raw_row(io)).to eql(2)
+      expect(io.string).to eql(raw_rows.join)
+      expect(result.to_a.size).to eql(2)
+
+      io = StringIO.new(''.b)
+      result = @client.query(sql, stream: true, cache_rows: false)
+      expect(result.each_raw_row(io)).to eql(2)
+      expect(io.string).to eql(raw_rows.join)
+      expect { result.each_raw_row(io) }.to raise_error(Mysql2::Error)
+    end
+
+    it "should not be supported for prepared statement results" do
+      result = @client.prepare("SELECT 1").execute
+      expect { result.each(as: :raw).to_a }.to raise_error(Mysql2::Error)
+    end
+  end
+
+  context "#write_csv" do
+    let(:sql) { "SELECT 1 AS a, NULL AS b, 'x,\"y\"' AS c UNION SELECT 2, '', 'tab\\there\\nnew'" }
+
+    it "should write quoted CSV and return the number of rows" do
+      io = StringIO.new(''.b)
+      expect(@client.query(sql).write_csv(io, headers: true)).to eql(2)
+      expect(io.string).to eql("a,b,c\n1,,\"x,\"\"y\"\"\"\n2,\"\",\"tab\there\nnew\"\n")
+    end
+
+    it "should backslash escape when :quote is nil" do
+      io = StringIO.new(''.b)
+      @client.query(sql).write_csv(io, col_sep: "\t", quote: nil)
+      expect(io.string).to eql("1\t\\N\tx,\"y\"\n2\t\ttab\\there\\nnew\n")
+    end
+
+    it "should write to a File and consume streaming results" do
+      require 'tempfile'
+      Tempfile.create('mysql2_csv') do |file|
+        file.write("# export\n")
+        result = @client.query(sql, stream: true, cache_rows: false)
+        expect(result.write_csv(file, null: 'NULL', row_sep: "\r\n")).to eql(2)
+        file.flush
+        expect(File.binread(file.path)).to eql("# export\n1,NULL,\"x,\"\"y\"\"\"\r\n2,\"\",\"tab\there\nnew\"\r\n")
+        expect { result.write_csv(file) }.to raise_error(Mysql2::Error)
+      end
+    end
+
+    it "should reject multi-byte separators" do
+      expect { @client.query(sql).write_csv(StringIO.new, col_sep: '::') }.to raise_error(ArgumentError)
+    end
+  end
+
+  context "#to_arrow" do
+    let(:sql) do
+      "SELECT 1 AS id, 'x' AS s, 1.5e0 AS f, CAST('2020-01-02 03:04:05.5' AS DATETIME(6)) AS t, CAST('2020-01-02' AS DATE) AS d " \
+        "UNION SELECT 2, NULL, NULL, NULL, NULL"
+    end
+    let(:end_of_stream) { "\xFF\xFF\xFF\xFF\x00\x00\x00\x00".b }
+
+    it "should return an Arrow IPC stream as a binary String" do
+      arrow = @client.query(sql).to_arrow
+      expect(arrow.encoding).to eql(Encoding::BINARY)
+      expect(arrow).to start_with("\xFF\xFF\xFF\xFF".b)
+      expect(arrow).to end_with(end_of_stream)
+      expect(arrow.size % 8).to eql(0)
+      %w[id s f t d].each { |name| expect(arrow).to include(name) }
+    end
+
+    it "should write the same stream to an IO, also when streaming" do
+      expected = @client.query(sql).to_arrow(batch_size: 1)
+
+      io = StringIO.new(''.b)
+      expect(@client.query(sql).to_arrow(io, batch_size: 1)).to eql(2)
+      expect(io.string).to eql(expected)
+
+      require 'tempfile'
+      Tempfile.create('mysql2_arrow') do |file|
+        expect(@client.query_arrow(sql, file, batch_size: 1)).to eql(2)
+        file.flush
+        expect(File.binread(file.path)).to eql(expected)
+      end
+    end
+
+    it "should write only the schema for an empty result" do
+      arrow = @client.query_arrow("SELECT 1 AS id FROM DUAL WHERE 1 = 0")
+      expect(arrow).to end_with(end_of_stream)
+      expect(arrow).to include('id')
+    end
+
+    it "should decode with the Arrow library, if installed" do
+      begin
+        require 'arrow'
+      rescue LoadError
+        skip("DON'T WORRY, THIS TEST PASSES - but red-arrow is not installed.")
+      end
+      table = Arrow::Table.load(Arrow::Buffer.new(@client.query(sql).to_arrow), format: :arrow_streaming)
+      expect(table.n_rows).to eql(2)
+      expect(table['id'].data_type.to_s).to eql('int64')
+      expect(table['t'].data_type.to_s).to eql('timestamp[us]')
+      expect(table['s'].to_a).to eql(['x', nil])
+    end
+
+    it "should not be supported for prepared statement results" do
+      expect { @client.prepare("SELECT 1").execute.to_arrow }.to raise_error(Mysql2::Error)
+    end
+  end
+
   context "#fields" do
     let(:test_result) { @client.query("SELECT * FROM mysql2_test ORDER BY id DESC LIMIT 1") }
 
@@ -117,6 +346,32 @@ RSpec.describe Mysql2::Result do
       result = @client.query "SELECT 'a', 'b', 'c'"
       expect(result.fields).to eql(%w[a b c])
     end
+
+    it "should share frozen field names between results of the same query" do
+      first = @client.query("SELECT 1 AS a, 2 AS b").fields
+      second = @client.query("SELECT 3 AS a, 4 AS b").fields
+      expect(first).to all(be_frozen)
+      first.zip(second).each do |x, y|
+        expect(x).to equal(y)
+      end
+    end
+  end
+
+  context "#each_batch" do
+    let(:sql) { "SELECT 1 AS a UNION SELECT 2 UNION SELECT 3 UNION SELECT 4 UNION SELECT 5" }
+
+    it "should yield arrays of at most :batch_size rows" do
+      batches = @client.query(sql).each_batch(batch_size: 2).to_a
+      expect(batches).to eql([[{ "a" => 1 }, { "a" => 2 }], [{ "a" => 3 }, { "a" => 4 }], [{ "a" => 5 }]])
+    end
+
+    it "should batch streaming results" do
+      result = @client.query(sql, stream: true, cache_rows: false, as: :array)
+      batches = []
+      result.each_batch(batch_size: 3) { |batch| batches << batch }
+      expect(batches).to eql([[[1], [2], [3]], [[4], [5]]])
+      expect(result.count).to eql(5)
+    end
   end
 
   context "streaming" do
@@ -149,6 +404,19 @@ RSpec.describe Mysql2::Result do
       expect(result.count).to eql(0)
     end
 
+    it "should yield the same rows when fetching in batches" do
+      sql = "SELECT 1 AS a, NULL AS b UNION SELECT 2, 'two' UNION SELECT 3, ''"
+      expected = @client.query(sql).to_a
+      result = @client.query(sql, stream: true, cache_rows: false, batch_size: 2)
+      expect(result.to_a).to eql(expected)
+      expect(result.count).to eql(3)
+    end
+
+    it "should reject a non-positive :batch_size" do
+      result = @client.query("SELECT 1", stream: true, cache_rows: false)
+      expect { result.each(batch_size: 0) {} }.to raise_error(ArgumentError)
+    end
+
     it "should raise an exception if streaming ended due to a timeout" do
       @client.query "CREATE TEMPORARY TABLE streamingTest (val BINARY(255)) ENGINE=MEMORY"
 
@@ -262,6 +530,25 @@ RSpec.describe Mysql2::Result do
       expect(test_result['big_int_test']).to eql(10)
     end
 
+    it "should return Integer for BIGINT values at the edges of their range" do
+      r = @client.query("SELECT CAST(-9223372036854775808 AS SIGNED) AS min, CAST(18446744073709551615 AS UNSIGNED) AS max, -123456789012345678 AS long").first
+      expect(r['min']).to eql(-9_223_372_036_854_775_808)
+      expect(r['max']).to eql(18_446_744_073_709_551_615)
+      expect(r['long']).to eql(-123_456_789_012_345_678)
+    end
+
+    it "should decode integers the same way as rb_cstr2inum" do
+      sql = "SELECT CAST(-9223372036854775808 AS SIGNED) AS min, CAST(18446744073709551615 AS UNSIGNED) AS max, " \
+            "-123456789012345678 AS long, 0 AS zero, -1 AS neg, CAST(12345678901234567890123 AS DECIMAL(30,0)) AS wide"
+      begin
+        Mysql2::Result.send(:_legacy_decoders=, true)
+        legacy = @client.query(sql, as: :array).first
+      ensure
+        Mysql2::Result.send(:_legacy_decoders=, false)
+      end
+      expect(@client.query(sql, as: :array).first).to eql(legacy)
+    end
+
     it "should return Fixnum for a YEAR value" do
       expect(num_classes).to include(test_result['year_test'].class)
       expect(test_result['year_test']).to eql(2009)
@@ -272,6 +559,18 @@ RSpec.describe Mysql2::Result do
       expect(test_result['decimal_test']).to eql(10.3)
     end
 
+    it "should return a scaled Integer for a DECIMAL value if :decimal_as is :integer_scaled" do
+      r = @client.query("SELECT CAST(-1234.5 AS DECIMAL(18,4)) AS a, CAST(0 AS DECIMAL(5,2)) AS b", decimal_as: :integer_scaled).first
+      expect(r['a']).to eql(-12_345_000)
+      expect(r['b']).to eql(0)
+    end
+
+    it "should return Rational for a DECIMAL value if :decimal_as is :rational" do
+      r = @client.query("SELECT CAST(10.3 AS DECIMAL(10,3)) AS a, CAST('12345678901234567890.123' AS DECIMAL(30,3)) AS b", decimal_as: :rational).first
+      expect(r['a']).to eql(Rational(103, 10))
+      expect(r['b']).to eql(Rational(12_345_678_901_234_567_890_123, 1000))
+    end
+
     it "should return Float for a FLOAT value" do
       expect(test_result['float_test']).to be_an_instance_of(Float)
       expect(test_result['float_test']).to eql(10.3)
@@ -297,6 +596,35 @@ RSpec.describe Mysql2::Result do
       expect(r.first['test']).to be_an_instance_of(Time)
     end
 
+    it "should return Time with microseconds for a fractional DATETIME or TIME value" do
+      r = @client.query("SELECT CAST('2010-04-04 11:44:00.12' AS DATETIME(2)) AS dt, CAST('11:44:00.000123' AS TIME(6)) AS t")
+      expect(r.first['dt'].usec).to eql(120000)
+      expect(r.first['t'].usec).to eql(123)
+    end
+
+    it "should return UTC or local Time for a DATETIME value when :database_timezone is :utc" do
+      sql = "SELECT CAST('2010-04-04 11:44:00.25' AS DATETIME(2)) AS test"
+      utc = @client.query(sql, database_timezone: :utc).first['test']
+      expect(utc).to eql(Time.utc(2010, 4, 4, 11, 44, 0, 250000))
+      expect(utc).to be_utc
+
+      local = @client.query(sql, database_timezone: :utc, application_timezone: :local).first['test']
+      expect(local).to eql(Time.utc(2010, 4, 4, 11, 44, 0, 250000).localtime)
+      expect(local).not_to be_utc
+    end
+
+    it "should decode DATE, TIME and DATETIME values the same way as the sscanf parser" do
+      sql = "SELECT CAST('2010-04-04 11:44:00.25' AS DATETIME(2)) AS dt, CAST('1901-12-13 20:45:51' AS DATETIME) AS old_dt, " \
+            "CAST('11:44:00.000123' AS TIME(6)) AS t, CAST('2010-04-04' AS DATE) AS d"
+      begin
+        Mysql2::Result.send(:_legacy_decoders=, true)
+        legacy = @client.query(sql, as: :array).first
+      ensure
+        Mysql2::Result.send(:_legacy_decoders=, false)
+      end
+      expect(@client.query(sql, as: :array).first).to eql(legacy)
+    end
+
     it "should return Time for a TIMESTAMP value when within the supported range" do
       expect(test_result['timestamp_test']).to be_an_instance_of(Time)
       expect(test_result['timestamp_test'].strftime("%Y-%m-%d %H:%M:%S")).to eql('2010-04-04 11:44:00')
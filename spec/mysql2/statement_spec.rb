@@ -132,6 +132,15 @@ RSpec.describe Mysql2::Statement do
     end
   end
 
+  it "should rebind when parameter types change between executions" do
+    statement = @client.prepare 'SELECT ? AS a, ? AS b'
+    expect(statement.execute(1, 'one').first).to eq('a' => 1, 'b' => 'one')
+    expect(statement.execute(2, 'two').first).to eq('a' => 2, 'b' => 'two')
+    expect(statement.execute('three', 3.5).first).to eq('a' => 'three', 'b' => 3.5)
+    expect(statement.execute(nil, true).first).to eq('a' => nil, 'b' => 1)
+    expect(statement.execute(4, 'four').first).to eq('a' => 4, 'b' => 'four')
+  end
+
   it "should handle comparisons and likes" do
     @client.query 'USE test'
     @client.query 'CREATE TABLE IF NOT EXISTS mysql2_stmt_q(a int, b varchar(10))'
@@ -203,6 +212,85 @@ RSpec.describe Mysql2::Statement do
     expect(test_result['decimal_test']).to eql(123.45)
   end
 
+  context "#execute_batch" do
+    before(:each) do
+      @client.query 'USE test'
+      @client.query 'DROP TABLE IF EXISTS mysql2_stmt_batch_test'
+      @client.query 'CREATE TABLE mysql2_stmt_batch_test (id INT AUTO_INCREMENT PRIMARY KEY, a INT, b VARCHAR(32))'
+    end
+
+    after(:each) do
+      @client.query 'DROP TABLE IF EXISTS mysql2_stmt_batch_test'
+    end
+
+    it "should execute the statement once per row" do
+      stmt = @client.prepare 'INSERT INTO mysql2_stmt_batch_test (a, b) VALUES (?, ?)'
+      result = stmt.execute_batch([[1, 'one'], [2, nil], [nil, 'three']])
+
+      expect(result.affected_rows).to eq(3)
+      expect(result.last_id).to be > 0
+      rows = @client.query('SELECT id, a, b FROM mysql2_stmt_batch_test ORDER BY id').to_a
+      expect(rows.map { |row| [row['a'], row['b']] }).to eq([[1, 'one'], [2, nil], [nil, 'three']])
+      expect(rows.first['id']).to eq(result.last_id)
+    end
+
+    it "should handle rows that mix parameter types" do
+      stmt = @client.prepare 'INSERT INTO mysql2_stmt_batch_test (a, b) VALUES (?, ?)'
+      result = stmt.execute_batch([[1, 'one'], ['2', 2]])
+
+      expect(result.affected_rows).to eq(2)
+      expect(@client.query('SELECT a, b FROM mysql2_stmt_batch_test ORDER BY id').map(&:values)).to eq([[1, 'one'], [2, '2']])
+    end
+
+    it "should total the affected rows of an UPDATE" do
+      @client.query "INSERT INTO mysql2_stmt_batch_test (a) VALUES (1), (1), (2)"
+      stmt = @client.prepare 'UPDATE mysql2_stmt_batch_test SET b = ? WHERE a = ?'
+
+      expect(stmt.execute_batch([['x', 1], ['y', 2]]).affected_rows).to eq(3)
+    end
+
+    it "should leave the statement usable with #execute" do
+      stmt = @client.prepare 'INSERT INTO mysql2_stmt_batch_test (a, b) VALUES (?, ?)'
+      stmt.execute_batch([[1, 'one'], [2, 'two']])
+      stmt.execute(3, 'three')
+
+      expect(@client.query('SELECT COUNT(*) AS n FROM mysql2_stmt_batch_test').first['n']).to eq(3)
+    end
+
+    it "should return zero for an empty batch" do
+      stmt = @client.prepare 'INSERT INTO mysql2_stmt_batch_test (a) VALUES (?)'
+      expect(stmt.execute_batch([]).affected_rows).to eq(0)
+    end
+
+    it "should raise when a row has the wrong number of parameters" do
+      stmt = @client.prepare 'INSERT INTO mysql2_stmt_batch_test (a, b) VALUES (?, ?)'
+      expect { stmt.execute_batch([[1, 'one'], [2]]) }.to raise_error(Mysql2::Error, /row 1/)
+      expect(@client.query('SELECT COUNT(*) AS n FROM mysql2_stmt_batch_test').first['n']).to eq(0)
+    end
+
+    it "should report the failing row and the rows affected before it" do
+      stmt = @client.prepare 'INSERT INTO mysql2_stmt_batch_test (id, a) VALUES (?, ?)'
+      error = nil
+      begin
+        stmt.execute_batch([[1, 1], [2, 2], [1, 3], [4, 4]])
+      rescue Mysql2::Error => e
+        error = e
+      end
+
+      expect(error).to be_a(Mysql2::Error)
+      # a MariaDB bulk request fails as a whole
+      skip "the rows were sent in one bulk request" if error.batch_row.nil?
+      expect(error.batch_row).to eq(2)
+      expect(error.batch_affected_rows).to eq(2)
+      expect(@client.query('SELECT a FROM mysql2_stmt_batch_test ORDER BY id').map { |row| row['a'] }).to eq([1, 2])
+    end
+
+    it "should raise for statements that return rows" do
+      stmt = @client.prepare 'SELECT ?'
+      expect { stmt.execute_batch([[1]]) }.to raise_error(Mysql2::Error)
+    end
+  end
+
   it "should warn but still work if cache_rows is set to false" do
     statement = @client.prepare 'SELECT 1'
     result = nil
@@ -429,6 +517,11 @@ RSpec.describe Mysql2::Statement do
       expect(test_result['decimal_test']).to eql(10.3)
     end
 
+    it "should return Rational for a DECIMAL value if :decimal_as is :rational" do
+      result = @client.prepare("SELECT CAST(10.3 AS DECIMAL(10,3)) AS a").execute(decimal_as: :rational)
+      expect(result.first['a']).to eql(Rational(103, 10))
+    end
+
     it "should return Float for a FLOAT value" do
       expect(test_result['float_test']).to be_an_instance_of(Float)
       expect(test_result['float_test']).to be_within(1e-5).of(10.3)
@@ -708,5 +801,71 @@ RSpec.describe Mysql2::Statement do
       stmt.close
       expect { stmt.execute }.to raise_error(Mysql2::Error, /Invalid statement handle/)
     end
+
+    it 'should be reported by #closed?' do
+      stmt = @client.prepare 'SELECT 1'
+      expect(stmt).not_to be_closed
+      stmt.close
+      expect(stmt).to be_closed
+    end
+  end
+
+  context 'statement cache' do
+    let(:client) { new_client(statement_cache_size: 2) }
+
+    it 'should be disabled by default' do
+      expect(@client.prepare('SELECT 1')).not_to equal(@client.prepare('SELECT 1'))
+      expect(@client.statement_cache_stats).to be_nil
+    end
+
+    it 'should return the same statement for the same SQL' do
+      stmt = client.prepare 'SELECT ? AS a'
+      expect(client.prepare('SELECT ? AS a')).to equal(stmt)
+      expect(stmt.execute(1).first).to eql('a' => 1)
+      expect(client.statement_cache_stats).to include(hits: 1, misses: 1, size: 1)
+    end
+
+    it 'should close the least recently used statement when full' do
+      first = client.prepare 'SELECT 1'
+      second = client.prepare 'SELECT 2'
+      client.prepare 'SELECT 1'
+      client.prepare 'SELECT 3'
+
+      expect(second).to be_closed
+      expect(first).not_to be_closed
+      expect(client.statement_cache_stats).to include(evictions: 1, size: 2)
+    end
+
+    it 'should prepare statements closed by the caller again' do
+      stmt = client.prepare 'SELECT 1'
+      stmt.close
+      expect(client.prepare('SELECT 1')).not_to equal(stmt)
+      expect(client.statement_cache_stats).to include(hits: 0, misses: 2)
+    end
+
+    it 'should not hand out a statement that is still streaming' do
+      sql = 'SELECT 1 AS a UNION ALL SELECT 2'
+      outer = client.prepare sql
+      seen = outer.execute(stream: true).map do |row|
+        inner = client.prepare sql
+        expect(inner).not_to equal(outer)
+        [row['a'], inner.execute.map { |r| r['a'] }]
+      end
+
+      expect(seen).to eql([[1, [1, 2]], [2, [1, 2]]])
+      expect(outer).not_to be_streaming
+      expect(client.prepare(sql)).to equal(outer)
+      expect(client.statement_cache_stats).to include(hits: 1, misses: 3, size: 1)
+    end
+
+    it 'should forget statements after a reconnect' do
+      reconnecting = new_client(statement_cache_size: 2, reconnect: true)
+      stmt = reconnecting.prepare 'SELECT 1'
+      new_client.query("KILL #{reconnecting.thread_id}")
+      reconnecting.ping
+
+      expect(reconnecting.prepare('SELECT 1')).not_to equal(stmt)
+      expect(stmt).to be_closed
+    end
   end
 end
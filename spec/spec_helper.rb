@@ -110,3 +110,84 @@ RSpec.configure do |config|
     end
   end
 end
+
+# Just enough of a Fiber scheduler (Ruby 3.0+) to check that queries yield to
+# it while they wait on the server: io_wait parks the fiber until IO.select
+# says its socket is ready, block parks it until another fiber on the same
+# thread calls unblock, and close runs the loop until every fiber is done.
+class MinimalFiberScheduler
+  def initialize
+    @readable = {}
+    @writable = {}
+    @timeouts = {}
+    @blocked = {}
+    @ready = []
+  end
+
+  def fiber(&block)
+    fiber = Fiber.new(blocking: false, &block)
+    fiber.resume
+    fiber
+  end
+
+  def io_wait(io, events, timeout)
+    fiber = Fiber.current
+    @readable[io] = fiber if events & IO::READABLE != 0
+    @writable[io] = fiber if events & IO::WRITABLE != 0
+    @timeouts[fiber] = now + timeout if timeout
+    Fiber.yield
+  ensure
+    @readable.delete(io)
+    @writable.delete(io)
+    @timeouts.delete(fiber)
+  end
+
+  def kernel_sleep(duration = nil)
+    fiber = Fiber.current
+    @timeouts[fiber] = now + duration if duration
+    Fiber.yield
+    true
+  ensure
+    @timeouts.delete(fiber)
+  end
+
+  def block(_blocker, timeout = nil)
+    fiber = Fiber.current
+    @blocked[fiber] = true
+    @timeouts[fiber] = now + timeout if timeout
+    Fiber.yield
+  ensure
+    @blocked.delete(fiber)
+    @timeouts.delete(fiber)
+  end
+
+  def unblock(_blocker, fiber)
+    @ready << fiber if @blocked.key?(fiber)
+  end
+
+  def close
+    until @readable.empty? && @writable.empty? && @timeouts.empty? && @ready.empty?
+      unless @ready.empty?
+        fiber = @ready.shift
+        fiber.resume(true) if @blocked.key?(fiber)
+        next
+      end
+
+      timeout = @timeouts.values.min
+      timeout = [timeout - now, 0].max if timeout
+      readable, writable = IO.select(@readable.keys, @writable.keys, [], timeout)
+
+      ready = {}
+      Array(readable).each { |io| ready[@readable[io]] = (ready[@readable[io]] || 0) | IO::READABLE }
+      Array(writable).each { |io| ready[@writable[io]] = (ready[@writable[io]] || 0) | IO::WRITABLE }
+      @timeouts.each { |fiber, at| ready[fiber] ||= false if at <= now }
+      ready.each { |fiber, events| fiber.resume(events) }
+    end
+  end
+
+  private
+
+  def now
+    Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  end
+end